@@ -4,15 +4,26 @@ greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
 
 CONFIG += c++11
 
+# 用C++20编译时流式分析经过协程包装（SLR_COROUTINE），需要Qt 5.12以上：qmake CONFIG+=c++2a
+# gcc 10要额外打开-fcoroutines，11以上在C++20下默认打开
+c++2a {
+    CONFIG -= c++11
+    *-g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 #DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
+# 按分析阶段统计内存分配（批量分析的--alloc-report、--alloc-budget需要）
+#DEFINES += SLR_COUNT_ALLOCATIONS
+
 SOURCES += \
     main.cpp \
     widget.cpp
 
 HEADERS += \
+    slr1table.h \
     widget.h
 
 FORMS += \
@@ -1,9 +1,17 @@
 #include "widget.h"
 
 #include <QApplication>
+#include <cstring>
 
 int main(int argc, char *argv[])
 {
+    // 带--batch参数时不启动界面，直接批量分析句子
+    if (argc > 1 && strcmp(argv[1], "--batch") == 0) return batchMain(argc, argv);
+    // 带--daemon参数时作为后台服务，通过Unix域套接字接受请求
+    if (argc > 1 && strcmp(argv[1], "--daemon") == 0) return daemonMain(argc, argv);
+    // 带--generate参数时从文法随机生成句子
+    if (argc > 1 && strcmp(argv[1], "--generate") == 0) return generateMain(argc, argv);
+
     QApplication a(argc, argv);
     Widget w;
     w.show();
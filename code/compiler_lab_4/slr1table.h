@@ -0,0 +1,647 @@
+#ifndef SLR1TABLE_H
+#define SLR1TABLE_H
+
+// 编译期生成SLR(1)分析表（需要C++17），用于固定编进程序的小文法，不需要生成步骤，运行时也不用建表
+// 文法写成constexpr字符串，格式和界面输入的相同：每行一条A->xyz，大写字母为非终结符，@表示空串，#开头为注释行
+// 第一条产生式的左部为开始符号，开始符号有多条产生式（或出现在右部）时增广为^->S
+// First/Follow集合、LR(0)项目集和分析表都在编译期算好，放在constexpr数组里；不是SLR(1)文法时编译出错
+// 动作编码和widget.cpp的运行时分析表相同：0为出错，正数为移进到(值-1)号状态，负数为按(-值-1)号文法归约
+// 不支持%left等声明，有冲突的文法请用界面生成LALR(1)/LR(1)表并导出分析表文件
+//
+// 增广的判定、First/Follow的迭代和归约动作的填写（含冲突判定）写成模板，widget.cpp（C++11）也用它们，两边的结果一致；
+// 这部分在C++11下是普通的inline函数，编译期建表的部分只在C++17下提供
+//
+//   static constexpr char exprGrammar[] = "E->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->a\n";
+//   constexpr auto exprTable = slr1::makeTable<exprGrammar>();
+//   static_assert(slr1::parse(exprTable, "a+a*(a)"), "");
+
+#include <cstdint>
+
+// C++14起constexpr函数可以有循环和赋值，之前的标准只能是普通的inline函数
+#if defined(__cpp_constexpr) && __cpp_constexpr >= 201304L
+#define SLR1_CONSTEXPR constexpr
+#else
+#define SLR1_CONSTEXPR inline
+#endif
+
+#if __cplusplus >= 201703L || (defined(_MSVC_LANG) && _MSVC_LANG >= 201703L)
+#define SLR1_COMPILE_TIME_TABLE
+#endif
+
+namespace slr1
+{
+
+const int maxProductions = 64;
+const int maxRight = 16;
+const int maxItems = maxProductions * (maxRight + 1);
+const int maxStates = 256;
+const int maxKernel = 64;
+const int maxStack = 256; // parse的栈深度
+const int acceptAction = 0x7fffffff;
+
+enum errorKind
+{
+    errorNone,
+    errorSyntax, // 不是A->xyz格式
+    errorDirective, // 不支持%声明
+    errorTooLarge, // 超出上面的容量
+    errorUndefined, // 右部用到没有产生式的非终结符
+    errorShiftReduce,
+    errorReduceReduce
+};
+
+// 字符的集合（256个，界面输入的文法可能有非ASCII字符）
+struct charSet
+{
+    uint64_t w[4] = { 0, 0, 0, 0 };
+
+    SLR1_CONSTEXPR bool test(char c) const { return (w[(unsigned char)c >> 6] >> ((unsigned char)c & 63)) & 1; }
+    SLR1_CONSTEXPR void set(char c) { w[(unsigned char)c >> 6] |= uint64_t(1) << ((unsigned char)c & 63); }
+    // 并入other，返回是否有变化
+    SLR1_CONSTEXPR bool merge(const charSet& other)
+    {
+        bool changed = false;
+        for (int i = 0; i < 4; ++i)
+        {
+            uint64_t x = w[i] | other.w[i];
+            changed = changed || x != w[i];
+            w[i] = x;
+        }
+        return changed;
+    }
+};
+
+constexpr bool isNonterminal(char c)
+{
+    return c >= 'A' && c <= 'Z';
+}
+
+// 下面的模板通过四个函数读文法，编译期的analysis和widget.cpp的文法各自提供：
+//   int count() 产生式条数，char leftOf(gid) 左部，int lengthOf(gid) 右部长度（空串为0），char symbolAt(gid, k) 右部第k个符号
+
+// 开始符号有多条产生式，或者出现在右部时要增广为^->S，否则内层的开始符号归约会被当成接受
+template <class Grammar>
+SLR1_CONSTEXPR bool needsAugment(const Grammar& g, char start)
+{
+    int startCount = 0;
+    for (int gid = 0; gid < g.count(); ++gid)
+    {
+        if (g.leftOf(gid) == start) ++startCount;
+        for (int k = 0; k < g.lengthOf(gid); ++k)
+        {
+            if (g.symbolAt(gid, k) == start) return true;
+        }
+    }
+    return startCount > 1;
+}
+
+// First集合和能否推出空串，迭代到不动点；数组按字符（unsigned char）下标
+template <class Grammar>
+SLR1_CONSTEXPR void computeFirst(const Grammar& g, bool* nullable, charSet* first)
+{
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int gid = 0; gid < g.count(); ++gid)
+        {
+            unsigned char A = g.leftOf(gid);
+            bool allNullable = true;
+            for (int k = 0; k < g.lengthOf(gid) && allNullable; ++k)
+            {
+                char c = g.symbolAt(gid, k);
+                if (!isNonterminal(c))
+                {
+                    charSet s;
+                    s.set(c);
+                    changed = first[A].merge(s) || changed;
+                    allNullable = false;
+                }
+                else
+                {
+                    changed = first[A].merge(first[(unsigned char)c]) || changed;
+                    allNullable = nullable[(unsigned char)c];
+                }
+            }
+            if (allNullable && !nullable[A])
+            {
+                nullable[A] = true;
+                changed = true;
+            }
+        }
+    }
+}
+
+// Follow集合，start的Follow集合含$；nullable、first为computeFirst的结果
+template <class Grammar>
+SLR1_CONSTEXPR void computeFollow(const Grammar& g, char start, const bool* nullable, const charSet* first, charSet* follow)
+{
+    follow[(unsigned char)start].set('$');
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (int gid = 0; gid < g.count(); ++gid)
+        {
+            unsigned char A = g.leftOf(gid);
+            // 从右往左，trailer为当前位置之后能出现的终结符
+            charSet trailer = follow[A];
+            for (int k = g.lengthOf(gid) - 1; k >= 0; --k)
+            {
+                char c = g.symbolAt(gid, k);
+                if (!isNonterminal(c))
+                {
+                    trailer = charSet();
+                    trailer.set(c);
+                    continue;
+                }
+                changed = follow[(unsigned char)c].merge(trailer) || changed;
+                if (nullable[(unsigned char)c]) trailer.merge(first[(unsigned char)c]);
+                else trailer = first[(unsigned char)c];
+            }
+        }
+    }
+}
+
+// fillReduce记录的冲突种类，按位或
+const int conflictShiftReduce = 1;
+const int conflictReduceReduce = 2;
+// 移进-归约冲突不能用优先级解决
+const int unresolved = 0x7ffffffe;
+
+// 不支持优先级声明时，移进-归约冲突都不能解决
+struct noPrecedence
+{
+    SLR1_CONSTEXPR int operator()(int, char, int) const { return unresolved; }
+};
+
+// 在一行动作中填入按gid归约的动作（移进必须先填好），row按字符（unsigned char）下标，共256项，编码同上
+// lookahead为可以归约的终结符，SLR(1)为左部的Follow集合，LALR(1)、LR(1)为项目的向前看符号；acceptGid的产生式遇到$为接受
+// 移进-归约冲突交给resolve(gid, c, 移进动作)，返回要填的动作（0为出错），unresolved表示不能解决
+// 返回没有解决的冲突个数，kinds按位记录冲突种类，firstConflict记录第一个冲突的终结符
+template <class Resolve>
+SLR1_CONSTEXPR int fillReduce(int* row, int gid, int acceptGid, const charSet& lookahead, Resolve resolve, int* kinds, int* firstConflict = nullptr)
+{
+    int conflicts = 0;
+    for (int c = 0; c < 256; ++c)
+    {
+        if (!lookahead.test((char)c)) continue;
+        int act = gid == acceptGid && c == '$' ? acceptAction : -gid - 1;
+        int& cell = row[c];
+        if (cell == 0 || cell == act)
+        {
+            cell = act;
+            continue;
+        }
+        int kind = conflictReduceReduce;
+        if (cell > 0 && cell != acceptAction)
+        {
+            int resolved = resolve(gid, (char)c, cell);
+            if (resolved != unresolved)
+            {
+                cell = resolved;
+                continue;
+            }
+            kind = conflictShiftReduce;
+        }
+        if (conflicts == 0 && firstConflict) *firstConflict = c;
+        ++conflicts;
+        if (kinds) *kinds |= kind;
+    }
+    return conflicts;
+}
+
+#ifdef SLR1_COMPILE_TIME_TABLE
+
+// 编译期分析的全部中间结果，容量固定
+struct analysis
+{
+    errorKind error = errorNone;
+    int errorState = -1; // 冲突的状态
+    char errorChar = 0; // 冲突的终结符或未定义的非终结符
+
+    // 文法，下标即文法编号
+    int productionCount = 0;
+    char left[maxProductions] = {};
+    char right[maxProductions][maxRight] = {};
+    int length[maxProductions] = {};
+    char startSymbol = 0; // 增广后的开始符号
+    int acceptGid = 0;
+
+    // 符号，按字符顺序编号
+    int terminalCount = 0;
+    int nonterminalCount = 0;
+    char terminals[128] = {};
+    char nonterminals[26] = {};
+    signed char termColumn[128] = {};
+    signed char ntColumn[128] = {};
+
+    bool nullable[128] = {};
+    charSet first[128] = {};
+    charSet follow[128] = {};
+
+    // LR(0)项目(gid, dot)编号为itemBase[gid] + dot
+    int itemCount = 0;
+    int itemBase[maxProductions] = {};
+    int itemGid[maxItems] = {};
+    int itemDot[maxItems] = {};
+
+    // 状态以核心项目（按编号排序）区分
+    int stateCount = 0;
+    int kernelSize[maxStates] = {};
+    int kernel[maxStates][maxKernel] = {};
+    int transition[maxStates][128] = {}; // 经过字符到达的状态+1，0为没有转移
+
+    // 供needsAugment、computeFirst等读文法
+    constexpr int count() const { return productionCount; }
+    constexpr char leftOf(int gid) const { return left[gid]; }
+    constexpr int lengthOf(int gid) const { return length[gid]; }
+    constexpr char symbolAt(int gid, int k) const { return right[gid][k]; }
+};
+
+// 读入文法字符串
+constexpr void readGrammar(const char* g, analysis& a)
+{
+    int i = 0;
+    while (g[i] != 0 && a.error == errorNone)
+    {
+        int end = i;
+        while (g[end] != 0 && g[end] != '\n') ++end;
+        int next = g[end] == 0 ? end : end + 1;
+        // 去掉行内空白
+        char line[maxRight + 8] = {};
+        int n = 0;
+        bool tooLong = false;
+        for (int k = i; k < end; ++k)
+        {
+            if (g[k] == ' ' || g[k] == '\t' || g[k] == '\r') continue;
+            if (n == maxRight + 7) tooLong = true;
+            else line[n++] = g[k];
+        }
+        bool comment = end > i && g[i] == '#';
+        i = next;
+        if (n == 0 || comment) continue;
+        if (line[0] == '%')
+        {
+            a.error = errorDirective;
+            break;
+        }
+        if (n < 4 || !isNonterminal(line[0]) || line[1] != '-' || line[2] != '>')
+        {
+            a.error = errorSyntax;
+            break;
+        }
+        if (tooLong || n - 3 > maxRight || a.productionCount + 1 >= maxProductions)
+        {
+            a.error = errorTooLarge;
+            break;
+        }
+        int gid = a.productionCount++;
+        a.left[gid] = line[0];
+        bool epsilon = n == 4 && line[3] == '@';
+        a.length[gid] = epsilon ? 0 : n - 3;
+        for (int k = 0; k < a.length[gid]; ++k) a.right[gid][k] = line[3 + k];
+    }
+    if (a.error == errorNone && a.productionCount == 0) a.error = errorSyntax;
+    if (a.error != errorNone) return;
+
+    char start = a.left[0];
+    a.startSymbol = start;
+    if (needsAugment(a, start))
+    {
+        for (int gid = a.productionCount; gid > 0; --gid)
+        {
+            a.left[gid] = a.left[gid - 1];
+            a.length[gid] = a.length[gid - 1];
+            for (int k = 0; k < maxRight; ++k) a.right[gid][k] = a.right[gid - 1][k];
+        }
+        ++a.productionCount;
+        a.left[0] = '^';
+        a.length[0] = 1;
+        a.right[0][0] = start;
+        for (int k = 1; k < maxRight; ++k) a.right[0][k] = 0;
+        a.startSymbol = '^';
+    }
+    a.acceptGid = 0;
+}
+
+// 给终结符、非终结符编号
+constexpr void collectSymbols(analysis& a)
+{
+    bool isTerminal[128] = {};
+    bool isLeft[128] = {};
+    isTerminal['$'] = true;
+    for (int gid = 0; gid < a.productionCount; ++gid)
+    {
+        isLeft[(unsigned char)a.left[gid]] = true;
+        for (int k = 0; k < a.length[gid]; ++k)
+        {
+            char c = a.right[gid][k];
+            if ((unsigned char)c >= 128)
+            {
+                a.error = errorSyntax;
+                return;
+            }
+            if (!isNonterminal(c)) isTerminal[(unsigned char)c] = true;
+        }
+    }
+    for (int gid = 0; gid < a.productionCount; ++gid)
+    {
+        for (int k = 0; k < a.length[gid]; ++k)
+        {
+            char c = a.right[gid][k];
+            if (isNonterminal(c) && !isLeft[(unsigned char)c])
+            {
+                a.error = errorUndefined;
+                a.errorChar = c;
+                return;
+            }
+        }
+    }
+    for (int c = 0; c < 128; ++c)
+    {
+        a.termColumn[c] = -1;
+        a.ntColumn[c] = -1;
+        if (isTerminal[c])
+        {
+            a.termColumn[c] = a.terminalCount;
+            a.terminals[a.terminalCount++] = (char)c;
+        }
+        else if (isLeft[c] && c != '^')
+        {
+            a.ntColumn[c] = a.nonterminalCount;
+            a.nonterminals[a.nonterminalCount++] = (char)c;
+        }
+    }
+}
+
+// First集合和Follow集合
+constexpr void firstAndFollow(analysis& a)
+{
+    computeFirst(a, a.nullable, a.first);
+    computeFollow(a, a.startSymbol, a.nullable, a.first, a.follow);
+}
+
+// 核心项目的闭包，结果按项目编号标记在in中
+constexpr void closure(const analysis& a, const int* items, int count, bool* in)
+{
+    int work[maxItems] = {};
+    int top = 0;
+    for (int i = 0; i < count; ++i)
+    {
+        in[items[i]] = true;
+        work[top++] = items[i];
+    }
+    bool expanded[128] = {};
+    while (top > 0)
+    {
+        int item = work[--top];
+        int gid = a.itemGid[item], dot = a.itemDot[item];
+        if (dot == a.length[gid]) continue;
+        char B = a.right[gid][dot];
+        if (!isNonterminal(B) || expanded[(unsigned char)B]) continue;
+        expanded[(unsigned char)B] = true;
+        for (int g = 0; g < a.productionCount; ++g)
+        {
+            if (a.left[g] != B || in[a.itemBase[g]]) continue;
+            in[a.itemBase[g]] = true;
+            work[top++] = a.itemBase[g];
+        }
+    }
+}
+
+// LR(0)项目集规范族
+constexpr void buildStates(analysis& a)
+{
+    for (int gid = 0; gid < a.productionCount; ++gid)
+    {
+        a.itemBase[gid] = a.itemCount;
+        for (int dot = 0; dot <= a.length[gid]; ++dot)
+        {
+            a.itemGid[a.itemCount] = gid;
+            a.itemDot[a.itemCount] = dot;
+            ++a.itemCount;
+        }
+    }
+
+    // 开始状态的核心为开始符号的所有产生式
+    for (int gid = 0; gid < a.productionCount; ++gid)
+    {
+        if (a.left[gid] == a.startSymbol) a.kernel[0][a.kernelSize[0]++] = a.itemBase[gid];
+    }
+    a.stateCount = 1;
+    for (int s = 0; s < a.stateCount; ++s)
+    {
+        bool in[maxItems] = {};
+        closure(a, a.kernel[s], a.kernelSize[s], in);
+        // 只试点后面出现的符号
+        charSet after;
+        for (int item = 0; item < a.itemCount; ++item)
+        {
+            int gid = a.itemGid[item], dot = a.itemDot[item];
+            if (in[item] && dot < a.length[gid]) after.set(a.right[gid][dot]);
+        }
+        for (int X = 1; X < 128; ++X)
+        {
+            if (!after.test((char)X)) continue;
+            // 点后面是X的项目，点后移一位
+            int next[maxKernel] = {};
+            int n = 0;
+            for (int item = 0; item < a.itemCount; ++item)
+            {
+                int gid = a.itemGid[item], dot = a.itemDot[item];
+                if (!in[item] || dot == a.length[gid] || a.right[gid][dot] != X) continue;
+                if (n == maxKernel)
+                {
+                    a.error = errorTooLarge;
+                    return;
+                }
+                next[n++] = item + 1;
+            }
+            if (n == 0) continue;
+            int target = -1;
+            for (int t = 0; t < a.stateCount && target == -1; ++t)
+            {
+                if (a.kernelSize[t] != n) continue;
+                bool same = true;
+                for (int k = 0; k < n && same; ++k) same = a.kernel[t][k] == next[k];
+                if (same) target = t;
+            }
+            if (target == -1)
+            {
+                if (a.stateCount == maxStates)
+                {
+                    a.error = errorTooLarge;
+                    return;
+                }
+                target = a.stateCount++;
+                a.kernelSize[target] = n;
+                for (int k = 0; k < n; ++k) a.kernel[target][k] = next[k];
+            }
+            a.transition[s][X] = target + 1;
+        }
+    }
+}
+
+// 全部分析，出错时error不为errorNone
+constexpr analysis analyse(const char* g)
+{
+    analysis a;
+    readGrammar(g, a);
+    if (a.error == errorNone) collectSymbols(a);
+    if (a.error == errorNone) firstAndFollow(a);
+    if (a.error == errorNone) buildStates(a);
+    return a;
+}
+
+// 编译期生成的分析表，数组大小正好是状态数和符号数
+template <int States, int Terminals, int Nonterminals, int Productions>
+struct table
+{
+    static const int stateCount = States;
+    static const int terminalCount = Terminals;
+    static const int nonterminalCount = Nonterminals;
+    static const int productionCount = Productions;
+
+    int action[States][Terminals] = {};
+    int gotoTable[States][Nonterminals] = {}; // -1为空
+    signed char termColumn[128] = {}; // 字符到action的列，-1表示不是终结符
+    signed char ntColumn[128] = {}; // 字符到gotoTable的列
+    char terminals[Terminals] = {};
+    char nonterminals[Nonterminals] = {};
+    char prodLeft[Productions] = {};
+    int prodLen[Productions] = {};
+    char startSymbol = 0;
+    int acceptGid = 0;
+};
+
+// 由LR(0)自动机和Follow集合填表，冲突记在a.error中
+template <class T>
+constexpr T fillTable(analysis& a)
+{
+    T t;
+    for (int c = 0; c < 128; ++c)
+    {
+        t.termColumn[c] = a.termColumn[c];
+        t.ntColumn[c] = a.ntColumn[c];
+    }
+    for (int i = 0; i < T::terminalCount; ++i) t.terminals[i] = a.terminals[i];
+    for (int i = 0; i < T::nonterminalCount; ++i) t.nonterminals[i] = a.nonterminals[i];
+    for (int gid = 0; gid < T::productionCount; ++gid)
+    {
+        t.prodLeft[gid] = a.left[gid];
+        t.prodLen[gid] = a.length[gid];
+    }
+    t.startSymbol = a.startSymbol;
+    t.acceptGid = a.acceptGid;
+
+    for (int s = 0; s < T::stateCount; ++s)
+    {
+        for (int j = 0; j < T::nonterminalCount; ++j) t.gotoTable[s][j] = a.transition[s][(unsigned char)a.nonterminals[j]] - 1;
+        // 归约和运行时分析表一样由fillReduce填，冲突的判定相同
+        int row[256] = {};
+        for (int j = 0; j < T::terminalCount; ++j) row[(unsigned char)a.terminals[j]] = a.transition[s][(unsigned char)a.terminals[j]];
+
+        bool in[maxItems] = {};
+        closure(a, a.kernel[s], a.kernelSize[s], in);
+        for (int item = 0; item < a.itemCount; ++item)
+        {
+            int gid = a.itemGid[item];
+            if (!in[item] || a.itemDot[item] != a.length[gid]) continue;
+            int kinds = 0, c = 0;
+            fillReduce(row, gid, a.acceptGid, a.follow[(unsigned char)a.left[gid]], noPrecedence(), &kinds, &c);
+            if (kinds != 0 && a.error == errorNone)
+            {
+                a.error = (kinds & conflictShiftReduce) ? errorShiftReduce : errorReduceReduce;
+                a.errorState = s;
+                a.errorChar = (char)c;
+            }
+        }
+        for (int j = 0; j < T::terminalCount; ++j) t.action[s][j] = row[(unsigned char)a.terminals[j]];
+    }
+    return t;
+}
+
+// 填表时检查冲突
+template <class T>
+constexpr analysis checkTable(const analysis& result)
+{
+    analysis a = result;
+    if (a.error == errorNone) fillTable<T>(a);
+    return a;
+}
+
+template <class T>
+constexpr T buildTable(const analysis& result)
+{
+    analysis a = result;
+    return fillTable<T>(a);
+}
+
+// 每个文法字符串只分析一次
+template <const char* Grammar>
+struct compiled
+{
+    static constexpr analysis result = analyse(Grammar);
+    // 出错时各数量可能为0，至少给1，让static_assert报出真正的错误
+    using tableType = table<(result.stateCount > 0 ? result.stateCount : 1), (result.terminalCount > 0 ? result.terminalCount : 1),
+        (result.nonterminalCount > 0 ? result.nonterminalCount : 1), (result.productionCount > 0 ? result.productionCount : 1)>;
+
+    static constexpr errorKind error = checkTable<tableType>(result).error;
+    static_assert(error != errorSyntax, "文法格式错误，每行应为A->xyz");
+    static_assert(error != errorDirective, "编译期分析表不支持%声明");
+    static_assert(error != errorTooLarge, "文法超出编译期分析表的容量");
+    static_assert(error != errorUndefined, "右部用到了没有产生式的非终结符");
+    static_assert(error != errorShiftReduce, "不是SLR(1)文法：存在移进-归约冲突");
+    static_assert(error != errorReduceReduce, "不是SLR(1)文法：存在归约-归约冲突");
+};
+
+// 编译期生成Grammar的SLR(1)分析表；Grammar必须是静态存储的constexpr字符数组
+template <const char* Grammar>
+constexpr typename compiled<Grammar>::tableType makeTable()
+{
+    return buildTable<typename compiled<Grammar>::tableType>(compiled<Grammar>::result);
+}
+
+// 用分析表分析句子（跳过空白），编译期和运行时都可以用
+template <class T>
+constexpr bool parse(const T& t, const char* sentence, int* steps = nullptr)
+{
+    int stack[maxStack] = {};
+    int top = 0;
+    int pos = 0, n = 0;
+    while (true)
+    {
+        while (sentence[pos] == ' ' || sentence[pos] == '\t' || sentence[pos] == '\r' || sentence[pos] == '\n') ++pos;
+        char c = sentence[pos] == 0 ? '$' : sentence[pos];
+        int column = (unsigned char)c < 128 ? t.termColumn[(unsigned char)c] : -1;
+        // 句子中的$当作非法字符
+        int a = column < 0 || (c == '$' && sentence[pos] != 0) ? 0 : t.action[stack[top]][column];
+        ++n;
+        if (steps) *steps = n;
+        if (a == 0) return false;
+        if (a == acceptAction)
+        {
+            // 接受时开始符号的产生式下面只能是初始状态
+            return top == t.prodLen[t.acceptGid];
+        }
+        if (a > 0)
+        {
+            if (top + 1 == maxStack) return false;
+            stack[++top] = a - 1;
+            ++pos;
+            continue;
+        }
+        int gid = -a - 1;
+        top -= t.prodLen[gid];
+        int next = t.gotoTable[stack[top]][t.ntColumn[(unsigned char)t.prodLeft[gid]]];
+        if (next < 0 || top + 1 == maxStack) return false;
+        stack[++top] = next;
+    }
+}
+
+#endif // SLR1_COMPILE_TIME_TABLE
+
+}
+
+#endif // SLR1TABLE_H
@@ -0,0 +1,1644 @@
+﻿// 自检程序：qmake tests.pro 后 make check 运行，全部通过时返回0
+// 直接包含widget.cpp，内部函数不用另外导出
+#include "widget.cpp"
+
+#include <cstdio>
+
+int failures = 0;
+
+void check(bool ok, const string& what)
+{
+    if (ok) return;
+    ++failures;
+    cout << "失败：" << what << endl;
+}
+
+const string exprRules = "E->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->a";
+
+// 生成测试用的分析表，生成失败算一次失败
+runtimeTable compileText(const string& grammar, grammarContext& ctx)
+{
+    runtimeTable t;
+    string error;
+    check(compileGrammar(ctx, grammar, t, error), grammar + "：" + error);
+    return t;
+}
+
+// 分析表是否按预期接受或拒绝每个句子
+bool acceptsExactly(const runtimeTable& t, const vector<string>& accepted, const vector<string>& rejected)
+{
+    int steps = 0;
+    for (const string& s : accepted)
+    {
+        if (!parseSentence(t, s, steps, nullptr)) return false;
+    }
+    for (const string& s : rejected)
+    {
+        if (parseSentence(t, s, steps, nullptr)) return false;
+    }
+    return true;
+}
+
+/******************** 分段栈 ***************************/
+
+// 用vector实现的分析栈，接口和segmentedStack相同，作为比对的基准
+template <class T>
+struct vectorStack
+{
+    size_t limit = numeric_limits<size_t>::max();
+    vector<T> v;
+
+    size_t size() const { return v.size(); }
+    bool empty() const { return v.empty(); }
+    T& operator[](size_t i) { return v[i]; }
+    const T& operator[](size_t i) const { return v[i]; }
+    T& back() { return v.back(); }
+    const T& back() const { return v.back(); }
+    bool push_back(const T& value)
+    {
+        if (v.size() >= limit) return false;
+        v.push_back(value);
+        return true;
+    }
+    void pop_back() { v.pop_back(); }
+    void pop(size_t k) { v.resize(v.size() - k); }
+    void resize(size_t n) { v.resize(n); }
+    void assign(size_t n, const T& value) { v.assign(n, value); }
+    void clear() { v.clear(); }
+    void copyTop(size_t from, T* out) const { copy(v.begin() + from, v.end(), out); }
+};
+
+// 随机压栈、弹栈、下标读写，跨过段边界，和vector逐个比较
+void testSegmentedStack()
+{
+    mt19937 rng(7);
+    // 几个栈的段起点错开不同，都要检查
+    for (int round = 0; round < 20; ++round)
+    {
+        segmentedStack<int> a;
+        vectorStack<int> b;
+        if (round % 4 == 3) a.limit = b.limit = 10000;
+        bool same = true;
+        for (int op = 0; op < 20000 && same; ++op)
+        {
+            unsigned r = rng() % 10;
+            if (r < 5)
+            {
+                int value = (int)rng();
+                same = a.push_back(value) == b.push_back(value);
+            }
+            else if (r < 7 && !b.empty())
+            {
+                size_t k = rng() % (b.size() + 1);
+                a.pop(k);
+                b.pop(k);
+            }
+            else if (r < 8 && !b.empty())
+            {
+                size_t i = rng() % b.size();
+                int value = (int)rng();
+                a[i] = value;
+                b[i] = value;
+            }
+            else if (r < 9)
+            {
+                // 一次压很多，保证栈深到好几段
+                for (int k = 0; k < 3000; ++k) a.push_back(k), b.push_back(k);
+            }
+            else if (rng() % 50 == 0)
+            {
+                a.assign(1, 5);
+                b.assign(1, 5);
+            }
+            same = same && a.size() == b.size() && (b.empty() || a.back() == b.back());
+            if (same && !b.empty())
+            {
+                size_t from = rng() % b.size();
+                vector<int> x(b.size() - from), y(b.size() - from);
+                a.copyTop(from, x.data());
+                b.copyTop(from, y.data());
+                same = x == y;
+                for (size_t i = 0; i < b.size() && same; i += 97) same = a[i] == b[i];
+            }
+        }
+        check(same, "分段栈第" + to_string(round) + "轮和vector不一致");
+    }
+}
+
+/******************** 分析结果比对 ***************************/
+
+// 分析过程的全部输出拼成文本：结果、步数、错误、语法树、每一步的栈和动作
+template <class Workspace>
+string parseOutput(const runtimeTable& t, const string& sentence, Workspace& ws, bool recover)
+{
+    int steps = 0;
+    vector<parseDiagnostic> diagnostics;
+    traceLog trace;
+    treeArena arena;
+    treeNode* root = nullptr;
+    bool ok = parseSentenceImpl<true>(t, sentence, steps, &trace, recover ? &diagnostics : nullptr, &arena, &root, ws);
+    string out = (ok ? "接受 " : "出错 ") + to_string(steps) + "\n";
+    for (const auto& d : diagnostics)
+    {
+        out += to_string(d.pos) + " " + d.got + " " + to_string(d.state) + (d.tooDeep ? " 太深" : "") + "\n";
+    }
+    if (ok) out += treeToString(root, 1 << 20) + "\n";
+    for (int i = 0; i < (int)trace.steps.size(); ++i)
+    {
+        out += trace.stackText(i, true) + "|" + trace.stackText(i, false) + "|" + trace.inputText(i) + "|"
+            + trace.actionText(i) + "\n";
+    }
+    return out;
+}
+
+// 分段栈和vector栈分析同一批句子，输出要完全一样
+void compareWithVector(const string& name, const string& grammarText, int count, int length, size_t nestingLimit,
+    const vector<string>& extra)
+{
+    grammarContext ctx;
+    runtimeTable t;
+    string error;
+    if (!compileGrammar(ctx, grammarText, t, error))
+    {
+        check(false, name + "编译失败：" + error);
+        return;
+    }
+    vector<string> sentences = extra;
+    sentenceGenerator generator(ctx, 1);
+    mt19937 rng(3);
+    for (int i = 0; i < count && generator.productive(); ++i)
+    {
+        string s;
+        generator.generate(s, length, max(generator.minDepth(), 64));
+        sentences.push_back(s);
+        // 改坏一个字符，检查错误恢复
+        if (!s.empty())
+        {
+            s[rng() % s.length()] = s[rng() % s.length()];
+            s.erase(rng() % s.length(), 1);
+            sentences.push_back(s);
+        }
+    }
+    parseWorkspace segmented;
+    basicParseWorkspace<vectorStack> plain;
+    segmented.nestingLimit = plain.nestingLimit = nestingLimit;
+    int differ = 0;
+    for (const auto& s : sentences)
+    {
+        for (int recover = 0; recover < 2; ++recover)
+        {
+            if (parseOutput(t, s, segmented, recover) != parseOutput(t, s, plain, recover)) ++differ;
+        }
+    }
+    check(differ == 0, name + "有" + to_string(differ) + "次分析和vector栈不一致");
+}
+
+void testParseAgainstVector()
+{
+    // 嵌套比一段（4096）深，栈要跨段
+    string deep = string(10000, '(') + "a" + string(10000, ')');
+    string unbalanced = string(9000, '(') + "a" + string(8000, ')');
+    compareWithVector("括号嵌套", "A->(A)\nA->a", 50, 200, defaultNestingLimit, { deep, unbalanced, "((a)", "a)" });
+    compareWithVector("嵌套上限", "A->(A)\nA->a", 5, 50, 5000, { deep });
+    compareWithVector("表达式", "E->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->a", 200, 300, defaultNestingLimit,
+        { "a+*a", "(a+a", "a)a" });
+    compareWithVector("优先级", "%left +\n%left *\nE->E+E\nE->E*E\nE->(E)\nE->a", 200, 300, defaultNestingLimit, {});
+    compareWithVector("错误产生式", "%error e\nS->SLx\nS->Lx\nL->a\nL->e", 200, 100, defaultNestingLimit,
+        { "axbbxax", "bbb" });
+}
+
+/******************** 输入预处理 ***************************/
+
+// 逐字符去掉空白并找第一个不是终结符的字符，作为比对的基准
+int naiveScan(const bitset<128>& terminals, const string& sentence, string& out)
+{
+    out.clear();
+    int bad = -1;
+    for (unsigned char c : sentence)
+    {
+        if (c < 128 && isspace(c)) continue;
+        if (bad < 0 && !(c < 128 && terminals.test(c))) bad = out.length();
+        out += c;
+    }
+    return bad;
+}
+
+// 各种长度（跨过16、32字节块和结尾）的随机句子，每种实现都要和基准一致
+void testScanInput()
+{
+    bitset<128> terminals;
+    for (char c : string("a+*()")) terminals.set(c);
+    inputClassifier k = makeClassifier(terminals);
+    const string alphabet = "a+*() \t\n\r\v\f$b\x7f\x80\xff";
+    mt19937 rng(11);
+    int differ = 0;
+    for (int round = 0; round < 3000; ++round)
+    {
+        size_t n = round < 100 ? round : rng() % 300;
+        string s;
+        // 一部分句子只有终结符和空白
+        size_t choices = round % 3 == 0 ? 9 : alphabet.length();
+        for (size_t i = 0; i < n; ++i) s += alphabet[rng() % choices];
+        string expected, out;
+        int expectedBad = naiveScan(terminals, s, expected);
+        for (int level = scanScalar; level <= currentScanLevel; ++level)
+        {
+            int bad = scanInput(k, s, out, (scanLevel)level);
+            if (bad != expectedBad || out != expected) ++differ;
+        }
+    }
+    check(differ == 0, "输入预处理有" + to_string(differ) + "次和逐字符结果不一致（" +
+        scanLevelName(currentScanLevel) + "）");
+
+    // $不是终结符，标记后一定出错而不会被当成结束符
+    string out;
+    int bad = scanInput(k, "a + $a", out);
+    check(bad == 2 && out == "a+$a", "$应被报告为非法字符");
+    markInvalid(k, out, bad);
+    check(out[2] != '$', "非法字符应被替换");
+}
+
+/******************** 正则词法 ***************************/
+
+// 用单词声明直接生成词法分析器，生成失败算一次失败
+lexerTable lexerOf(const vector<tokenDef>& defs)
+{
+    lexerTable lexer;
+    string error;
+    check(buildLexer(defs, lexer, error), "词法定义：" + error);
+    return lexer;
+}
+
+string lexed(const lexerTable& lexer, const string& sentence)
+{
+    string out;
+    lexSentence(lexer, sentence, out);
+    return out;
+}
+
+void testLexer()
+{
+    // 最长匹配；一样长时先声明的优先，同一终结符的多条声明都能用
+    lexerTable words = lexerOf({ { 'i', "if" }, { 'n', "[a-z]+" }, { 'd', "[0-9]+" }, { 'd', "0x[0-9a-f]+" },
+        { 0, "\\s+" } });
+    check(lexed(words, "if iff x") == "inn", "一样长时应取先声明的单词");
+    check(lexed(words, "12 0x1f if0") == "ddid", "应按最长匹配切分");
+    string out;
+    check(lexSentence(words, "ab#c", out) == 1 && out == "n\x7fn", "无法识别的字符应写成0x7f并报告位置");
+
+    // (a|b)*abb的子集构造多出一个等价状态，最小化后是4个状态加死状态
+    lexerTable abb = lexerOf({ { 'x', "(a|b)*abb" } });
+    check(abb.stateCount == 5 && abb.dfaCount > abb.stateCount,
+        "最小化后应有5个状态，实际" + to_string(abb.stateCount) + "（子集构造" + to_string(abb.dfaCount) + "）");
+    check(lexed(abb, "abbbabb") == "x" && lexed(abb, "ab") == "\x7f\x7f", "最小化后应接受同样的单词");
+
+    lexerTable lexer;
+    string error;
+    check(!buildLexer({ { 'x', "(a" } }, lexer, error) && !error.empty(), "括号不匹配应报错");
+    check(!buildLexer({ { 'x', "a|*" } }, lexer, error) && !error.empty(), "*前面缺少内容应报错");
+
+    // 文法里的%token/%skip：没有声明的终结符按字面匹配，%skip代替默认的跳过空白
+    grammarContext ctx;
+    runtimeTable t = compileText("%token n [0-9]+\n%skip [ _]+\nE->E+n\nE->n", ctx);
+    check(acceptsExactly(t, { "12 + 345+6", "0__+_7" }, { "12 +", "1a", "1\t+2", "n+n" }), "%token文法分析结果不对");
+}
+
+/******************** 句子生成 ***************************/
+
+// 按种子生成一批句子，目标长度在[1, 40]内
+vector<string> generateCorpus(const grammarContext& ctx, unsigned long long seed, int count)
+{
+    sentenceGenerator gen(ctx, seed);
+    vector<string> corpus;
+    for (int i = 0; i < count; ++i)
+    {
+        string s;
+        gen.generate(s, gen.randomIn(1, 40), max(64, gen.minDepth()));
+        corpus.push_back(s);
+    }
+    return corpus;
+}
+
+// 生成的句子都能被分析表接受；同样的种子生成同样的句子；长度和深度不超过给定的上限
+void testGenerator()
+{
+    for (const string& grammar : { exprRules, string("%left +\n%left *\nE->E+E\nE->E*E\nE->(E)\nE->a"),
+        string("%token n [0-9]+\n%token i [a-z]+\n%skip [ ]+\nE->E+T\nE->T\nT->n\nT->i(E)") })
+    {
+        grammarContext ctx;
+        runtimeTable t = compileText(grammar, ctx);
+        vector<string> corpus = generateCorpus(ctx, 42, 300);
+        int rejected = 0;
+        for (const string& s : corpus)
+        {
+            int steps = 0;
+            if (!parseSentence(t, s, steps, nullptr)) ++rejected;
+        }
+        check(rejected == 0, grammar + "：生成的句子有" + to_string(rejected) + "句不被接受");
+        check(generateCorpus(ctx, 42, 300) == corpus, grammar + "：同样的种子应生成同样的句子");
+        check(generateCorpus(ctx, 43, 300) != corpus, grammar + "：不同的种子应生成不同的句子");
+    }
+
+    // 没有词法分析器时每个终结符一个字符；表达式文法的句子长度都是奇数，和目标最多差1
+    grammarContext ctx;
+    compileText(exprRules, ctx);
+    sentenceGenerator gen(ctx, 7);
+    int far = 0;
+    for (int target = 1; target <= 60; ++target)
+    {
+        string s;
+        gen.generate(s, target, 64);
+        far += abs((int)s.length() - target) > 1;
+    }
+    check(far == 0, "有" + to_string(far) + "句的长度偏离目标");
+
+    // S->(S)的深度受限时只能在上限内加括号，目标长度再大也会结束（增广后开始符号多一层）
+    grammarContext nested;
+    compileText("S->(S)\nS->a", nested);
+    sentenceGenerator deep(nested, 7);
+    check(deep.productive() && deep.minDepth() == 2, "S->a的最浅深度应为2");
+    for (int maxDepth : { 2, 3, 20 })
+    {
+        string s;
+        deep.generate(s, 1000, maxDepth);
+        check(s == string(maxDepth - 2, '(') + "a" + string(maxDepth - 2, ')'),
+            "深度上限" + to_string(maxDepth) + "时生成了" + s);
+    }
+}
+
+/******************** 批量分析 ***************************/
+// 多线程共享只读的分析表，每句的结果、总步数与线程数、是否建树无关
+
+// 运行batchMain，输出丢掉
+int runBatchMain(const vector<string>& args)
+{
+    vector<string> copy = args;
+    vector<char*> argv;
+    for (string& a : copy) argv.push_back(&a[0]);
+    ostringstream sink;
+    streambuf* out = cout.rdbuf(sink.rdbuf());
+    streambuf* err = cerr.rdbuf(sink.rdbuf());
+    int status = batchMain(argv.size(), argv.data());
+    cout.rdbuf(out);
+    cerr.rdbuf(err);
+    return status;
+}
+
+void writeFile(const string& path, const string& text)
+{
+    ofstream out(path, ios::binary | ios::trunc);
+    out << text;
+}
+
+void testParseBatch()
+{
+    grammarContext ctx;
+    runtimeTable t = compileText(exprRules, ctx);
+    sentenceGenerator generator(ctx, 5);
+    mt19937 rng(34);
+    vector<string> sentences;
+    for (int i = 0; i < 3000; ++i)
+    {
+        string s;
+        generator.generate(s, 1 + i % 60, max(generator.minDepth(), 32));
+        // 三分之一改坏一个字符（仍然都是终结符，不走非法字符的捷径）
+        if (i % 3 == 1) s[rng() % s.length()] = "+*()a"[rng() % 5];
+        sentences.push_back(s);
+    }
+    vector<char> expected;
+    long long accepted = 0, steps = 0;
+    for (const string& s : sentences)
+    {
+        int n = 0;
+        bool ok = parseSentence(t, s, n, nullptr);
+        expected.push_back(ok ? outcomeAccepted : outcomeRejected);
+        accepted += ok;
+        steps += n;
+    }
+    check(accepted > 1000 && accepted < 3000, "句子应该有接受也有不接受的");
+    for (int threads : { 1, 3, 8 })
+    {
+        for (bool buildTree : { false, true })
+        {
+            vector<char> results;
+            batchResult r = parseBatch(t, sentences, threads, buildTree, &results);
+            check(results == expected && r.sentences == (long long)sentences.size() && r.accepted == accepted && r.steps == steps
+                    && r.threads == threads,
+                to_string(threads) + "个线程" + (buildTree ? "建树" : "") + "的批量分析结果不同");
+        }
+    }
+
+    // 命令行：全部接受返回0，有不接受的返回1，文法错误返回1（没有QApplication时不能弹出对话框）
+    writeFile("tests_batch_grammar.txt", exprRules);
+    writeFile("tests_batch_bad.txt", "e->a\n");
+    writeFile("tests_batch_sentences.txt", "a+a\n(a)*a\n");
+    writeFile("tests_batch_rejected.txt", "a+a\na+\n");
+    check(runBatchMain({ "tests", "--batch", "tests_batch_grammar.txt", "tests_batch_sentences.txt", "-j", "2" }) == 0,
+        "--batch全部接受时应该返回0");
+    check(runBatchMain({ "tests", "--batch", "tests_batch_grammar.txt", "tests_batch_rejected.txt", "--tree" }) == 1,
+        "--batch有不接受的句子时应该返回1");
+    check(runBatchMain({ "tests", "--batch", "tests_batch_bad.txt", "tests_batch_sentences.txt" }) == 1,
+        "--batch文法错误时应该返回1");
+    for (const char* path : { "tests_batch_grammar.txt", "tests_batch_bad.txt", "tests_batch_sentences.txt", "tests_batch_rejected.txt" })
+    {
+        remove(path);
+    }
+}
+
+/******************** 内存分配统计 ***************************/
+
+// 阶段切换可以嵌套；定义了SLR_COUNT_ALLOCATIONS时，复用工作区的句子分析不再分配，上限文件按阶段检查
+void testAllocations()
+{
+    {
+        allocPhase outer(phaseTable);
+        {
+            allocPhase inner(phaseParse);
+            inner.enter(phaseRuntime);
+            check(currentAllocPhase == phaseRuntime, "enter应切换当前阶段");
+        }
+        check(currentAllocPhase == phaseTable, "内层结束后应恢复外层阶段");
+    }
+    check(currentAllocPhase == phaseOther, "外层结束后应恢复为other");
+    check(checkAllocations(false, "", 5) == 5, "不统计时应返回原来的结果");
+
+#ifndef SLR_COUNT_ALLOCATIONS
+    check(checkAllocations(false, "tests_budget.txt", 0) == 2, "没有统计时要求检查上限应报错");
+#else
+    grammarContext ctx;
+    runtimeTable t = compileText(exprRules, ctx);
+    // 句子先准备好，只有分析本身算在parse阶段
+    vector<string> sentences;
+    for (int depth = 0; depth < 2000; depth += 7)
+    {
+        string s = string(depth, '(') + "a" + string(depth, ')') + "*a+a";
+        sentences.push_back(s);
+        sentences.push_back(s + "+");
+    }
+    parseWorkspace ws;
+    int steps = 0;
+    long long warm, after;
+    {
+        allocPhase phase(phaseParse);
+        long long before = allocCount[phaseParse];
+        parseSentenceImpl<false>(t, sentences.back(), steps, nullptr, nullptr, nullptr, nullptr, ws);
+        warm = allocCount[phaseParse];
+        for (const string& s : sentences) parseSentenceImpl<false>(t, s, steps, nullptr, nullptr, nullptr, nullptr, ws);
+        after = allocCount[phaseParse];
+        check(warm > before, "第一次分析应分配工作区的栈");
+    }
+    check(after == warm, "复用工作区的句子分析又分配了" + to_string(after - warm) + "次");
+
+    const char* path = "tests_budget.txt";
+    writeFile(path, "# 注释\nparse 1000000 1000000000\n");
+    check(checkAllocations(false, path, 1) == 1, "没有超出上限时应返回原来的结果");
+    writeFile(path, "grammar 1000000 1000000000\nparse 0 0\n");
+    check(checkAllocations(false, path, 0) == 3, "超出上限应返回3");
+    writeFile(path, "parsing 1 1\n");
+    check(checkAllocations(false, path, 0) == 2, "未知的阶段应报格式错误");
+    writeFile(path, "parse 1\n");
+    check(checkAllocations(false, path, 0) == 2, "缺少字节数应报格式错误");
+    remove(path);
+    check(checkAllocations(false, path, 0) == 2, "上限文件不存在应报错");
+#endif
+}
+
+/******************** 分析表文件 ***************************/
+
+// 改写文件里id段第index个元素（按T解释）并重新计算散列后载入，verify为false时只检查文件头和产生式
+// 载入失败返回-1，否则返回用它分析sentence的结果（改坏的表项在分析中遇到时当作出错，不会越界）
+template <class T>
+int loadCorrupted(const string& path, const string& bytes, tableSectionId id, size_t index, T value, bool verify,
+    const string& sentence = "1+2")
+{
+    string copy = bytes;
+    tableFileHeader h;
+    memcpy(&h, copy.data(), sizeof(h));
+    memcpy(&copy[h.sections[id].offset + index * sizeof(T)], &value, sizeof(T));
+    h.checksum = tableChecksum((const unsigned char*)copy.data() + sizeof(h), copy.size() - sizeof(h));
+    memcpy(&copy[0], &h, sizeof(h));
+    {
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(copy.data(), copy.size());
+    }
+    mappedTable mapped;
+    string error;
+    if (!mapped.load(path, verify, error)) return -1;
+    int steps = 0;
+    return parseSentence(mapped.table(), sentence, steps, nullptr) ? 1 : 0;
+}
+
+void testTableFile()
+{
+    grammarContext ctx;
+    runtimeTable t;
+    string error;
+    const string path = "tests_table.slrt";
+    check(compileGrammar(ctx, "%token n [0-9]+\n%skip [ ]+\nE->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->n", t, error), error);
+    check(saveTableFile(ctx, t, path, error), error);
+    string bytes;
+    {
+        ifstream in(path, ios::binary);
+        bytes.assign(istreambuf_iterator<char>(in), istreambuf_iterator<char>());
+    }
+    {
+        mappedTable mapped;
+        check(mapped.load(path, true, error), "载入分析表文件：" + error);
+        const runtimeTable& m = mapped.table();
+        int a = 0, b = 0;
+        for (const string& s : { string("1+2*(3+4)"), string("1+*2"), string("1+$") })
+        {
+            check(parseSentence(t, s, a, nullptr) == parseSentence(m, s, b, nullptr) && a == b,
+                "载入的表分析" + s + "结果不同");
+        }
+        // 集合按两个64位整数写入，载入后逐位相同
+        bool same = true;
+        for (int i = 0; i < t.stateCount; ++i) same = same && memcmp(t.expected[i].w, m.expected[i].w, sizeof(charBits)) == 0;
+        for (int i = 0; i < 128; ++i) same = same && memcmp(t.followBits[i].w, m.followBits[i].w, sizeof(charBits)) == 0;
+        for (int c = 0; c < 256; ++c) same = same && t.classifier.isTerminal[c] == m.classifier.isTerminal[c];
+        check(same && m.expected[0].test('n') && !m.expected[0].test('+'), "载入的期望终结符、Follow集合或输入分类不同");
+    }
+    int states = t.stateCount, productions = t.prodLeft.size();
+    size_t lexerRow = t.lexer.classCount + t.lexer.charClass['1']; // 词法分析器开始状态读入数字
+    int unit = -1; // 一条右部长度为1的产生式
+    for (int g = 0; g < productions; ++g)
+    {
+        if (t.prodLen[g] == 1) unit = g;
+    }
+    // 表项越界：--verify时载入就发现，否则载入不检查，分析遇到时出错
+    check(loadCorrupted(path, bytes, sectionAction, 'n', states + 1, true) == -1, "移进到不存在的状态没有被发现");
+    check(loadCorrupted(path, bytes, sectionAction, 'n', states + 1, false) == 0, "分析中没有发现移进到不存在的状态");
+    check(loadCorrupted(path, bytes, sectionAction, '(', -productions - 1, true) == -1, "按不存在的产生式归约没有被发现");
+    check(loadCorrupted(path, bytes, sectionAction, '(', -productions - 1, false, "(1)") == 0, "分析中没有发现按不存在的产生式归约");
+    check(loadCorrupted(path, bytes, sectionGoto, 'E', states, true) == -1, "goto到不存在的状态没有被发现");
+    check(loadCorrupted(path, bytes, sectionGoto, 'E', states, false) == 0, "分析中没有发现goto到不存在的状态");
+    check(loadCorrupted(path, bytes, sectionLexerNext, lexerRow, 1 << 20, true) == -1, "词法分析表越界没有被发现");
+    check(loadCorrupted(path, bytes, sectionLexerNext, lexerRow, 1 << 20, false) == 0, "分析中没有发现词法分析表越界");
+    // 归约时栈里的状态不够：各项都在范围内，只能在分析中发现
+    check(unit >= 0 && loadCorrupted(path, bytes, sectionAction, 'n', -unit - 1, true) == 0, "归约时栈里的状态不够没有被发现");
+    // 产生式和字符类不论是否--verify都在载入时检查
+    check(loadCorrupted(path, bytes, sectionProdLeft, 1, (char)-56, false) == -1, "产生式左部越界没有被发现");
+    check(loadCorrupted(path, bytes, sectionProdLen, 1, 1000, false) == -1, "产生式长度越界没有被发现");
+    check(loadCorrupted(path, bytes, sectionLexerClass, 40, (unsigned char)255, false) == -1, "字符类越界没有被发现");
+    check(loadCorrupted(path, bytes, sectionAction, 5, 0, true) != -1, "改成出错的表项应该能载入");
+    // 散列只在--verify时计算
+    {
+        string copy = bytes;
+        tableFileHeader h;
+        memcpy(&h, copy.data(), sizeof(h));
+        copy[h.sections[sectionRuleText].offset] ^= 1;
+        ofstream out(path, ios::binary | ios::trunc);
+        out.write(copy.data(), copy.size());
+    }
+    mappedTable mapped;
+    check(mapped.load(path, false, error) && !mapped.load(path, true, error), "--verify时没有校验散列");
+    remove(path.c_str());
+}
+
+// 按需生成的自动机只分析过一句时导出，展开后的表应该和直接建的表分析结果一样
+void testLazySnapshot()
+{
+    const string grammar = "E->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->a";
+    lazyAutomaton lazy;
+    grammarContext ctx;
+    runtimeTable built;
+    string error;
+    check(lazy.prepare(grammar, error) && compileGrammar(ctx, grammar, built, error), error);
+    parseWorkspace ws;
+    int steps = 0;
+    parseLazy(lazy, "a", steps, ws);
+    check(lazy.expandedCount() < built.stateCount, "只分析一句时不应该展开全部状态");
+    check(lazy.expandAll() && lazy.conflictCount() == 0, "展开全部状态失败");
+    runtimeTable t = lazy.snapshot();
+    sentenceGenerator generator(ctx, 3);
+    int differ = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        string s;
+        generator.generate(s, 1 + i % 50, max(generator.minDepth(), 32));
+        int a = 0, b = 0;
+        if (parseSentence(t, s, a, nullptr) != parseSentence(built, s, b, nullptr) || a != b) ++differ;
+    }
+    check(differ == 0, "展开后导出的表有" + to_string(differ) + "句结果不同");
+}
+
+/******************** 分析表与文法的语言 ***************************/
+// 随机文法上，各种分析表接受的句子要和直接按文法推导的结果一样
+
+// 文法原文中的产生式，右部为空串时是""
+typedef vector<pair<char, string>> plainGrammar;
+
+plainGrammar readPlainGrammar(const string& text)
+{
+    plainGrammar rules;
+    istringstream iss(text);
+    string line;
+    while (getline(iss, line))
+    {
+        if (line.length() < 3 || line.compare(1, 2, "->") != 0) continue;
+        string right = line.substr(3);
+        rules.push_back(make_pair(line[0], right == "@" ? string() : right));
+    }
+    return rules;
+}
+
+// Earley识别器，作为判断句子是否属于文法的基准；每个集合反复扫描到不再增加，可空的非终结符也能正确完成
+bool derivable(const plainGrammar& rules, const string& s)
+{
+    typedef tuple<int, int, int> item; // 产生式、点的位置、起点
+    vector<set<item>> sets(s.length() + 1);
+    for (int r = 0; r < (int)rules.size(); ++r)
+    {
+        if (rules[r].first == rules[0].first) sets[0].insert(item(r, 0, 0));
+    }
+    for (size_t i = 0; i <= s.length(); ++i)
+    {
+        size_t before;
+        do
+        {
+            before = sets[i].size();
+            vector<item> items(sets[i].begin(), sets[i].end());
+            for (const item& it : items)
+            {
+                int r = get<0>(it), dot = get<1>(it), origin = get<2>(it);
+                const string& right = rules[r].second;
+                if (dot < (int)right.length())
+                {
+                    char x = right[dot];
+                    if (isupper((unsigned char)x))
+                    {
+                        for (int r2 = 0; r2 < (int)rules.size(); ++r2)
+                        {
+                            if (rules[r2].first == x) sets[i].insert(item(r2, 0, (int)i));
+                        }
+                    }
+                    else if (i < s.length() && s[i] == x) sets[i + 1].insert(item(r, dot + 1, origin));
+                    continue;
+                }
+                vector<item> waiting(sets[origin].begin(), sets[origin].end());
+                for (const item& w : waiting)
+                {
+                    const string& wr = rules[get<0>(w)].second;
+                    if (get<1>(w) < (int)wr.length() && wr[get<1>(w)] == rules[r].first)
+                    {
+                        sets[i].insert(item(get<0>(w), get<1>(w) + 1, get<2>(w)));
+                    }
+                }
+            }
+        } while (sets[i].size() != before);
+    }
+    for (const item& it : sets[s.length()])
+    {
+        int r = get<0>(it);
+        if (get<2>(it) == 0 && rules[r].first == rules[0].first && get<1>(it) == (int)rules[r].second.length()) return true;
+    }
+    return false;
+}
+
+// 终结符集合上长度不超过maxLength的全部句子
+vector<string> allSentences(const string& terminals, size_t maxLength)
+{
+    vector<string> result(1, string());
+    for (size_t begin = 0; begin < result.size(); ++begin)
+    {
+        if (result[begin].length() == maxLength) continue;
+        for (char c : terminals) result.push_back(result[begin] + c);
+    }
+    return result;
+}
+
+string randomGrammar(mt19937& rng)
+{
+    const string nonterminals = "SAB", symbols = "SABabc";
+    int count = 2 + rng() % 5;
+    string text;
+    for (int i = 0; i < count; ++i)
+    {
+        text += i == 0 ? 'S' : nonterminals[rng() % nonterminals.length()];
+        text += "->";
+        int length = rng() % 4;
+        if (length == 0) text += "@";
+        for (int k = 0; k < length; ++k) text += symbols[rng() % symbols.length()];
+        text += "\n";
+    }
+    return text;
+}
+
+// 一个文法：生成得出的每种分析表都和推导结果比较，返回不一致的句子数
+int compareWithDerivation(const string& grammar, const vector<string>& sentences, const string& name)
+{
+    plainGrammar rules = readPlainGrammar(grammar);
+    grammarContext ctx;
+    string error;
+    if (!prepareGrammar(ctx, grammar, error)) return 0;
+    getLR0(ctx);
+    vector<pair<string, runtimeTable>> tables;
+    if (getSLR1Table(ctx) == 0) tables.push_back(make_pair("SLR(1)", buildRuntimeTable(ctx, ctx.SLRVector)));
+    if (getLALR1Table(ctx) == 0) tables.push_back(make_pair("LALR(1)", buildRuntimeTable(ctx, ctx.LALRVector)));
+    if (getLR1Table(ctx) == 0) tables.push_back(make_pair("LR(1)", buildRuntimeTable(ctx, ctx.LR1Vector)));
+    size_t built = tables.size();
+    for (size_t i = 0; i < built; ++i)
+    {
+        runtimeTable t = tables[i].second;
+        eliminateUnitReductions(ctx, t);
+        tables.push_back(make_pair(tables[i].first + "绕过单产生式", t));
+        t = tables[i].second;
+        minimizeStates(t);
+        tables.push_back(make_pair(tables[i].first + "最小化", t));
+    }
+    glrTable glr;
+    buildGLRTable(ctx, glr);
+    glrParser glrp;
+    int differ = 0;
+    for (const string& s : sentences)
+    {
+        bool expected = derivable(rules, s);
+        for (const auto& t : tables)
+        {
+            int steps = 0;
+            if (parseSentence(t.second, s, steps, nullptr) == expected) continue;
+            if (++differ <= 3) cout << name << " " << t.first << "：\"" << s << "\"应该" << (expected ? "接受" : "拒绝") << endl;
+        }
+        glrResult r;
+        if (glrp.parse(glr, s, r) != expected && ++differ <= 3)
+        {
+            cout << name << " GLR：\"" << s << "\"应该" << (expected ? "接受" : "拒绝") << endl;
+        }
+    }
+    return differ;
+}
+
+void testAgainstDerivation()
+{
+    vector<string> sentences = allSentences("abc", 5);
+    // SLR1只比较不同左部的归约-归约冲突时，这两个文法会得到错误的SLR表
+    check(compareWithDerivation("S->@\nS->Aa\nA->AaS\nA->Ac\nA->b", sentences, "同左部归约冲突1") == 0,
+        "同左部的归约-归约冲突没有发现");
+    check(compareWithDerivation("S->Ab\nS->SSc\nA->@\nA->aS", sentences, "同左部归约冲突2") == 0,
+        "同左部的归约-归约冲突没有发现");
+    mt19937 rng(2024);
+    int bad = 0;
+    for (int i = 0; i < 400; ++i)
+    {
+        string grammar = randomGrammar(rng);
+        if (compareWithDerivation(grammar, sentences, "随机文法" + to_string(i)) != 0)
+        {
+            ++bad;
+            cout << grammar;
+        }
+    }
+    check(bad == 0, "有" + to_string(bad) + "个随机文法的分析结果和推导不同");
+}
+
+/******************** 文法化简 ***************************/
+// 推不出终结符串或者从开始符号不可达的非终结符，在求First集合和LR(0)之前连同它们的产生式删掉
+
+void testPruneGrammar()
+{
+    // A推不出终结符串，B不可达；删掉后和直接写剩下的产生式一样
+    const string grammar = "S->aS\nS->b\nS->A\nA->Aa\nB->b\nS->C\nC->c";
+    grammarContext ctx, plain;
+    string error;
+    check(prepareGrammar(ctx, grammar, error) && prepareGrammar(plain, "S->aS\nS->b\nS->C\nC->c", error), error);
+    bool clean = true;
+    for (const grammarUnit& g : ctx.grammarDeque)
+    {
+        clean = clean && g.left != 'A' && g.left != 'B' && g.right.find('A') == string::npos;
+    }
+    check(clean && ctx.grammarDeque.size() == plain.grammarDeque.size() && ctx.grammarMap.count('A') == 0
+        && ctx.grammarMap.count('B') == 0, "无用的产生式没有删掉");
+    string report = ctx.LR0Result.toStdString();
+    check(report.find("化简删除了3条产生式") != string::npos && report.find("无用符号：A B") != string::npos,
+        "没有报告删除的产生式和符号：" + report);
+    getLR0(ctx);
+    getLR0(plain);
+    check(ctx.dfaStateVector.size() == plain.dfaStateVector.size(), "化简后的LR(0)状态数应该和手写的文法相同");
+    check(getSLR1Table(ctx) == 0, "化简后应该没有冲突");
+    runtimeTable t = buildRuntimeTable(ctx, ctx.SLRVector);
+    check(acceptsExactly(t, { "b", "aab", "c", "aac" }, { "a", "aa", "ba" }), "化简后分析结果不对");
+    // 编号重新连续，分析表按新编号归约
+    for (size_t i = 0; i < ctx.grammarDeque.size(); ++i)
+    {
+        const grammarUnit& g = ctx.grammarDeque[i];
+        check(ctx.grammarToInt[make_pair(g.left, g.right)] == (int)i, "化简后的产生式编号不连续");
+    }
+
+    // 开始符号本身推不出终结符串时语言为空，不做删除
+    grammarContext empty;
+    check(prepareGrammar(empty, "S->aS\nS->A\nA->Ab", error), error);
+    check(empty.grammarToInt.count(make_pair('A', string("Ab"))) > 0 && empty.LR0Result.toStdString().find("未进行化简") != string::npos,
+        "开始符号推不出终结符串时不应该删除");
+}
+
+/******************** LALR(1)分析 ***************************/
+// 在LR(0)自动机上求向前看符号：状态数与LR(0)相同，能解决Follow集合太粗造成的冲突
+
+// 不是SLR(1)但是LALR(1)的文法（L为左值，R为右值）
+const string lvalueGrammar = "S->L=R\nS->R\nL->*R\nL->a\nR->L";
+// 是LR(1)但不是LALR(1)的文法：合并同心状态后A->c.和B->c.的向前看符号相同
+const string nonLALRGrammar = "S->aAd\nS->bBd\nS->aBe\nS->bAe\nA->c\nB->c";
+
+void testLALR()
+{
+    grammarContext ctx;
+    string error;
+    check(prepareGrammar(ctx, lvalueGrammar, error), error);
+    getLR0(ctx);
+    check(getSLR1Table(ctx) == 1, "L=R文法应该有SLR(1)移进-归约冲突");
+    check(getLALR1Table(ctx) == 0, "L=R文法应该是LALR(1)文法");
+    check(ctx.LALRVector.size() == ctx.dfaStateVector.size(), "LALR(1)的状态数应该和LR(0)相同");
+    // 含S->L.=R和R->L.的状态：Follow(R)含=，但这里R->L只能在$前归约
+    int gid = ctx.grammarToInt[make_pair('R', string("L"))];
+    bool found = false;
+    for (const dfaState& ds : ctx.dfaStateVector)
+    {
+        for (int cellid : ds.cellV)
+        {
+            const dfaCell& cell = ctx.dfaCellVector[cellid];
+            if (cell.gid != gid || cell.index != 1) continue;
+            bool shiftsEqual = false;
+            for (const auto& next : ds.nextStateVector) shiftsEqual = shiftsEqual || next.c == '=';
+            if (!shiftsEqual) continue;
+            found = true;
+            check(ctx.lalrLookahead[make_pair(ds.sid, gid)] == set<char>{ '$' }, "R->L.的向前看符号应该只有$");
+        }
+    }
+    check(found, "没有找到含S->L.=R和R->L.的状态");
+    runtimeTable t = buildRuntimeTable(ctx, ctx.LALRVector);
+    check(acceptsExactly(t, { "a", "*a", "a=a", "*a=**a", "**a" }, { "a=", "=a", "a=a=a", "*", "" }), "LALR(1)表分析结果不对");
+
+    grammarContext other;
+    check(prepareGrammar(other, nonLALRGrammar, error), error);
+    getLR0(other);
+    check(getLALR1Table(other) == 2, "合并同心状态后应该有归约-归约冲突");
+}
+
+/******************** 最小LR(1)分析 ***************************/
+// 构造中按Pager弱相容合并状态：分析能力与规范LR(1)相同，状态数接近LALR(1)
+
+void testMinimalLR1()
+{
+    grammarContext ctx;
+    string error;
+    check(prepareGrammar(ctx, nonLALRGrammar, error), error);
+    getLR0(ctx);
+    check(getLR1Table(ctx) == 0, "非LALR(1)的LR(1)文法不应该有冲突");
+    vector<lr1State> canonical;
+    check(buildLR1States(ctx, canonical, false), "规范LR(1)构造失败");
+    check(ctx.lr1StateVector.size() <= canonical.size(), "合并后的状态数不应该超过规范LR(1)");
+    runtimeTable t = buildRuntimeTable(ctx, ctx.LR1Vector);
+    check(acceptsExactly(t, { "acd", "bcd", "ace", "bce" }, { "acc", "ad", "abd", "acde" }), "最小LR(1)表分析结果不对");
+
+    // LALR(1)文法上合并到LR(0)的状态数，规范LR(1)要多得多
+    grammarContext expr;
+    check(prepareGrammar(expr, exprRules, error), error);
+    getLR0(expr);
+    check(getLR1Table(expr) == 0, "表达式文法不应该有冲突");
+    canonical.clear();
+    check(buildLR1States(expr, canonical, false), "规范LR(1)构造失败");
+    check(expr.lr1StateVector.size() == expr.dfaStateVector.size() && canonical.size() > expr.dfaStateVector.size(),
+        "表达式文法合并后的状态数应该等于LR(0)：" + to_string(expr.lr1StateVector.size()) + "，规范LR(1)："
+            + to_string(canonical.size()));
+}
+
+/******************** 文法上下文 ***************************/
+
+template <class T>
+bool sameArray(const tableArray<T>& a, const tableArray<T>& b)
+{
+    return a.size() == b.size() && equal(a.data(), a.data() + a.size(), b.data());
+}
+
+bool sameTable(const runtimeTable& a, const runtimeTable& b)
+{
+    return a.stateCount == b.stateCount && sameArray(a.action, b.action) && sameArray(a.gotoTable, b.gotoTable)
+        && sameArray(a.prodLeft, b.prodLeft) && sameArray(a.prodLen, b.prodLen)
+        && a.lexer.stateCount == b.lexer.stateCount && sameArray(a.lexer.next, b.lexer.next);
+}
+
+// 各线程各用一个上下文同时生成分析表，结果和单线程依次生成的一样；上下文移动后照常可用
+void testGrammarContext()
+{
+    const vector<string> grammars = { exprRules, lvalueGrammar, nonLALRGrammar,
+        "%left +\n%left *\nE->E+E\nE->E*E\nE->(E)\nE->a", "%token n [0-9]+\nE->E+n\nE->n" };
+    vector<runtimeTable> expected;
+    for (const string& g : grammars)
+    {
+        grammarContext ctx;
+        expected.push_back(compileText(g, ctx));
+    }
+
+    const int threads = 8, rounds = 5;
+    vector<int> differ(threads);
+    vector<thread> workers;
+    for (int w = 0; w < threads; ++w)
+    {
+        workers.emplace_back([&, w]
+        {
+            grammarContext ctx;
+            for (int r = 0; r < rounds; ++r)
+            {
+                // 每个线程从不同的文法开始，同一时刻各线程处在不同的阶段
+                for (size_t i = 0; i < grammars.size(); ++i)
+                {
+                    size_t k = (i + w) % grammars.size();
+                    runtimeTable t;
+                    string error;
+                    if (!compileGrammar(ctx, grammars[k], t, error) || !sameTable(t, expected[k])) ++differ[w];
+                }
+            }
+        });
+    }
+    for (auto& th : workers) th.join();
+    check(accumulate(differ.begin(), differ.end(), 0) == 0, "多线程生成的分析表和单线程的不同");
+
+    grammarContext ctx;
+    compileText(nonLALRGrammar, ctx);
+    size_t states = ctx.dfaStateVector.size(), lr1States = ctx.LR1Vector.size();
+    grammarContext moved = move(ctx);
+    check(moved.dfaStateVector.size() == states && moved.LR1Vector.size() == lr1States, "移动后的上下文应保留分析结果");
+    runtimeTable t;
+    string error;
+    check(compileGrammar(moved, exprRules, t, error) && sameTable(t, expected[0]), "移动后的上下文应能继续使用");
+    check(compileGrammar(ctx, lvalueGrammar, t, error) && sameTable(t, expected[1]), "被移走的上下文应能重新使用");
+}
+
+/******************** LR(0)DFA图 ***************************/
+
+// 分批布局：放好的状态不再移动，层号是从状态0出发的最短距离，同一位置只有一个状态；合并的边束覆盖所有非自环的边
+void testDfaGraphLayout()
+{
+    for (const string& grammar : { exprRules, lvalueGrammar, string("S->aSb\nS->aSc\nS->d") })
+    {
+        grammarContext ctx;
+        compileText(grammar, ctx);
+        int n = ctx.dfaStateVector.size();
+        vector<int> distance(n, -1);
+        deque<int> queue(1, 0);
+        distance[0] = 0;
+        int edgeCount = 0;
+        while (!queue.empty())
+        {
+            int s = queue.front();
+            queue.pop_front();
+            for (const auto& next : ctx.dfaStateVector[s].nextStateVector)
+            {
+                edgeCount += next.sid != s;
+                if (distance[next.sid] != -1) continue;
+                distance[next.sid] = distance[s] + 1;
+                queue.push_back(next.sid);
+            }
+        }
+
+        dfaGraphItem graph(ctx);
+        check(graph.stateCount() == n && graph.layerOf(0) == 0, grammar + "：开始状态应在第0层");
+        vector<pair<double, double>> placed(n);
+        bool moved = false;
+        int batches = 0;
+        for (bool done = false; !done; ++batches)
+        {
+            done = graph.layoutSome(1);
+            for (int s = 0; s < n; ++s)
+            {
+                if (graph.layerOf(s) == -1) continue;
+                pair<double, double> p(graph.position(s).x(), graph.position(s).y());
+                if (placed[s].first == 0 && placed[s].second == 0) placed[s] = p;
+                else if (placed[s] != p) moved = true;
+            }
+        }
+        check(!moved, grammar + "：已布局的状态不应移动");
+        check(batches > 1, grammar + "：每批只展开一个状态时应分多批完成");
+        bool layered = true;
+        for (int s = 0; s < n; ++s) layered = layered && graph.layerOf(s) == distance[s];
+        check(layered, grammar + "：层号应为广度优先的距离");
+        check(set<pair<double, double>>(placed.begin(), placed.end()).size() == (size_t)n, grammar + "：状态位置重叠");
+        vector<int> sizes = graph.bundleSizes();
+        check(accumulate(sizes.begin(), sizes.end(), 0) == edgeCount && (int)sizes.size() < edgeCount,
+            grammar + "：边束应合并全部" + to_string(edgeCount) + "条边");
+    }
+}
+
+/******************** 状态最小化 ***************************/
+
+// 把每个状态复制一份，随机把一部分移进和goto改指向副本，得到状态数翻倍、语言不变的分析表
+runtimeTable withDuplicates(const runtimeTable& t, mt19937& rng)
+{
+    runtimeTable d = t;
+    int n = t.stateCount;
+    d.stateCount = 2 * n;
+    d.action.resize(2 * n * 128);
+    d.gotoTable.resize(2 * n * 128);
+    d.expected.resize(2 * n);
+    for (int s = 0; s < n; ++s)
+    {
+        for (int c = 0; c < 128; ++c)
+        {
+            d.action.edit((n + s) * 128 + c) = t.action[s * 128 + c];
+            d.gotoTable.edit((n + s) * 128 + c) = t.gotoTable[s * 128 + c];
+        }
+        d.expected.edit(n + s) = t.expected[s];
+    }
+    for (int x = 0; x < 2 * n * 128; ++x)
+    {
+        int a = d.action[x], g = d.gotoTable[x];
+        if (a > 0 && a != acceptAction && rng() % 2) d.action.edit(x) = a + n;
+        if (g >= 0 && rng() % 2) d.gotoTable.edit(x) = g + n;
+    }
+    return d;
+}
+
+// 不含状态编号的分析结果：是否接受、步数、每处错误的位置和期望的终结符、语法树
+string stateFreeOutput(const runtimeTable& t, const string& sentence, parseWorkspace& ws)
+{
+    int steps = 0;
+    vector<parseDiagnostic> diagnostics;
+    treeArena arena;
+    treeNode* root = nullptr;
+    bool ok = parseSentenceImpl<true>(t, sentence, steps, nullptr, &diagnostics, &arena, &root, ws);
+    string out = (ok ? "接受 " : "出错 ") + to_string(steps) + "\n";
+    for (const auto& d : diagnostics) out += to_string(d.pos) + " " + d.got + " " + expectedString(t, d.state) + "\n";
+    if (ok) out += treeToString(root, 1 << 20) + "\n";
+    return out;
+}
+
+// 生成的句子和改坏的句子在两张表上的分析结果不同的个数
+int countDifferences(const grammarContext& ctx, const runtimeTable& a, const runtimeTable& b)
+{
+    sentenceGenerator generator(ctx, 5);
+    mt19937 rng(9);
+    parseWorkspace ws;
+    int differ = 0;
+    for (int i = 0; i < 200; ++i)
+    {
+        string s;
+        generator.generate(s, 1 + i % 40, max(generator.minDepth(), 64));
+        for (int broken = 0; broken < 2; ++broken)
+        {
+            if (stateFreeOutput(a, s, ws) != stateFreeOutput(b, s, ws)) ++differ;
+            if (s.empty()) break;
+            s.erase(rng() % s.length(), 1);
+        }
+    }
+    return differ;
+}
+
+// 有等价状态的表合并回原来的状态数，单产生式归约绕过后走不到的状态被去掉，分析结果都不变
+void testMinimizeStates()
+{
+    mt19937 rng(13);
+    for (const string& grammar : { exprRules, nonLALRGrammar, lvalueGrammar,
+        string("%left +\n%left *\nE->E+E\nE->E*E\nE->(E)\nE->a"), string("%error e\nS->SLx\nS->Lx\nL->a\nL->e") })
+    {
+        grammarContext ctx;
+        runtimeTable t = compileText(grammar, ctx);
+        runtimeTable minimal = t;
+        check(minimizeStates(minimal) == 0 && minimal.stateCount == t.stateCount, grammar + "：LR(0)核心不同的状态不应合并");
+
+        runtimeTable doubled = withDuplicates(t, rng);
+        runtimeTable merged = doubled;
+        int removed = minimizeStates(merged);
+        check(removed == t.stateCount && merged.stateCount == t.stateCount,
+            grammar + "：复制的状态应全部合并，实际减少" + to_string(removed) + "个");
+        check(countDifferences(ctx, t, doubled) == 0, grammar + "：复制状态后分析结果应不变");
+        check(countDifferences(ctx, t, merged) == 0, grammar + "：合并状态后分析结果应不变");
+
+        runtimeTable bypassed = t;
+        eliminateUnitReductions(ctx, bypassed);
+        runtimeTable compact = bypassed;
+        removed = minimizeStates(compact);
+        check(removed == bypassed.unitEliminated, grammar + "：绕过的单产生式归约状态应被去掉");
+        check(countDifferences(ctx, bypassed, compact) == 0, grammar + "：去掉走不到的状态后分析结果应不变");
+    }
+}
+
+/******************** 优先级与结合性 ***************************/
+// %left等声明解决移进-归约冲突，从语法树的形状检查结合方向；产生式后面只能跟%prec x
+
+// 分析并建树，不接受时返回空串
+string parseToTree(const runtimeTable& t, const string& sentence)
+{
+    treeArena arena;
+    treeNode* root = nullptr;
+    int steps = 0;
+    if (!parseSentence(t, sentence, steps, nullptr, nullptr, &arena, &root)) return "";
+    return treeToString(root, 1000);
+}
+
+void testPrecedence()
+{
+    grammarContext ctx;
+    runtimeTable t = compileText("%left +\n%left *\n%right ^\n%nonassoc <\n%left u\n"
+        "E->E+E\nE->E*E\nE->E^E\nE->E<E\nE->-E %prec u\nE->a", ctx);
+    check(ctx.precResolvedCount > 0, "冲突没有按优先级解决");
+    check(parseToTree(t, "a+a*a") == "E(E(a) + E(E(a) * E(a)))", "*应该比+优先：" + parseToTree(t, "a+a*a"));
+    check(parseToTree(t, "a+a+a") == "E(E(E(a) + E(a)) + E(a))", "+应该左结合：" + parseToTree(t, "a+a+a"));
+    check(parseToTree(t, "a^a^a") == "E(E(a) ^ E(E(a) ^ E(a)))", "^应该右结合：" + parseToTree(t, "a^a^a"));
+    check(parseToTree(t, "-a+a") == "E(E(- E(a)) + E(a))", "%prec u应该比+优先：" + parseToTree(t, "-a+a"));
+    int steps = 0;
+    check(parseSentence(t, "a<a", steps, nullptr) && !parseSentence(t, "a<a<a", steps, nullptr), "<不结合，a<a<a应该出错");
+
+    // 右部后面多出来的内容要报错，不能悄悄丢掉
+    for (const char* rule : { "E->E+T %prc +", "E->a b", "E->a %prec", "E->a %prec + x", "E->a %prec ++", "E->a %prec X" })
+    {
+        grammarContext bad;
+        string error;
+        check(!prepareGrammar(bad, string("%left +\n") + rule + "\nE->a\nT->a", error) && error.find("%prec") != string::npos,
+            string(rule) + "应该报错");
+    }
+    string error;
+    grammarContext ok;
+    check(prepareGrammar(ok, "%left +\nE->E+E %prec +\t\r\nE->a", error) && ok.grammarDeque.back().prec == 0
+        && ok.grammarDeque[ok.grammarDeque.size() - 2].prec == '+', "%prec后面的空白不应该报错：" + error);
+}
+
+/******************** 语法树 ***************************/
+// 分析时在内存池中建语法树，孩子按产生式右部长度连续存放；不建树时结果和步数不变
+
+// 每个内部结点的孩子数等于产生式右部长度，返回结点数
+int checkTreeShape(const runtimeTable& t, const treeNode* root, bool& ok)
+{
+    int count = 0;
+    vector<const treeNode*> st(1, root);
+    while (!st.empty())
+    {
+        const treeNode* n = st.back();
+        st.pop_back();
+        ++count;
+        if (n->gid < 0) continue;
+        ok = ok && n->childCount == t.prodLen[n->gid] && n->symbol == t.prodLeft[n->gid];
+        for (int i = 0; i < n->childCount; ++i) st.push_back(n->children[i]);
+    }
+    return count;
+}
+
+void testParseTree()
+{
+    grammarContext ctx;
+    runtimeTable t = compileText(exprRules, ctx);
+    check(parseToTree(t, "a+a*a") == "E(E(T(F(a))) + T(T(F(a)) * F(a)))", "语法树不对：" + parseToTree(t, "a+a*a"));
+    check(parseToTree(t, "a+*a").empty(), "不接受的句子不应该有语法树");
+    grammarContext emptyCtx;
+    runtimeTable withEmpty = compileText("S->AB\nA->a\nA->@\nB->b", emptyCtx);
+    check(parseToTree(withEmpty, "b") == "S(A() B(b))", "空串产生式应该是没有孩子的结点：" + parseToTree(withEmpty, "b"));
+
+    // 深的树：结果、步数和不建树时相同，括号形式按长度截断
+    string deep = string(100000, '(') + "a" + string(100000, ')');
+    treeArena arena;
+    treeNode* root = nullptr;
+    int a = 0, b = 0;
+    check(parseSentence(t, deep, a, nullptr, nullptr, &arena, &root) && parseSentence(t, deep, b, nullptr) && a == b,
+        "建树时分析结果或步数不同");
+    bool ok = true;
+    int nodes = checkTreeShape(t, root, ok);
+    check(ok && nodes == 100000 * 5 + 4, "深的语法树结构不对，结点数" + to_string(nodes));
+    string text = treeToString(root, 100);
+    check(text.length() < 120 && text.compare(text.length() - 3, 3, "...") == 0, "语法树太长时应该截断");
+    check(arena.totalBytes >= nodes * sizeof(treeNode) && arena.blocks.size() > 1, "内存池的统计不对");
+
+    // 清空后保留第一块，短句子不再申请
+    arena.clear();
+    check(parseSentence(t, "(a+a)*a", a, nullptr, nullptr, &arena, &root) && arena.blocks.size() == 1,
+        "清空后的内存池应该复用第一块");
+    ok = true;
+    checkTreeShape(t, root, ok);
+    check(ok, "复用内存池后语法树结构不对");
+}
+
+/******************** 分析过程记录 ***************************/
+// 每步只记栈顶结点和新增的结点，显示时再还原出栈和动作
+
+// 用vector直接模拟，逐步记下完整的状态栈、符号栈、剩余输入和动作，作为基准
+struct referenceStep
+{
+    string states, symbols, rest, action;
+};
+
+vector<referenceStep> simulateSteps(const runtimeTable& t, const string& sentence, const vector<string>& rules)
+{
+    vector<referenceStep> out;
+    vector<int> stack(1, 0);
+    string symbols = "$", input = sentence + "$";
+    size_t pos = 0;
+    while (true)
+    {
+        referenceStep r;
+        for (int s : stack) r.states += to_string(s) + " ";
+        r.symbols = symbols;
+        r.rest = input.substr(pos);
+        int a = t.action[stack.back() * 128 + (unsigned char)input[pos]];
+        bool done = a == 0 || a == acceptAction;
+        if (a == 0) r.action = "出错";
+        else if (a == acceptAction) r.action = "接受";
+        else if (a > 0)
+        {
+            r.action = "移进 s" + to_string(a - 1);
+            stack.push_back(a - 1);
+            symbols += input[pos++];
+        }
+        else
+        {
+            int gid = -a - 1;
+            r.action = "归约 " + rules[gid];
+            stack.resize(stack.size() - t.prodLen[gid]);
+            symbols.resize(symbols.size() - t.prodLen[gid]);
+            stack.push_back(t.gotoTable[stack.back() * 128 + t.prodLeft[gid]]);
+            symbols += t.prodLeft[gid];
+        }
+        out.push_back(r);
+        if (done) return out;
+    }
+}
+
+void testTrace()
+{
+    grammarContext ctx;
+    runtimeTable t = compileText(exprRules, ctx);
+    traceLog trace;
+    for (const auto& g : ctx.grammarDeque) trace.rules.push_back(string(1, g.left) + "->" + g.right);
+    for (const string& sentence : { string("a+a*(a+a)"), string("a+*a"), string("((a))") })
+    {
+        int steps = 0;
+        parseSentence(t, sentence, steps, &trace);
+        vector<referenceStep> expected = simulateSteps(t, sentence, trace.rules);
+        bool same = (int)trace.steps.size() == steps && trace.steps.size() == expected.size();
+        for (size_t i = 0; i < expected.size() && same; ++i)
+        {
+            same = trace.stackText(i, true) == expected[i].states && trace.stackText(i, false) == expected[i].symbols
+                && trace.inputText(i) == expected[i].rest && trace.actionText(i) == expected[i].action;
+        }
+        check(same, sentence + "的分析过程和逐步模拟的不同");
+    }
+
+    // 长的分析过程：每步的记录定长，深的栈和长的输入显示时截断
+    string sentence = string(2000, '(') + "a" + string(2000, ')');
+    for (int i = 0; i < 100000; ++i) sentence += "+a";
+    int steps = 0;
+    check(parseSentence(t, sentence, steps, &trace) && (int)trace.steps.size() == steps, "长句子的分析过程不完整");
+    check(trace.bytes() < (size_t)steps * 64, "每步记录占用" + to_string(trace.bytes() / steps) + "字节，太多");
+    size_t deepest = 0;
+    for (size_t i = 0; i < trace.steps.size(); ++i)
+    {
+        if (trace.steps[i].pos == 2001) deepest = i;
+    }
+    string states = trace.stackText(deepest, true);
+    check(states.compare(0, 4, "... ") == 0 && count(states.begin(), states.end(), ' ') == traceLog::showLimit + 1,
+        "深的栈应该只显示栈顶" + to_string(traceLog::showLimit) + "个");
+    string rest = trace.inputText(0);
+    check(rest.length() == traceLog::showLimit + 4 && rest.compare(rest.length() - 4, 4, " ...") == 0, "长的输入应该截断");
+}
+
+/******************** yacc文法导入 ***************************/
+// 导入后的文法按优先级解决冲突；超出单字符符号的个数时报告而不是错误地映射
+
+void testYaccImport()
+{
+    istringstream in("%token NUM\n%left '+' '-'\n%left '*'\n%%\n"
+        "expr : expr '+' expr | expr '-' expr | expr '*' expr | '(' expr ')' | NUM ;\n");
+    string text, error;
+    check(importYaccGrammar(in, text, error), error);
+    check(text.find("# n = NUM") != string::npos && text.find("E->E*E") != string::npos, "导入的文法不对：" + text);
+    grammarContext ctx;
+    runtimeTable t = compileText(text, ctx);
+    int steps = 0;
+    check(parseSentence(t, "n+n*(n-n)", steps, nullptr) && !parseSentence(t, "n+*n", steps, nullptr),
+        "导入的文法分析句子出错");
+
+    // 27个非终结符超出A-Z
+    string big = "%%\n";
+    for (int i = 0; i < 27; ++i) big += "n" + to_string(i) + " : 'x' ;\n";
+    istringstream bigIn(big);
+    check(!importYaccGrammar(bigIn, text, error) && error.find("27") != string::npos, "非终结符太多时应该报告个数");
+}
+
+/******************** 错误恢复 ***************************/
+// 一遍报告全部错误的位置；不是终结符的字符（包括句中的$）一定报错，不能当成结束符
+
+void testErrorRecovery()
+{
+    grammarContext ctx;
+    runtimeTable t = compileText(exprRules, ctx);
+    struct
+    {
+        const char* sentence;
+        vector<int> positions; // 期望报告的位置（去掉空白后）
+    } cases[] = {
+        { "(a+a)*a", {} },
+        { "a+*a+(a", { 2, 7 } },
+        { "a++a*a)", { 2, 6 } },
+        { "a$)))", { 1 } },
+        { "a b", { 1 } },
+    };
+    for (const auto& c : cases)
+    {
+        int steps = 0;
+        traceLog trace;
+        vector<parseDiagnostic> diagnostics;
+        bool ok = parseSentence(t, c.sentence, steps, &trace, &diagnostics);
+        vector<int> positions;
+        for (const auto& d : diagnostics) positions.push_back(d.pos);
+        check(ok == c.positions.empty() && positions == c.positions, string("错误恢复报告的位置不对：") + c.sentence);
+        check(parseSentence(t, c.sentence, steps, nullptr) == ok, string("不报告错误时结果不同：") + c.sentence);
+        check(parseSentence(t, c.sentence, steps, &trace) == ok, string("只记录分析过程时结果不同：") + c.sentence);
+    }
+}
+
+/******************** 增量分析 ***************************/
+// 随机修改句子后增量分析，结果和步数要和从头分析一样
+
+void testIncremental()
+{
+    grammarContext ctx;
+    runtimeTable t = compileText(exprRules, ctx);
+    sentenceGenerator generator(ctx, 7);
+    mt19937 rng(7);
+    const string pieces[] = { "a", "+a", "*a", "(a)", "(", ")", "+", "$", " " };
+    incrementalParser session;
+    session.interval = 4; // 检查点密一些，多走同步的路径
+    string sentence;
+    generator.generate(sentence, 200, max(generator.minDepth(), 32));
+    session.parse(t, sentence);
+    int differ = 0, synced = 0;
+    auto compare = [&](const string& text)
+    {
+        session.update(text);
+        int steps = 0;
+        bool ok = parseSentence(t, text, steps, nullptr);
+        // 出错的句子只比较结果，步数取决于在哪里停下
+        if (session.accepted != ok || (ok && session.steps != steps)) ++differ;
+        if (session.syncPos >= 0) ++synced;
+        return ok;
+    };
+    for (int round = 0; round < 500; ++round)
+    {
+        size_t at = rng() % (sentence.length() + 1);
+        string edited = sentence;
+        if (round % 2 == 0 && at < sentence.length()) edited.erase(at, 1 + rng() % 3);
+        else edited.insert(at, pieces[rng() % (sizeof(pieces) / sizeof(pieces[0]))]);
+        // 改坏了就改回去，改回去的那次也要比较
+        if (compare(edited)) sentence = edited;
+        else compare(sentence);
+    }
+    check(differ == 0, "增量分析有" + to_string(differ) + "次和从头分析不同");
+    check(synced > 0, "增量分析一次也没有同步");
+    // 句中的$不能当成结束符
+    session.parse(t, "a$a");
+    check(!session.accepted, "增量分析接受了句中的$");
+}
+
+/******************** GLR分析 ***************************/
+// 有歧义的文法：分析森林里的分析数要对，句中的$要报错
+
+void testGLR()
+{
+    grammarContext ctx;
+    string error;
+    check(prepareGrammar(ctx, "E->E+E\nE->E*E\nE->(E)\nE->a", error), error);
+    getLR0(ctx);
+    glrTable table;
+    check(buildGLRTable(ctx, table) > 0, "有歧义的文法应该有冲突格子");
+    glrParser parser;
+    struct
+    {
+        const char* sentence;
+        double trees; // 0表示不接受
+        int errorPos;
+    } cases[] = {
+        { "a", 1, -1 },
+        { "a+a*a", 2, -1 },
+        { "a+a+a+a", 5, -1 },
+        { "(a+a)*(a+a)", 1, -1 },
+        { "a+", 0, 2 },
+        { "a$)))", 0, 1 },
+        { "a+b", 0, 2 },
+    };
+    for (const auto& c : cases)
+    {
+        glrResult r;
+        bool ok = parser.parse(table, c.sentence, r);
+        int ambiguous = 0;
+        double trees = ok ? countTrees(r.root, ambiguous) : 0;
+        check(trees == c.trees && (ok || r.errorPos == c.errorPos), string("GLR分析结果不对：") + c.sentence);
+    }
+}
+
+/******************** 流式分析 ***************************/
+// 分段送入（C++20编译时经过协程）和整句分析的结果、步数要一样
+
+void testStreamAgainstBatch()
+{
+    const string grammar = "E->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->a";
+    grammarContext ctx;
+    runtimeTable t;
+    string error;
+    check(compileGrammar(ctx, grammar, t, error), error);
+    sentenceGenerator generator(ctx, 5);
+    vector<string> sentences;
+    for (int i = 0; i < 300; ++i)
+    {
+        string s;
+        generator.generate(s, 1 + i % 60, max(generator.minDepth(), 32));
+        // 一部分句子改坏，出错的位置也要一致
+        if (i % 3 == 0 && !s.empty()) s[s.length() / 2] = '+';
+        sentences.push_back(s);
+    }
+    vector<char> expected, got;
+    batchResult a = parseBatch(t, sentences, 1, false, &expected);
+    for (size_t chunk : { (size_t)1, (size_t)7, (size_t)4096 })
+    {
+        batchResult b = streamBatch(t, sentences, chunk, 16, &got);
+        check(got == expected && a.steps == b.steps,
+            "每次送入" + to_string(chunk) + "字节时流式分析的结果和整句分析不同");
+    }
+    // 句中的$不能当成结束符；有不是终结符的字符时整句分析不走到底，只比较结果
+    vector<string> invalid = { "a$a", "a$)))", "a+a$", "a+a" };
+    parseBatch(t, invalid, 1, false, &expected);
+    streamBatch(t, invalid, 2, 16, &got);
+    check(got == expected && expected == vector<char>({ 0, 0, 0, 1 }), "流式分析把句中的$当成了结束符");
+    // 嵌套超过上限要和语法错误分开报告
+    vector<string> nested = { "((((((((((a))))))))))", "a+a", "((a)" };
+    vector<char> outcomes = { outcomeTooDeep, outcomeAccepted, outcomeRejected };
+    parseBatch(t, nested, 1, false, &expected, nullptr, 8);
+    check(expected == outcomes, "整句分析没有报告嵌套超过上限");
+    parseBatch(t, nested, 1, true, &expected, nullptr, 8);
+    check(expected == outcomes, "建树时没有报告嵌套超过上限");
+    streamBatch(t, nested, 3, 16, &got, 8);
+    check(got == outcomes, "流式分析没有报告嵌套超过上限");
+#ifdef SLR_COROUTINE
+    cout << "流式分析经过协程包装" << endl;
+#endif
+}
+
+/******************** 后台服务 ***************************/
+// 散列相同、原文不同的文法不能共用缓存里的分析表
+
+void testServerCache()
+{
+#ifndef _WIN32
+    const string grammar = "A->(A)\nA->a";
+    uint64_t hash = tableChecksum((const unsigned char*)grammar.data(), grammar.length());
+    // 伪造一个散列冲突：另一个文法占着这个键
+    shared_ptr<compiledGrammar> other = make_shared<compiledGrammar>();
+    other->text = "S->b";
+    grammarContext ctx;
+    string error;
+    check(compileGrammar(ctx, other->text, other->table, error), error);
+    parseServer server;
+    server.cache[hash] = other;
+    server.cacheOrder.push_back(hash);
+
+    string reply;
+    check(server.generate(grammar, reply, error) && reply.length() >= 8, error);
+    uint64_t key = getU64(reply.data());
+    check(key != hash, "散列冲突时不应该复用别的文法");
+    parseWorkspace ws;
+    string body;
+    putU64(body, key);
+    body += "((a))";
+    string result;
+    check(server.parse(body, ws, result, error) && result.length() == 9 && result[4] == 1, "冲突后生成的文法分析出错");
+    // 再生成一次命中同一个键
+    reply.clear();
+    check(server.generate(grammar, reply, error) && getU64(reply.data()) == key && server.cacheHits == 1,
+        "同一文法应该命中缓存");
+#endif
+}
+
+/******************** 编译期分析表 ***************************/
+// slr1table.h在编译期生成的表和widget.cpp运行时生成的表，分析结果、步数要一样
+
+static constexpr char exprGrammar[] = "E->E+T\nE->T\nT->T*F\nT->F\nF->(E)\nF->a\n";
+static constexpr char nestGrammar[] = "A->(A)\nA->a\n";
+static constexpr char emptyGrammar[] = "S->AB\nA->a\nA->@\nB->bB\nB->b\n";
+// 开始符号只有一条产生式但出现在右部，两边都要增广，否则“(a”会被接受
+static constexpr char recursiveStartGrammar[] = "S->A\nA->(S)\nA->a\n";
+
+constexpr auto exprTable = slr1::makeTable<exprGrammar>();
+constexpr auto nestTable = slr1::makeTable<nestGrammar>();
+constexpr auto emptyTable = slr1::makeTable<emptyGrammar>();
+constexpr auto recursiveStartTable = slr1::makeTable<recursiveStartGrammar>();
+
+static_assert(slr1::parse(exprTable, "a+a*(a+a)"), "");
+static_assert(!slr1::parse(exprTable, "a+*a"), "");
+static_assert(slr1::parse(nestTable, "((a))") && !slr1::parse(nestTable, "((a)"), "");
+static_assert(slr1::parse(emptyTable, "bbb") && slr1::parse(emptyTable, "ab"), "");
+static_assert(slr1::parse(recursiveStartTable, "((a))") && !slr1::parse(recursiveStartTable, "(a"), "");
+
+template <class Table>
+void compareWithCompileTime(const string& name, const char* grammar, const Table& fixed)
+{
+    grammarContext ctx;
+    runtimeTable t;
+    string error;
+    if (!compileGrammar(ctx, grammar, t, error))
+    {
+        check(false, name + "编译失败：" + error);
+        return;
+    }
+    check(t.stateCount == Table::stateCount, name + "状态数不同：" + to_string(t.stateCount) + "和" + to_string(Table::stateCount));
+    check(t.startSymbol == fixed.startSymbol, name + "增广不同");
+    sentenceGenerator generator(ctx, 2);
+    mt19937 rng(9);
+    int differ = 0;
+    for (int i = 0; i < 300; ++i)
+    {
+        string s;
+        generator.generate(s, 1 + i % 40, max(generator.minDepth(), 32));
+        // 一半句子改坏一个字符（只用句子里的字符，都是终结符）
+        if (i % 2 == 1 && s.length() > 1) s[rng() % s.length()] = s[rng() % s.length()];
+        if (i % 7 == 3 && !s.empty()) s.pop_back();
+        int a = 0, b = 0;
+        bool x = parseSentence(t, s, a, nullptr), y = slr1::parse(fixed, s.c_str(), &b);
+        if (x != y || a != b) ++differ;
+    }
+    check(differ == 0, name + "有" + to_string(differ) + "句和编译期分析表的结果不同");
+}
+
+// 编译期和运行时的归约都由slr1::fillReduce填，随机文法上两边是否有冲突、冲突种类要一样
+typedef slr1::table<slr1::maxStates, 128, 26, slr1::maxProductions> largestTable;
+
+void compareConflicts()
+{
+    mt19937 rng(2024);
+    int differ = 0;
+    for (int i = 0; i < 400; ++i)
+    {
+        string grammar = randomGrammar(rng);
+        grammarContext ctx;
+        string error;
+        if (!prepareGrammar(ctx, grammar, error)) continue;
+        // 运行时去掉了无用的产生式、重复的产生式只算一条，编译期分析表用同样的文法（不含增广的产生式）
+        string kept, rest;
+        set<string> seen;
+        for (const grammarUnit& g : ctx.grammarDeque)
+        {
+            string line = string(1, g.left) + "->" + g.right + "\n";
+            if (g.left == '^' || !seen.insert(line).second) continue;
+            // 第一行的左部为开始符号
+            if (g.left == ctx.startSymbol) kept += line;
+            else rest += line;
+        }
+        kept += rest;
+        unique_ptr<slr1::analysis> a(new slr1::analysis(slr1::analyse(kept.c_str())));
+        if (a->error != slr1::errorNone) continue;
+        getLR0(ctx);
+        int kinds = getSLR1Table(ctx);
+        *a = slr1::checkTable<largestTable>(*a);
+        // 编译期只记第一个冲突，它的种类要在运行时的冲突种类中
+        bool same = a->error == slr1::errorNone ? kinds == 0
+            : a->error == slr1::errorShiftReduce ? (kinds & slr1::conflictShiftReduce) != 0
+            : a->error == slr1::errorReduceReduce && (kinds & slr1::conflictReduceReduce) != 0;
+        if (!same)
+        {
+            ++differ;
+            cout << grammar;
+        }
+    }
+    check(differ == 0, "有" + to_string(differ) + "个随机文法编译期和运行时的冲突判定不同");
+}
+
+void testCompileTimeTable()
+{
+    compareConflicts();
+    compareWithCompileTime("表达式", exprGrammar, exprTable);
+    compareWithCompileTime("括号嵌套", nestGrammar, nestTable);
+    compareWithCompileTime("空串", emptyGrammar, emptyTable);
+    compareWithCompileTime("开始符号递归", recursiveStartGrammar, recursiveStartTable);
+    int steps = 0;
+    grammarContext ctx;
+    runtimeTable t;
+    string error;
+    check(compileGrammar(ctx, recursiveStartGrammar, t, error) && !parseSentence(t, "(a", steps, nullptr),
+        "开始符号出现在右部时没有增广");
+}
+
+int main()
+{
+    testSegmentedStack();
+    testParseAgainstVector();
+    testScanInput();
+    testLexer();
+    testGenerator();
+    testAgainstDerivation();
+    testPruneGrammar();
+    testLALR();
+    testMinimalLR1();
+    testGrammarContext();
+    testDfaGraphLayout();
+    testMinimizeStates();
+    testPrecedence();
+    testParseTree();
+    testTrace();
+    testYaccImport();
+    testErrorRecovery();
+    testIncremental();
+    testGLR();
+    testParseBatch();
+    testAllocations();
+    testTableFile();
+    testLazySnapshot();
+    testStreamAgainstBatch();
+    testServerCache();
+    testCompileTimeTable();
+    if (failures == 0) cout << "全部通过" << endl;
+    return failures == 0 ? 0 : 1;
+}
@@ -0,0 +1,23 @@
+QT       += core gui
+
+greaterThan(QT_MAJOR_VERSION, 4): QT += widgets
+
+# 自检程序，make check 运行；slr1table.h的编译期分析表需要C++17
+CONFIG += c++17 console testcase
+CONFIG -= app_bundle
+
+# qmake CONFIG+=c++2a 时一并测试协程包装，同compiler_lab_4.pro
+c++2a {
+    CONFIG -= c++17
+    *-g++*: QMAKE_CXXFLAGS += -fcoroutines
+}
+
+# qmake DEFINES+=SLR_COUNT_ALLOCATIONS 时一并测试内存分配统计
+INCLUDEPATH += ..
+
+SOURCES += \
+    tests.cpp
+
+# widget.cpp被tests.cpp直接包含，Widget类仍需要moc
+HEADERS += \
+    ../widget.h
@@ -11,12 +11,14 @@
 
 #include <QtCore/QVariant>
 #include <QtWidgets/QApplication>
+#include <QtWidgets/QCheckBox>
 #include <QtWidgets/QHBoxLayout>
 #include <QtWidgets/QHeaderView>
 #include <QtWidgets/QLabel>
 #include <QtWidgets/QPlainTextEdit>
 #include <QtWidgets/QPushButton>
 #include <QtWidgets/QSpacerItem>
+#include <QtWidgets/QTableView>
 #include <QtWidgets/QTableWidget>
 #include <QtWidgets/QWidget>
 
@@ -73,6 +75,7 @@ public:
     QSpacerItem *horizontalSpacer_11;
     QLabel *label_6;
     QPushButton *pushButton;
+    QPushButton *pushButton_9;
     QSpacerItem *horizontalSpacer_12;
     QTableWidget *tableWidget;
     QWidget *widget_18;
@@ -102,15 +105,38 @@ public:
     QSpacerItem *horizontalSpacer_19;
     QLabel *label_9;
     QSpacerItem *horizontalSpacer_20;
+    QWidget *widget_19;
+    QWidget *widget_21;
+    QHBoxLayout *horizontalLayout_13;
+    QSpacerItem *horizontalSpacer_26;
+    QLabel *label_10;
+    QSpacerItem *horizontalSpacer_27;
+    QPlainTextEdit *plainTextEdit_3;
+    QWidget *widget_22;
+    QWidget *widget_23;
+    QWidget *widget_24;
+    QHBoxLayout *horizontalLayout_14;
+    QSpacerItem *horizontalSpacer_28;
+    QLabel *label_12;
+    QSpacerItem *horizontalSpacer_29;
+    QPlainTextEdit *plainTextEdit_5;
+    QWidget *widget_25;
+    QHBoxLayout *horizontalLayout_15;
+    QSpacerItem *horizontalSpacer_30;
+    QLabel *label_13;
+    QPushButton *pushButton_8;
+    QCheckBox *checkBox;
+    QSpacerItem *horizontalSpacer_31;
+    QTableView *tableView;
 
     void setupUi(QWidget *Widget)
     {
         if (Widget->objectName().isEmpty())
             Widget->setObjectName(QString::fromUtf8("Widget"));
-        Widget->resize(1340, 761);
+        Widget->resize(1340, 1111);
         widget = new QWidget(Widget);
         widget->setObjectName(QString::fromUtf8("widget"));
-        widget->setGeometry(QRect(20, 10, 1301, 741));
+        widget->setGeometry(QRect(20, 10, 1301, 1091));
         widget_2 = new QWidget(widget);
         widget_2->setObjectName(QString::fromUtf8("widget_2"));
         widget_2->setGeometry(QRect(0, 0, 1301, 51));
@@ -295,6 +321,11 @@ public:
 
         horizontalLayout_6->addWidget(pushButton);
 
+        pushButton_9 = new QPushButton(widget_13);
+        pushButton_9->setObjectName(QString::fromUtf8("pushButton_9"));
+
+        horizontalLayout_6->addWidget(pushButton_9);
+
         horizontalSpacer_12 = new QSpacerItem(437, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
 
         horizontalLayout_6->addItem(horizontalSpacer_12);
@@ -398,6 +429,90 @@ public:
 
         horizontalLayout_9->addItem(horizontalSpacer_20);
 
+        widget_19 = new QWidget(widget);
+        widget_19->setObjectName(QString::fromUtf8("widget_19"));
+        widget_19->setGeometry(QRect(-1, 739, 251, 351));
+        widget_21 = new QWidget(widget_19);
+        widget_21->setObjectName(QString::fromUtf8("widget_21"));
+        widget_21->setGeometry(QRect(-1, -1, 251, 41));
+        horizontalLayout_13 = new QHBoxLayout(widget_21);
+        horizontalLayout_13->setObjectName(QString::fromUtf8("horizontalLayout_13"));
+        horizontalSpacer_26 = new QSpacerItem(25, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+        horizontalLayout_13->addItem(horizontalSpacer_26);
+
+        label_10 = new QLabel(widget_21);
+        label_10->setObjectName(QString::fromUtf8("label_10"));
+
+        horizontalLayout_13->addWidget(label_10);
+
+        horizontalSpacer_27 = new QSpacerItem(25, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+        horizontalLayout_13->addItem(horizontalSpacer_27);
+
+        plainTextEdit_3 = new QPlainTextEdit(widget_19);
+        plainTextEdit_3->setObjectName(QString::fromUtf8("plainTextEdit_3"));
+        plainTextEdit_3->setGeometry(QRect(10, 40, 231, 301));
+        widget_22 = new QWidget(widget);
+        widget_22->setObjectName(QString::fromUtf8("widget_22"));
+        widget_22->setGeometry(QRect(249, 739, 1051, 351));
+        widget_23 = new QWidget(widget_22);
+        widget_23->setObjectName(QString::fromUtf8("widget_23"));
+        widget_23->setGeometry(QRect(-1, -1, 211, 351));
+        widget_24 = new QWidget(widget_23);
+        widget_24->setObjectName(QString::fromUtf8("widget_24"));
+        widget_24->setGeometry(QRect(0, 40, 211, 41));
+        horizontalLayout_14 = new QHBoxLayout(widget_24);
+        horizontalLayout_14->setObjectName(QString::fromUtf8("horizontalLayout_14"));
+        horizontalSpacer_28 = new QSpacerItem(46, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+        horizontalLayout_14->addItem(horizontalSpacer_28);
+
+        label_12 = new QLabel(widget_24);
+        label_12->setObjectName(QString::fromUtf8("label_12"));
+
+        horizontalLayout_14->addWidget(label_12);
+
+        horizontalSpacer_29 = new QSpacerItem(45, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+        horizontalLayout_14->addItem(horizontalSpacer_29);
+
+        plainTextEdit_5 = new QPlainTextEdit(widget_23);
+        plainTextEdit_5->setObjectName(QString::fromUtf8("plainTextEdit_5"));
+        plainTextEdit_5->setGeometry(QRect(10, 70, 191, 271));
+        widget_25 = new QWidget(widget_22);
+        widget_25->setObjectName(QString::fromUtf8("widget_25"));
+        widget_25->setGeometry(QRect(-1, -1, 1051, 41));
+        horizontalLayout_15 = new QHBoxLayout(widget_25);
+        horizontalLayout_15->setObjectName(QString::fromUtf8("horizontalLayout_15"));
+        horizontalLayout_15->setContentsMargins(-1, 0, -1, 0);
+        horizontalSpacer_30 = new QSpacerItem(360, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+        horizontalLayout_15->addItem(horizontalSpacer_30);
+
+        label_13 = new QLabel(widget_25);
+        label_13->setObjectName(QString::fromUtf8("label_13"));
+
+        horizontalLayout_15->addWidget(label_13);
+
+        pushButton_8 = new QPushButton(widget_25);
+        pushButton_8->setObjectName(QString::fromUtf8("pushButton_8"));
+
+        horizontalLayout_15->addWidget(pushButton_8);
+
+        checkBox = new QCheckBox(widget_25);
+        checkBox->setObjectName(QString::fromUtf8("checkBox"));
+
+        horizontalLayout_15->addWidget(checkBox);
+
+        horizontalSpacer_31 = new QSpacerItem(360, 20, QSizePolicy::Expanding, QSizePolicy::Minimum);
+
+        horizontalLayout_15->addItem(horizontalSpacer_31);
+
+        tableView = new QTableView(widget_22);
+        tableView->setObjectName(QString::fromUtf8("tableView"));
+        tableView->setGeometry(QRect(220, 40, 821, 301));
+
 
         retranslateUi(Widget);
 
@@ -419,11 +534,17 @@ public:
         pushButton_6->setText(QApplication::translate("Widget", "\346\261\202\350\247\243", nullptr));
         label_6->setText(QApplication::translate("Widget", "LR(0)DFA\345\233\276", nullptr));
         pushButton->setText(QApplication::translate("Widget", "\345\274\200\345\247\213\347\224\237\346\210\220", nullptr));
+        pushButton_9->setText(QApplication::translate("Widget", "\345\233\276\345\275\242\346\230\276\347\244\272", nullptr));
         label_11->setText(QApplication::translate("Widget", "\347\224\237\346\210\220\346\217\220\347\244\272", nullptr));
         label_8->setText(QApplication::translate("Widget", "\345\210\206\346\236\220\347\273\223\346\236\234", nullptr));
         label_7->setText(QApplication::translate("Widget", "SLR(1)\346\226\207\346\263\225\345\210\206\346\236\220", nullptr));
         pushButton_2->setText(QApplication::translate("Widget", "\345\274\200\345\247\213\345\210\206\346\236\220", nullptr));
         label_9->setText(QApplication::translate("Widget", "SLR(1)\345\210\206\346\236\220\350\241\250\357\274\210\344\273\205\345\275\223\345\210\206\346\236\220\346\210\220\345\212\237\345\261\225\347\244\272\357\274\211", nullptr));
+        label_10->setText(QApplication::translate("Widget", "\345\217\245\345\255\220\350\276\223\345\205\245\357\274\210\346\257\217\350\241\214\344\270\200\345\217\245\357\274\211", nullptr));
+        label_12->setText(QApplication::translate("Widget", "\345\210\206\346\236\220\347\273\223\346\236\234", nullptr));
+        label_13->setText(QApplication::translate("Widget", "\345\217\245\345\255\220\345\210\206\346\236\220\350\277\207\347\250\213", nullptr));
+        pushButton_8->setText(QApplication::translate("Widget", "\345\274\200\345\247\213\345\210\206\346\236\220", nullptr));
+        checkBox->setText(QApplication::translate("Widget", "\346\266\210\351\231\244\345\215\225\344\272\247\347\224\237\345\274\217\345\275\222\347\272\246", nullptr));
     } // retranslateUi
 
 };
@@ -1,5 +1,6 @@
 ﻿#include "widget.h"
 #include "ui_widget.h"
+#include "slr1table.h"
 #include <QString>
 #include <QFile>
 #include <QTextStream>
@@ -7,6 +8,14 @@
 #include <QFileDialog>
 #include <QTextCodec>
 #include <QMessageBox>
+#include <QAbstractTableModel>
+#include <QGraphicsView>
+#include <QGraphicsScene>
+#include <QGraphicsItem>
+#include <QStyleOptionGraphicsItem>
+#include <QPainter>
+#include <QTimer>
+#include <QWheelEvent>
 #include <iostream>
 #include <map>
 #include <vector>
@@ -19,6 +28,40 @@
 #include <string>
 #include <sstream>
 #include <fstream>
+#include <memory>
+#include <chrono>
+#include <bitset>
+#include <thread>
+#include <atomic>
+#include <cstring>
+#include <cstdlib>
+#include <random>
+#include <cmath>
+#include <mutex>
+#include <condition_variable>
+// C++20编译时提供分析协程
+#ifdef __cpp_impl_coroutine
+#if __has_include(<coroutine>)
+#include <coroutine>
+#define SLR_COROUTINE
+#endif
+#endif
+// 后台服务用Unix域套接字，Windows上没有
+#ifndef _WIN32
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#include <csignal>
+#include <cerrno>
+#endif
+// x86上输入预处理用SSSE3/AVX2，其他平台只有标量版本
+#if defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SCAN_X86
+#include <immintrin.h>
+#ifdef _MSC_VER
+#include <intrin.h>
+#endif
+#endif
 #pragma execution_character_set("utf-8")
 using namespace std;
 
@@ -34,18 +77,13 @@ Widget::~Widget()
     delete ui;
 }
 
-// 全局文法变量
-string grammarStr;
-
-// 结构化后的文法map
-unordered_map<char, set<string>> grammarMap;
-
 // 文法unit（用于LR0）
 struct grammarUnit
 {
     int gid;
     char left;
     string right;
+    char prec = 0; // %prec指定的优先级符号，0表示取右部最后一个有优先级的终结符
     grammarUnit(char l, string r)
     {
         left = l;
@@ -53,15 +91,97 @@ struct grammarUnit
     }
 };
 
-// 文法数组（用于LR0）
-deque<grammarUnit> grammarDeque;
+// 产生式右部长度（空串@视为长度0）
+int rightLength(const grammarUnit& g)
+{
+    return g.right == "@" ? 0 : g.right.length();
+}
+
+// 按slr1table.h的约定读文法，增广判定和First/Follow的迭代与编译期分析表共用
+struct grammarView
+{
+    const deque<grammarUnit>& units;
+
+    int count() const { return units.size(); }
+    char leftOf(int gid) const { return units[gid].left; }
+    int lengthOf(int gid) const { return rightLength(units[gid]); }
+    char symbolAt(int gid, int k) const { return units[gid].right[k]; }
+};
+
+// 结合性
+enum assocType
+{
+    assocLeft,
+    assocRight,
+    assocNonassoc
+};
+
+// 终结符的优先级与结合性
+struct precUnit
+{
+    int level; // 越往后声明优先级越高
+    assocType assoc;
+};
+
+// %token/%skip声明的单词，终结符由正则表达式定义
+struct tokenDef
+{
+    char symbol; // 对应的终结符，%skip为0（匹配后丢弃）
+    string regex;
+};
+
+
+/************* 内存分配统计 ****************/
+// 编译时定义SLR_COUNT_ALLOCATIONS则替换全局operator new，按当前线程所处的分析阶段统计分配次数和字节数，
+// 批量分析用--alloc-report输出、--alloc-budget检查上限，确保已经不分配内存的热路径以后也不会再分配
+// 不定义时allocPhase只记录阶段，不影响分配
+enum allocPhaseId
+{
+    phaseOther,
+    phaseGrammar,     // 读入、化简文法
+    phaseFirstFollow, // First、Follow集合
+    phaseLR0,         // LR(0)自动机
+    phaseTable,       // SLR(1)/LALR(1)/LR(1)分析表
+    phaseRuntime,     // 运行时分析表
+    phaseParse,       // 句子分析
+    phaseCount
+};
+
+const char* const allocPhaseNames[phaseCount] = { "other", "grammar", "first-follow", "lr0", "table", "runtime", "parse" };
 
-// LR0结果提示字符串
-QString LR0Result;
+// 静态存储期的atomic先零初始化，main之前的分配也能计数
+atomic<long long> allocCount[phaseCount];
+atomic<long long> allocBytes[phaseCount];
+thread_local int currentAllocPhase = phaseOther;
+
+// 在作用域内把当前线程切换到某个阶段，结束时恢复
+struct allocPhase
+{
+    int saved;
+    explicit allocPhase(int phase) : saved(currentAllocPhase) { currentAllocPhase = phase; }
+    ~allocPhase() { currentAllocPhase = saved; }
+    void enter(int phase) { currentAllocPhase = phase; }
+};
 
-// 文法查找下标
-map<pair<char, string>, int> grammarToInt;
+#ifdef SLR_COUNT_ALLOCATIONS
+void* countedAlloc(size_t size)
+{
+    allocCount[currentAllocPhase].fetch_add(1, memory_order_relaxed);
+    allocBytes[currentAllocPhase].fetch_add(size, memory_order_relaxed);
+    void* p = malloc(size ? size : 1);
+    if (!p) throw bad_alloc();
+    return p;
+}
 
+void* operator new(size_t size) { return countedAlloc(size); }
+void* operator new[](size_t size) { return countedAlloc(size); }
+void operator delete(void* p) noexcept { free(p); }
+void operator delete[](void* p) noexcept { free(p); }
+#ifdef __cpp_sized_deallocation
+void operator delete(void* p, size_t) noexcept { free(p); }
+void operator delete[](void* p, size_t) noexcept { free(p); }
+#endif
+#endif
 
 /*************  公用函数 ****************/
 // 非终结符
@@ -75,91 +195,205 @@ bool isSmallAlpha(char c)
 {
     return !(c >= 'A' && c <= 'Z') && c != '@';
 }
-void reset();
-
-// 开始符号
-char startSymbol;
 
-// 增广后开始符号
-char trueStartSymbol;
-
-/************* 文法初始化处理 ****************/
-
-// 处理文法
-void handleGrammar()
+// 分析表里的数组：建表时自己持有数据，从分析表文件载入时直接指向映射的只读内存
+// 下标只能读，总是经过p，不用判断来源；写要用edit，写之前先复制一份（只有建表和改表时会写）
+template <class T>
+class tableArray
 {
-    vector<string> lines;
-    istringstream iss(grammarStr);
-    string line;
+public:
+    tableArray() {}
+    tableArray(const tableArray& o) : owned(o.owned), p(o.borrowed() ? o.p : owned.data()), n(o.n) {}
+    tableArray& operator=(const tableArray& o)
+    {
+        if (this == &o) return *this;
+        owned = o.owned;
+        p = o.borrowed() ? o.p : owned.data();
+        n = o.n;
+        return *this;
+    }
+    // 移动时数据不动，p仍然有效
+    tableArray(tableArray&& o) noexcept : owned(move(o.owned)), p(o.p), n(o.n)
+    {
+        o.p = nullptr;
+        o.n = 0;
+    }
+    tableArray& operator=(tableArray&& o) noexcept
+    {
+        if (this == &o) return *this;
+        owned = move(o.owned);
+        p = o.p;
+        n = o.n;
+        o.p = nullptr;
+        o.n = 0;
+        return *this;
+    }
 
-    // 防止中间有换行符
-    while (getline(iss, line))
+    const T& operator[](size_t i) const { return p[i]; }
+    T& edit(size_t i)
     {
-        if (!line.empty())
-        {
-            lines.push_back(line);
-        }
+        own();
+        return owned[i];
     }
+    const T* data() const { return p; }
+    size_t size() const { return n; }
+    bool empty() const { return n == 0; }
+    const T* begin() const { return p; }
+    const T* end() const { return p + n; }
 
-    for (const auto& rule : lines)
+    void assign(size_t count, const T& value)
     {
-        istringstream ruleStream(rule);
-        char nonTerminal;
-        ruleStream >> nonTerminal;  // 读取非终结符
+        owned.assign(count, value);
+        update();
+    }
+    void resize(size_t count)
+    {
+        own();
+        owned.resize(count);
+        update();
+    }
+    void push_back(const T& value)
+    {
+        own();
+        owned.push_back(value);
+        update();
+    }
+    // 指向外部的只读数据，不复制
+    void borrow(const T* data, size_t count)
+    {
+        owned.clear();
+        owned.shrink_to_fit();
+        p = data;
+        n = count;
+    }
+    bool borrowed() const { return p != nullptr && p != owned.data(); }
 
-        // 验证非终结符的格式
-        if (!isBigAlpha(nonTerminal))
-        {
-            QMessageBox::critical(nullptr, "Error", "文法开头必须是非终结符（大写字母）!");
-            continue;
-        }
+private:
+    void own()
+    {
+        if (!borrowed()) return;
+        owned.assign(p, p + n);
+        update();
+    }
+    void update()
+    {
+        p = owned.data();
+        n = owned.size();
+    }
 
-        // 跳过箭头及空格
-        ruleStream.ignore(numeric_limits<streamsize>::max(), '-');
-        ruleStream.ignore(numeric_limits<streamsize>::max(), '>');
+    vector<T> owned;
+    const T* p = nullptr;
+    size_t n = 0;
+};
 
-        string rightHandSide;
-        ruleStream >> rightHandSide;  // 获取产生式右侧
+// 分段栈：按固定大小的段分配，压栈时已有的元素不搬动（vector扩容时要整体复制），
+// 段分配后留着给下一句复用；元素个数到limit时压栈失败，由使用者报告嵌套太深
+template <class T>
+class segmentedStack
+{
+public:
+    static const int segmentBits = 12;
+    static const size_t segmentSize = size_t(1) << segmentBits;
+    static const size_t keptSegments = 16; // 重新开始时最多留下的段数，一个特别深的句子之后把内存还回去
+
+    size_t limit = numeric_limits<size_t>::max();
+
+    // 段都是整页大小，几个栈的段起点低12位容易相同，栈底的读写会被CPU误当成相关（4K别名）而互相等待，
+    // 所以每个栈的段起点错开不同的缓存行
+    segmentedStack() : skew(nextSkew() * 64 / sizeof(T)) {}
+    segmentedStack(const segmentedStack&) = delete;
+    segmentedStack& operator=(const segmentedStack&) = delete;
+    segmentedStack(segmentedStack&&) = default;
+    segmentedStack& operator=(segmentedStack&&) = default;
+
+    size_t size() const { return base + (top - segmentBegin); }
+    bool empty() const { return size() == 0; }
+    // 段内的元素从skew开始放
+    T& operator[](size_t i) { return segments[i >> segmentBits][skew + (i & (segmentSize - 1))]; }
+    const T& operator[](size_t i) const { return segments[i >> segmentBits][skew + (i & (segmentSize - 1))]; }
+    T& back() { return top[-1]; }
+    const T& back() const { return top[-1]; }
+
+    // 超过上限时返回false，栈不变
+    bool push_back(const T& value)
+    {
+        if (top == segmentEnd && !nextSegment()) return false;
+        *top++ = value;
+        return true;
+    }
+    void pop_back() { pop(1); }
+    // 弹出k个，归约时用
+    void pop(size_t k)
+    {
+        if ((size_t)(top - segmentBegin) > k) top -= k;
+        else resize(size() - k);
+    }
 
-        // 如果是第一条规则，则认为是开始符号
-        if (grammarMap.empty())
+    // 只能缩短
+    void resize(size_t n)
+    {
+        // 常见情况：栈顶还在当前段内
+        if (n > base)
         {
-            startSymbol = nonTerminal;
-            trueStartSymbol = startSymbol;
+            top = segmentBegin + (n - base);
+            return;
         }
+        if (segments.empty()) return;
+        useSegment(n == 0 ? 0 : (n - 1) >> segmentBits);
+        top = segmentBegin + (n - base);
+    }
 
-        // 将文法结构化
-        grammarMap[nonTerminal].insert(rightHandSide);
-
-        // 为LR0做准备
-        grammarDeque.push_back(grammarUnit(nonTerminal, rightHandSide));
+    // 清空后放入n个元素，用于每句开始
+    void assign(size_t n, const T& value)
+    {
+        resize(0);
+        if (segments.size() > keptSegments) segments.resize(keptSegments);
+        for (size_t i = 0; i < n; ++i) push_back(value);
     }
+    void clear() { assign(0, T()); }
 
-    // 增广处理
-    if (grammarMap[startSymbol].size() > 1)
+    // 复制[from, size())到out
+    void copyTop(size_t from, T* out) const
     {
-        // 如果开始符号多于2个，说明需要增广，为了避免出现字母重复，采用^作为增广后的字母，后期输出特殊处理
-        grammarDeque.push_front(grammarUnit('^', string(1, startSymbol)));
-        LR0Result += QString::fromStdString("进行了增广处理\n");
-        trueStartSymbol = '^';
+        for (size_t i = from, n = size(); i < n; ++i) *out++ = (*this)[i];
     }
 
-    // 开始编号
-    int gid = 0;
-    for (auto& g : grammarDeque)
+private:
+    // 当前段写满，换到下一段
+    bool nextSegment()
     {
-        g.gid = gid++;
-        LR0Result += QString::number(g.gid) + QString::fromStdString(":") 
-            + QString::fromStdString(g.left == '^' ? "E\'" : string(1, g.left)) + QString::fromStdString("->")
-            + QString::fromStdString(g.right) + "\n";
-        // 存入map中
-        grammarToInt[make_pair(g.left, g.right)] = g.gid;
+        size_t n = size();
+        if (n >= limit) return false;
+        size_t index = n >> segmentBits;
+        if (index == segments.size()) segments.emplace_back(new T[segmentSize + skew]);
+        useSegment(index);
+        top = segmentBegin;
+        return true;
+    }
+    // 最后一段只用到limit为止，压栈时只需比较top和segmentEnd
+    void useSegment(size_t index)
+    {
+        base = index << segmentBits;
+        segmentBegin = segments[index].get() + skew;
+        segmentEnd = segmentBegin + min(size_t(segmentSize), limit - base);
     }
 
-}
+    static size_t nextSkew()
+    {
+        static atomic<unsigned> counter(0);
+        return counter++ % 16;
+    }
 
-/************* First集合求解 ****************/
+    size_t skew; // 段起点错开的元素数
+    vector<unique_ptr<T[]>> segments;
+    T* segmentBegin = nullptr;
+    T* segmentEnd = nullptr;
+    T* top = nullptr;
+    size_t base = 0; // segmentBegin是第几个元素
+};
 
+/************* 文法上下文 ****************/
+// 各分析阶段的数据结构
 
 // First集合单元
 struct firstUnit
@@ -168,181 +402,12 @@ struct firstUnit
     bool isEpsilon = false;
 };
 
-// 非终结符的First集合
-map<char, firstUnit> firstSets;
-
-// 计算First集合
-bool calculateFirstSets()
-{
-    bool flag = false;
-    for (auto& grammar : grammarMap)
-    {
-        char nonTerminal = grammar.first;
-        // 保存当前First集合的大小，用于检查是否有变化
-        size_t originalSize = firstSets[nonTerminal].s.size();
-        bool originalE = firstSets[nonTerminal].isEpsilon;
-        for (auto& g : grammar.second)
-        {
-            int k = 0;
-            while (k <= g.size() - 1)
-            {
-                set<char> first_k;
-                if (g[k] == '@')
-                {
-                    k++;
-                    continue;
-                }
-                else if (isSmallAlpha(g[k]))
-                {
-                    first_k.insert(g[k]);
-                }
-                else
-                {
-                    first_k = firstSets[g[k]].s;
-                }
-                firstSets[nonTerminal].s.insert(first_k.begin(), first_k.end());
-                // 如果是终结符或者没有空串在非终结符中，直接跳出
-                if (isSmallAlpha(g[k]) || !firstSets[g[k]].isEpsilon)
-                {
-                    break;
-                }
-                k++;
-            }
-            if (k == g.size())
-            {
-                firstSets[nonTerminal].isEpsilon = true;
-            }
-        }
-        // 看原始大小和是否变化epsilon，如果变化说明还得重新再来一次
-        if (originalSize != firstSets[nonTerminal].s.size() || originalE != firstSets[nonTerminal].isEpsilon)
-        {
-            flag = true;
-        }
-    }
-    return flag;
-}
-
-void getFirstSets()
-{
-    // 不停迭代，直到First集合不再变化
-    bool flag = false;
-    do
-    {
-        flag = calculateFirstSets();
-    } while (flag);
-}
-
-
-/************* Follow集合求解 ****************/
 // Follow集合单元
 struct followUnit
 {
     set<char> s;
 };
 
-// 非终结符的Follow集合
-map<char, followUnit> followSets;
-
-// 添加Follow集合
-void addToFollow(char nonTerminal, const set<char>& elements)
-{
-    followSets[nonTerminal].s.insert(elements.begin(), elements.end());
-}
-
-// 计算Follow集合
-bool calculateFollowSets()
-{
-    bool flag = false;
-    for (auto& grammar : grammarMap)
-    {
-        char nonTerminal = grammar.first;
-
-        for (auto& g : grammar.second)
-        {
-            for (int i = 0; i < g.size(); ++i)
-            {
-                if (isSmallAlpha(g[i]) || g[i] == '@')
-                {
-                    continue;  // 跳过终结符
-                }
-
-                set<char> follow_k;
-                size_t originalSize = followSets[g[i]].s.size();
-
-                if (i == g.size() - 1)
-                {
-                    // Case A: A -> αB, add Follow(A) to Follow(B)
-                    follow_k.insert(followSets[nonTerminal].s.begin(), followSets[nonTerminal].s.end());
-                }
-                else
-                {
-                    // Case B: A -> αBβ
-                    int j = i + 1;
-                    while (j < g.size())
-                    {
-                        if (isSmallAlpha(g[j]))
-                        {   // 终结符直接加入并跳出
-                            follow_k.insert(g[j]);
-                            break;
-                        }
-                        else
-                        {   // 非终结符加入first集合
-                            set<char> first_beta = firstSets[g[j]].s;
-                            follow_k.insert(first_beta.begin(), first_beta.end());
-
-                            // 如果没有空串在first集合中，停止。
-                            if (!firstSets[g[j]].isEpsilon)
-                            {
-                                break;
-                            }
-
-                            ++j;
-                        }
-
-                    }
-
-                    // If β is ε or β is all nullable, add Follow(A) to Follow(B)
-                    if (j == g.size())
-                    {
-                        follow_k.insert(followSets[nonTerminal].s.begin(), followSets[nonTerminal].s.end());
-                    }
-                }
-
-                addToFollow(g[i], follow_k);
-                // 检查是否变化
-                if (originalSize != followSets[g[i]].s.size())
-                {
-                    flag = true;
-                }
-            }
-        }
-
-
-    }
-
-    return flag;
-}
-
-void getFollowSets()
-{
-    // 开始符号加入$
-    addToFollow(startSymbol, { '$' });
-
-    // 不停迭代，直到Follow集合不再变化
-    bool flag = false;
-    do
-    {
-        flag = calculateFollowSets();
-    } while (flag);
-}
-
-/************* LR0 DFA表生成 ****************/
-
-// 状态编号
-int scnt = 0;
-// 项目编号
-int ccnt = 0;
-
 // DFA表每一项项目的结构
 struct dfaCell
 {
@@ -351,9 +416,6 @@ struct dfaCell
     int index = 0; // .在第几位，如i=3, xxx.x，i=0, .xxxx, i=4, xxxx
 };
 
-// 用于通过编号快速找到对应结构
-vector<dfaCell> dfaCellVector;
-
 struct nextStateUnit
 {
     char c; // 通过什么字符进入这个状态
@@ -371,147 +433,548 @@ struct dfaState
     set<char> right_VNs; // 判断是否已经处理过这个非终结符
 };
 
-// 用于通过编号快速找到对应结构
-vector<dfaState> dfaStateVector;
-
-// 非终结符集合
-set<char> VN;
-// 终结符集合
-set<char> VT;
-
-// 判断是不是新结构
-int isNewCell(int gid, int index)
+struct SLRUnit
 {
-    for (const dfaCell& cell : dfaCellVector)
-    {
-        // 检查dfaCellVector中是否存在相同的gid和index的dfaCell
-        if (cell.gid == gid && cell.index == index)
-        {
-            return cell.cellid; // 不是新结构
-        }
-    }
-    return -1; // 是新结构
-}
+    map<char, string> m;
+};
 
-// 判断是不是新状态
-int isNewState(const vector<int>& cellIds)
+// 非终结符转移(p, A)
+struct ntTransUnit
 {
-    for (const dfaState& state : dfaStateVector)
-    {
-        // 检查状态中的originV是否相同
-        if (state.originV.size() == cellIds.size() &&
-            equal(state.originV.begin(), state.originV.end(), cellIds.begin()))
-        {
-            return state.sid; // 不是新状态
-        }
-    }
-
-    return -1; // 是新状态
-}
+    int sid; // 出发状态
+    char c; // 转移的非终结符
+    int to; // 到达状态，-1表示开始符号的虚拟转移
+};
 
-// DFS标记数组
-set<int> visitedStates;
+// LR1项目集：(文法编号, 点的位置) -> 向前看符号
+typedef map<pair<int, int>, set<char>> lr1Items;
 
-// 创建LR0的初始状态
-void createFirstState()
+// LR1状态
+struct lr1State
 {
-    // 由于增广，一定会只有一个入口
-    dfaState zero = dfaState();
-    zero.sid = scnt++; // 给他一个id
-    dfaStateVector.push_back(zero); // 放入数组中
+    int sid; // 状态id
+    lr1Items kernel; // 核心项目
+    lr1Items reduceItems; // 闭包中的归约项目
+    vector<nextStateUnit> nextStateVector; // 下一个状态集合
+};
 
-    // 添加初始的LR0项，即E' -> .S
-    dfaCell startCell;
-    startCell.gid = 0; // 这里假设增广文法的编号为0
-    startCell.index = 0;
-    startCell.cellid = ccnt++;
+// 词法分析表，状态0为死状态，1为开始状态
+struct lexerTable
+{
+    int stateCount = 0; // 为0表示没有词法分析器，终结符就是输入的字符
+    int classCount = 0;
+    unsigned char charClass[256]; // 字符到等价类
+    tableArray<int> next; // stateCount * classCount
+    tableArray<int> accept; // 每个状态接受的终结符，0为不接受，-1为%skip
+    int nfaCount = 0; // 以下用于报告
+    int dfaCount = 0;
+};
 
-    dfaCellVector.push_back(startCell);
+// 一个文法从输入到各种分析表的全部中间结果
+// 各阶段的函数都显式接收上下文，不同的文法可以在不同线程上同时分析；上下文可以移动，分析完整个交出去不用复制
+struct grammarContext
+{
+    string grammarStr; // 文法文本
+    unordered_map<char, set<string>> grammarMap; // 结构化后的文法map
+    deque<grammarUnit> grammarDeque; // 文法数组（用于LR0）
+    QString LR0Result; // LR0结果提示字符串
+    map<pair<char, string>, int> grammarToInt; // 文法查找下标
+    map<char, precUnit> precedenceMap; // 终结符优先级（%left %right %nonassoc声明）
+    int precResolvedCount = 0; // 用优先级解决的移进-归约冲突数
+    char errorSymbol = 0; // %error声明的错误终结符，用于错误产生式，0表示没有
+    vector<tokenDef> tokenDefs; // 按声明顺序排列，同样长度的匹配先声明的优先
+    lexerTable grammarLexer; // 由tokenDefs生成的词法分析器
+    char startSymbol = 0; // 开始符号
+    char trueStartSymbol = 0; // 增广后开始符号
+
+    map<char, firstUnit> firstSets; // 非终结符的First集合
+    map<char, followUnit> followSets; // 非终结符的Follow集合
+
+    int scnt = 0; // 状态编号
+    int ccnt = 0; // 项目编号
+    vector<dfaCell> dfaCellVector; // 用于通过编号快速找到对应结构
+    vector<dfaState> dfaStateVector; // 用于通过编号快速找到对应结构
+    set<char> VN; // 非终结符集合
+    set<char> VT; // 终结符集合
+    set<int> visitedStates; // DFS标记数组
+
+    vector<SLRUnit> SLRVector; // SLR1分析表
+    vector<ntTransUnit> ntTransVector; // 所有非终结符转移
+    map<pair<int, char>, int> ntTransToInt; // 通过(状态, 非终结符)找到转移编号
+    map<pair<int, int>, set<char>> lalrLookahead; // 每个归约项目(状态, 文法编号)的向前看符号
+    vector<SLRUnit> LALRVector; // LALR1分析表
+    vector<lr1State> lr1StateVector; // 最小LR1状态
+    vector<SLRUnit> LR1Vector; // 最小LR1分析表
+    vector<SLRUnit> GLRVector; // 展示用的GLR分析表，冲突的格子用/分隔所有动作
+
+    vector<string> errors; // 文法中的错误
+    bool quiet = false; // 为true时错误只记在errors中，不弹出对话框（命令行和后台服务没有界面）
+};
 
-    // 把初始LR0项放入初始状态
-    dfaStateVector[0].cellV.push_back(startCell.cellid);
-    dfaStateVector[0].originV.push_back(startCell.cellid);
-}
+void reset(grammarContext& ctx);
+void numberGrammar(grammarContext& ctx);
+void buildGrammarLexer(grammarContext& ctx);
 
-// 生成LR0状态
-void generateLR0State(int stateId)
+// 文法错误：记在上下文中，有界面时同时弹出对话框
+void grammarError(grammarContext& ctx, const string& message)
 {
-    // DFS,如果走过就不走了
-    if (visitedStates.count(stateId) > 0) {
-        return;
-    }
+    ctx.errors.push_back(message);
+    if (!ctx.quiet) QMessageBox::critical(nullptr, "Error", QString::fromStdString(message));
+}
 
-    // 标记走过了
-    visitedStates.insert(stateId);
 
-    //if (dfaStateVector[stateId].isEnd)
-    //{
-    //    return;
-    //}
+/************* 文法初始化处理 ****************/
 
-    qDebug() << stateId << endl;
+// 处理文法
+void handleGrammar(grammarContext& ctx)
+{
+    vector<string> lines;
+    istringstream iss(ctx.grammarStr);
+    string line;
 
-    // 求闭包
-    for (int i = 0; i < dfaStateVector[stateId].cellV.size(); ++i)
+    // 防止中间有换行符，跳过空白行和#开头的注释行
+    while (getline(iss, line))
     {
-        dfaCell& currentCell = dfaCellVector[dfaStateVector[stateId].cellV[i]];
-
-        qDebug() << grammarDeque[currentCell.gid].left << QString::fromStdString("->") << QString::fromStdString( grammarDeque[currentCell.gid].right) << endl;
-
-        qDebug() << "current index:" << currentCell.index << endl;
-
-        // 如果点号在产生式末尾或者空串，则跳过（LR0不需要结束）
-        if (currentCell.index == grammarDeque[currentCell.gid].right.length() || grammarDeque[currentCell.gid].right == "@")
+        if (line.find_first_not_of(" \t\r") != string::npos && line[0] != '#')
         {
-            dfaStateVector[stateId].isEnd = true;
-            continue;
+            lines.push_back(line);
         }
+    }
 
-        char nextSymbol = grammarDeque[currentCell.gid].right[currentCell.index];
-        
+    for (const auto& rule : lines)
+    {
+        istringstream ruleStream(rule);
 
-        // 如果nextSymbol是非终结符，则将新项添加到状态中
-        if (isBigAlpha(nextSymbol) && dfaStateVector[stateId].right_VNs.find(nextSymbol) == dfaStateVector[stateId].right_VNs.end())
+        // 优先级声明，如 %left + -
+        if (rule[0] == '%')
         {
-            dfaStateVector[stateId].right_VNs.insert(nextSymbol);
-            for (auto& grammar : grammarMap[nextSymbol])
+            string directive;
+            ruleStream >> directive;
+            // 错误终结符声明，如 %error e
+            if (directive == "%error")
             {
-                // 获取通过nextSymbol转移的新LR0项
-                dfaCell nextCell = dfaCell();
-                nextCell.gid = grammarToInt[make_pair(nextSymbol,grammar)];
-                nextCell.index = 0;
-                int nextcellid = isNewCell(nextCell.gid, nextCell.index);
-                if (nextcellid == -1)
+                string symbol;
+                if (ruleStream >> symbol && isSmallAlpha(symbol[0])) ctx.errorSymbol = symbol[0];
+                continue;
+            }
+            // 单词声明，如 %token n [0-9]+，%skip [ \t]+
+            if (directive == "%token" || directive == "%skip")
+            {
+                tokenDef d;
+                d.symbol = 0;
+                string symbol;
+                if (directive == "%token")
                 {
-                    nextCell.cellid = ccnt++;
-                    dfaCellVector.push_back(nextCell);
-                    dfaStateVector[stateId].cellV.push_back(nextCell.cellid);
+                    if (!(ruleStream >> symbol) || symbol.length() != 1 || !isSmallAlpha(symbol[0]) || symbol[0] == '$')
+                    {
+                        grammarError(ctx, "%token后面必须是一个终结符!");
+                        continue;
+                    }
+                    d.symbol = symbol[0];
                 }
-                else dfaStateVector[stateId].cellV.push_back(nextcellid);
+                // 余下部分（去掉首尾空白）就是正则表达式
+                getline(ruleStream, d.regex);
+                size_t b = d.regex.find_first_not_of(" \t"), e = d.regex.find_last_not_of(" \t\r");
+                d.regex = b == string::npos ? "" : d.regex.substr(b, e - b + 1);
+                ctx.tokenDefs.push_back(d);
+                continue;
             }
-        
-        }
-    }
-
-    // 暂存新状态
-    map<char,dfaState> tempSave;
+            precUnit p = precUnit();
+            if (directive == "%left") p.assoc = assocLeft;
+            else if (directive == "%right") p.assoc = assocRight;
+            else if (directive == "%nonassoc") p.assoc = assocNonassoc;
+            else
+            {
+                grammarError(ctx, "无法识别的声明：" + directive);
+                continue;
+            }
+            // 同一行的终结符优先级相同
+            int level = 1;
+            for (const auto& pu : ctx.precedenceMap) level = max(level, pu.second.level + 1);
+            p.level = level;
+            string symbol;
+            while (ruleStream >> symbol)
+            {
+                if (!isSmallAlpha(symbol[0]))
+                {
+                    grammarError(ctx, "只能为终结符声明优先级!");
+                    continue;
+                }
+                ctx.precedenceMap[symbol[0]] = p;
+            }
+            continue;
+        }
+
+        char nonTerminal;
+        ruleStream >> nonTerminal;  // 读取非终结符
+
+        // 验证非终结符的格式
+        if (!isBigAlpha(nonTerminal))
+        {
+            grammarError(ctx, "文法开头必须是非终结符（大写字母）!");
+            continue;
+        }
+
+        // 跳过箭头及空格
+        ruleStream.ignore(numeric_limits<streamsize>::max(), '-');
+        ruleStream.ignore(numeric_limits<streamsize>::max(), '>');
+
+        string rightHandSide;
+        ruleStream >> rightHandSide;  // 获取产生式右侧
+
+        // 可选的 %prec x，指定产生式的优先级；右部中间不能有空格，后面也不能有别的内容
+        string precWord, precSymbol, extra;
+        char prec = 0;
+        if (ruleStream >> precWord)
+        {
+            if (precWord != "%prec" || !(ruleStream >> precSymbol) || precSymbol.length() != 1 || !isSmallAlpha(precSymbol[0])
+                || ruleStream >> extra)
+            {
+                grammarError(ctx, "产生式右部之后只能是%prec和一个终结符：" + rule);
+                continue;
+            }
+            prec = precSymbol[0];
+        }
+
+        // 如果是第一条规则，则认为是开始符号
+        if (ctx.grammarMap.empty())
+        {
+            ctx.startSymbol = nonTerminal;
+            ctx.trueStartSymbol = ctx.startSymbol;
+        }
+
+        // 将文法结构化
+        ctx.grammarMap[nonTerminal].insert(rightHandSide);
+
+        // 为LR0做准备
+        ctx.grammarDeque.push_back(grammarUnit(nonTerminal, rightHandSide));
+        ctx.grammarDeque.back().prec = prec;
+    }
+
+    // 增广处理
+    if (!ctx.grammarDeque.empty() && slr1::needsAugment(grammarView{ ctx.grammarDeque }, ctx.startSymbol))
+    {
+        // 开始符号有多条产生式或者出现在右部时需要增广，为了避免出现字母重复，采用^作为增广后的字母，后期输出特殊处理
+        ctx.grammarDeque.push_front(grammarUnit('^', string(1, ctx.startSymbol)));
+        ctx.LR0Result += QString::fromStdString("进行了增广处理\n");
+        ctx.trueStartSymbol = '^';
+    }
+
+    // 有单词声明时生成词法分析器
+    if (!ctx.tokenDefs.empty()) buildGrammarLexer(ctx);
+
+    numberGrammar(ctx);
+}
+
+// 文法编号，并输出到LR0结果提示中
+void numberGrammar(grammarContext& ctx)
+{
+    // 开始编号
+    int gid = 0;
+    ctx.grammarToInt.clear();
+    for (auto& g : ctx.grammarDeque)
+    {
+        g.gid = gid++;
+        ctx.LR0Result += QString::number(g.gid) + QString::fromStdString(":") 
+            + QString::fromStdString(g.left == '^' ? "E\'" : string(1, g.left)) + QString::fromStdString("->")
+            + QString::fromStdString(g.right) + "\n";
+        // 存入map中
+        ctx.grammarToInt[make_pair(g.left, g.right)] = g.gid;
+    }
+}
+
+/************* 文法化简 ****************/
+// 删除不能推导出终结符串的非终结符和从开始符号不可达的非终结符，以及含有它们的产生式
+// 两遍都是线性的：有用性用计数+队列，可达性用BFS
+void pruneGrammar(grammarContext& ctx)
+{
+    int n = ctx.grammarDeque.size();
+
+    // 每条产生式右部还有多少个非终结符没确定能推出终结符串
+    vector<int> remain(n, 0);
+    map<char, vector<int>> occurrences;
+    set<char> productive;
+    queue<char> q;
+    for (int i = 0; i < n; ++i)
+    {
+        const string& right = ctx.grammarDeque[i].right;
+        for (char c : right)
+        {
+            if (isBigAlpha(c))
+            {
+                ++remain[i];
+                occurrences[c].push_back(i);
+            }
+        }
+    }
+    auto markProductive = [&](char c)
+    {
+        if (productive.insert(c).second) q.push(c);
+    };
+    for (int i = 0; i < n; ++i)
+    {
+        if (remain[i] == 0) markProductive(ctx.grammarDeque[i].left);
+    }
+    while (!q.empty())
+    {
+        char c = q.front();
+        q.pop();
+        for (int i : occurrences[c])
+        {
+            if (--remain[i] == 0) markProductive(ctx.grammarDeque[i].left);
+        }
+    }
+
+    // 开始符号推不出终结符串时，文法语言为空，不做删除
+    if (productive.count(ctx.trueStartSymbol) == 0)
+    {
+        ctx.LR0Result += QString::fromStdString("开始符号不能推导出终结符串，未进行化简\n");
+        return;
+    }
+
+    // 只在有用的产生式上求可达
+    map<char, vector<int>> leftToIndex;
+    for (int i = 0; i < n; ++i)
+    {
+        if (remain[i] == 0) leftToIndex[ctx.grammarDeque[i].left].push_back(i);
+    }
+    set<char> reachable;
+    reachable.insert(ctx.trueStartSymbol);
+    q.push(ctx.trueStartSymbol);
+    while (!q.empty())
+    {
+        char c = q.front();
+        q.pop();
+        for (int i : leftToIndex[c])
+        {
+            for (char x : ctx.grammarDeque[i].right)
+            {
+                if (isBigAlpha(x) && reachable.insert(x).second) q.push(x);
+            }
+        }
+    }
+
+    // 删除无用的产生式
+    deque<grammarUnit> kept;
+    set<char> dropped;
+    int droppedCount = 0;
+    for (int i = 0; i < n; ++i)
+    {
+        const grammarUnit& g = ctx.grammarDeque[i];
+        if (remain[i] == 0 && reachable.count(g.left))
+        {
+            kept.push_back(g);
+            continue;
+        }
+        ++droppedCount;
+        if (g.left != '^') ctx.grammarMap[g.left].erase(g.right);
+        if (!productive.count(g.left) || !reachable.count(g.left)) dropped.insert(g.left);
+        for (char x : g.right)
+        {
+            if (isBigAlpha(x) && !productive.count(x)) dropped.insert(x);
+        }
+    }
+    if (droppedCount == 0) return;
+    for (char c : dropped)
+    {
+        ctx.grammarMap.erase(c);
+    }
+    ctx.grammarDeque = kept;
+
+    // 重新编号并输出删除结果
+    ctx.LR0Result.clear();
+    if (ctx.trueStartSymbol == '^') ctx.LR0Result += QString::fromStdString("进行了增广处理\n");
+    ctx.LR0Result += QString::fromStdString("化简删除了" + to_string(droppedCount) + "条产生式");
+    if (!dropped.empty())
+    {
+        ctx.LR0Result += QString::fromStdString("，无用符号：");
+        for (char c : dropped) ctx.LR0Result += QString(c) + " ";
+    }
+    ctx.LR0Result += "\n";
+    numberGrammar(ctx);
+}
+
+/************* First集合求解 ****************/
+// 迭代在slr1table.h中（和编译期分析表共用），这里转成按非终结符的集合
+
+// 产生式右部出现的非终结符，withLeft为true时加上各产生式的左部（不含增广的^）
+set<char> grammarNonterminals(const grammarContext& ctx, bool withLeft)
+{
+    set<char> result;
+    for (const auto& g : ctx.grammarDeque)
+    {
+        if (withLeft && g.left != '^') result.insert(g.left);
+        for (char c : g.right)
+        {
+            if (isBigAlpha(c)) result.insert(c);
+        }
+    }
+    return result;
+}
+
+set<char> charSetToSet(const slr1::charSet& s)
+{
+    set<char> result;
+    for (int c = 0; c < 256; ++c)
+    {
+        if (s.test((char)c)) result.insert((char)c);
+    }
+    return result;
+}
+
+void getFirstSets(grammarContext& ctx)
+{
+    bool nullable[256] = {};
+    slr1::charSet first[256];
+    slr1::computeFirst(grammarView{ ctx.grammarDeque }, nullable, first);
+    ctx.firstSets.clear();
+    for (char c : grammarNonterminals(ctx, true))
+    {
+        firstUnit& f = ctx.firstSets[c];
+        f.s = charSetToSet(first[(unsigned char)c]);
+        f.isEpsilon = nullable[(unsigned char)c];
+    }
+}
+
+
+/************* Follow集合求解 ****************/
+
+void getFollowSets(grammarContext& ctx)
+{
+    // First集合由getFirstSets算好，转回按字符下标的数组
+    bool nullable[256] = {};
+    slr1::charSet first[256], follow[256];
+    for (const auto& f : ctx.firstSets)
+    {
+        nullable[(unsigned char)f.first] = f.second.isEpsilon;
+        for (char c : f.second.s) first[(unsigned char)f.first].set(c);
+    }
+    slr1::computeFollow(grammarView{ ctx.grammarDeque }, ctx.startSymbol, nullable, first, follow);
+    ctx.followSets.clear();
+    set<char> keys = grammarNonterminals(ctx, false);
+    keys.insert(ctx.startSymbol);
+    for (char c : keys) ctx.followSets[c].s = charSetToSet(follow[(unsigned char)c]);
+}
+
+/************* LR0 DFA表生成 ****************/
+
+// 判断是不是新结构
+int isNewCell(const grammarContext& ctx, int gid, int index)
+{
+    for (const dfaCell& cell : ctx.dfaCellVector)
+    {
+        // 检查dfaCellVector中是否存在相同的gid和index的dfaCell
+        if (cell.gid == gid && cell.index == index)
+        {
+            return cell.cellid; // 不是新结构
+        }
+    }
+    return -1; // 是新结构
+}
+
+// 判断是不是新状态
+int isNewState(const grammarContext& ctx, const vector<int>& cellIds)
+{
+    for (const dfaState& state : ctx.dfaStateVector)
+    {
+        // 检查状态中的originV是否相同
+        if (state.originV.size() == cellIds.size() &&
+            equal(state.originV.begin(), state.originV.end(), cellIds.begin()))
+        {
+            return state.sid; // 不是新状态
+        }
+    }
+
+    return -1; // 是新状态
+}
+
+// 创建LR0的初始状态
+void createFirstState(grammarContext& ctx)
+{
+    // 由于增广，一定会只有一个入口
+    dfaState zero = dfaState();
+    zero.sid = ctx.scnt++; // 给他一个id
+    ctx.dfaStateVector.push_back(zero); // 放入数组中
+
+    // 添加初始的LR0项，即E' -> .S
+    dfaCell startCell;
+    startCell.gid = 0; // 这里假设增广文法的编号为0
+    startCell.index = 0;
+    startCell.cellid = ctx.ccnt++;
+
+    ctx.dfaCellVector.push_back(startCell);
+
+    // 把初始LR0项放入初始状态
+    ctx.dfaStateVector[0].cellV.push_back(startCell.cellid);
+    ctx.dfaStateVector[0].originV.push_back(startCell.cellid);
+}
+
+// 求一个状态的闭包和转移，转移到的新状态只创建、不展开
+void expandLR0State(grammarContext& ctx, int stateId)
+{
+    qDebug() << stateId << endl;
+
+    // 求闭包
+    for (int i = 0; i < ctx.dfaStateVector[stateId].cellV.size(); ++i)
+    {
+        dfaCell& currentCell = ctx.dfaCellVector[ctx.dfaStateVector[stateId].cellV[i]];
+
+        qDebug() << ctx.grammarDeque[currentCell.gid].left << QString::fromStdString("->") << QString::fromStdString( ctx.grammarDeque[currentCell.gid].right) << endl;
+
+        qDebug() << "current index:" << currentCell.index << endl;
+
+        // 如果点号在产生式末尾或者空串，则跳过（LR0不需要结束）
+        if (currentCell.index == ctx.grammarDeque[currentCell.gid].right.length() || ctx.grammarDeque[currentCell.gid].right == "@")
+        {
+            ctx.dfaStateVector[stateId].isEnd = true;
+            continue;
+        }
+
+        char nextSymbol = ctx.grammarDeque[currentCell.gid].right[currentCell.index];
+        
+
+        // 如果nextSymbol是非终结符，则将新项添加到状态中
+        if (isBigAlpha(nextSymbol) && ctx.dfaStateVector[stateId].right_VNs.find(nextSymbol) == ctx.dfaStateVector[stateId].right_VNs.end())
+        {
+            ctx.dfaStateVector[stateId].right_VNs.insert(nextSymbol);
+            for (auto& grammar : ctx.grammarMap[nextSymbol])
+            {
+                // 获取通过nextSymbol转移的新LR0项
+                dfaCell nextCell = dfaCell();
+                nextCell.gid = ctx.grammarToInt[make_pair(nextSymbol,grammar)];
+                nextCell.index = 0;
+                int nextcellid = isNewCell(ctx, nextCell.gid, nextCell.index);
+                if (nextcellid == -1)
+                {
+                    nextCell.cellid = ctx.ccnt++;
+                    ctx.dfaCellVector.push_back(nextCell);
+                    ctx.dfaStateVector[stateId].cellV.push_back(nextCell.cellid);
+                }
+                else ctx.dfaStateVector[stateId].cellV.push_back(nextcellid);
+            }
+        
+        }
+    }
+
+    // 暂存新状态
+    map<char,dfaState> tempSave;
     // 生成新状态，但还不能直接存到dfaStateVector中，我们要校验他是否和之前的状态一样
-    for (int i = 0; i < dfaStateVector[stateId].cellV.size(); ++i)
+    for (int i = 0; i < ctx.dfaStateVector[stateId].cellV.size(); ++i)
     {
-        dfaCell& currentCell = dfaCellVector[dfaStateVector[stateId].cellV[i]];
+        dfaCell& currentCell = ctx.dfaCellVector[ctx.dfaStateVector[stateId].cellV[i]];
 
-        qDebug() << grammarDeque[currentCell.gid].left << QString::fromStdString("->") << QString::fromStdString(grammarDeque[currentCell.gid].right) << endl;
+        qDebug() << ctx.grammarDeque[currentCell.gid].left << QString::fromStdString("->") << QString::fromStdString(ctx.grammarDeque[currentCell.gid].right) << endl;
 
         qDebug() << "current index:" << currentCell.index << endl;
 
         // 如果点号在产生式末尾，则跳过（LR0不需要结束）
-        if (currentCell.index == grammarDeque[currentCell.gid].right.length() || grammarDeque[currentCell.gid].right == "@")
+        if (currentCell.index == ctx.grammarDeque[currentCell.gid].right.length() || ctx.grammarDeque[currentCell.gid].right == "@")
         {
             continue;
         }
 
         // 下一个字符
-        char nextSymbol = grammarDeque[currentCell.gid].right[currentCell.index];
+        char nextSymbol = ctx.grammarDeque[currentCell.gid].right[currentCell.index];
 
         // 创建下一个状态（临时的）
         dfaState& nextState = tempSave[nextSymbol];
@@ -520,11 +983,11 @@ void generateLR0State(int stateId)
         nextStateCell.index = currentCell.index + 1;
 
         // 看看里面的项目是否有重复的，如果重复拿之前的就好，不重复生成
-        int nextStateCellid = isNewCell(nextStateCell.gid, nextStateCell.index);
+        int nextStateCellid = isNewCell(ctx, nextStateCell.gid, nextStateCell.index);
         if (nextStateCellid == -1)
         {
-            nextStateCell.cellid = ccnt++;
-            dfaCellVector.push_back(nextStateCell);
+            nextStateCell.cellid = ctx.ccnt++;
+            ctx.dfaCellVector.push_back(nextStateCell);
         }
         else nextStateCell.cellid = nextStateCellid;
         nextState.cellV.push_back(nextStateCell.cellid);
@@ -533,11 +996,11 @@ void generateLR0State(int stateId)
         // 收集一下，方便后面画表
         if (isBigAlpha(nextSymbol))
         {
-            VN.insert(nextSymbol);
+            ctx.VN.insert(nextSymbol);
         }
         else if (isSmallAlpha(nextSymbol))
         {
-            VT.insert(nextSymbol);
+            ctx.VT.insert(nextSymbol);
         }
     }
 
@@ -545,307 +1008,5391 @@ void generateLR0State(int stateId)
     for (auto& t : tempSave)
     {
         dfaState nextState = dfaState();
-        int newStateId = isNewState(t.second.originV);
+        int newStateId = isNewState(ctx, t.second.originV);
         // 不重复就新开一个状态
         if (newStateId == -1)
         {
-            nextState.sid = scnt++;
+            nextState.sid = ctx.scnt++;
             nextState.cellV = t.second.cellV;
             nextState.originV = t.second.originV;
-            dfaStateVector.push_back(nextState);
+            ctx.dfaStateVector.push_back(nextState);
         }
         else nextState.sid = newStateId;
         // 存入现在这个状态的nextStateVector
         nextStateUnit n = nextStateUnit();
         n.sid = nextState.sid;
         n.c = t.first;
-        dfaStateVector[stateId].nextStateVector.push_back(n);
+        ctx.dfaStateVector[stateId].nextStateVector.push_back(n);
+    }
+}
+
+// 生成LR0状态
+void generateLR0State(grammarContext& ctx, int stateId)
+{
+    // DFS,如果走过就不走了
+    if (ctx.visitedStates.count(stateId) > 0) {
+        return;
     }
 
+    // 标记走过了
+    ctx.visitedStates.insert(stateId);
+
+    expandLR0State(ctx, stateId);
+
     // 对每个下一个状态进行递归
-    int nsize = dfaStateVector[stateId].nextStateVector.size();
+    int nsize = ctx.dfaStateVector[stateId].nextStateVector.size();
     for (int i = 0; i < nsize; i++)
     {
-        auto& nextunit = dfaStateVector[stateId].nextStateVector[i];
-        generateLR0State(nextunit.sid);
+        auto& nextunit = ctx.dfaStateVector[stateId].nextStateVector[i];
+        generateLR0State(ctx, nextunit.sid);
     }
 }
 
 // 生成LR0入口
-void getLR0()
+void getLR0(grammarContext& ctx)
 {
-    visitedStates.clear();
+    ctx.visitedStates.clear();
 
     // 首先生成第一个状态
-    createFirstState();
+    createFirstState(ctx);
 
     // 递归生成其他状态
-    generateLR0State(0);
+    generateLR0State(ctx, 0);
 }
 
 // 拼接字符串，获取状态内的文法
-string getStateGrammar(const dfaState& d)
+string getStateGrammar(const grammarContext& ctx, const dfaState& d)
 {
-    string result = "";
-    for (auto cell : d.cellV)
+    string result;
+    for (int cell : d.cellV)
     {
-        const dfaCell& dfaCell = dfaCellVector[cell];
+        const dfaCell& dfaCell = ctx.dfaCellVector[cell];
         // 拿到文法
-        int gid = dfaCell.gid;
-        grammarUnit g = grammarDeque[gid];
+        const grammarUnit& g = ctx.grammarDeque[dfaCell.gid];
         // 拿到位置
         int i = dfaCell.index;
-        // 拼接结果
-        string r = "";
-        r += g.left == '^' ? "E\'->" : string(1, g.left) + "->";
-        string right = g.right == "@" ? "" : g.right;
-        right.insert(i, 1, '.');
-        r += right;
-        result += r + " ";
+        // 直接拼接到结果上，不生成中间字符串
+        if (g.left == '^') result += "E\'";
+        else result += g.left;
+        result += "->";
+        if (g.right != "@")
+        {
+            result.append(g.right, 0, i);
+            result += '.';
+            result.append(g.right, i, string::npos);
+        }
+        else result += '.';
+        result += ' ';
     }
     return result;
 }
 
 /******************** SLR1分析 ***************************/
-// 检查移进-规约冲突
-bool SLR1Fun1()
+
+// 产生式的优先级：%prec指定的，否则是右部最后一个有优先级的终结符，0表示没有
+int productionPrecedence(const grammarContext& ctx, int gid)
 {
-    for (const dfaState& state : dfaStateVector)
+    const grammarUnit& g = ctx.grammarDeque[gid];
+    if (g.prec != 0)
     {
-        // 规约项目的左边集合
-        set<char> a;
-        // 终结符
-        set<char> rVT;
-        // 不是规约状态不考虑
-        if (!state.isEnd) continue;
-        // 规约状态
-        for (int cellid : state.cellV)
-        {
-            // 拿到这个cell
-            const dfaCell& cell = dfaCellVector[cellid];
-            // 获取文法
-            const grammarUnit gm = grammarDeque[cell.gid];
-            // 判断是不是规约项目
-            if (cell.index == gm.right.length() || gm.right == "@")
-            {
-                a.insert(gm.left);
-            }
-            // 判断是不是终结符
-            else
-            {
-                if (isSmallAlpha(gm.right[cell.index]))
-                {
-                    rVT.insert(gm.right[cell.index]);
-                }
-            }
-        }
-        for (char c : a)
-        {
-            for (char v : rVT)
-            {
-                if (followSets[c].s.find(v) != followSets[c].s.end())
-                {
-                    return true;
-                }
-
-            }
-        }
+        auto it = ctx.precedenceMap.find(g.prec);
+        return it == ctx.precedenceMap.end() ? 0 : it->second.level;
     }
-    return false;
+    for (int k = g.right.length() - 1; k >= 0; --k)
+    {
+        auto it = ctx.precedenceMap.find(g.right[k]);
+        if (it != ctx.precedenceMap.end()) return it->second.level;
+    }
+    return 0;
 }
 
-bool SLR1Fun2()
+// 产生式和终结符都声明了优先级，则移进-归约冲突可以解决
+bool precedenceResolves(const grammarContext& ctx, int gid, char c)
 {
-    // 检查规约-规约冲突
-    for (const auto& state : dfaStateVector)
-    {
-        // 规约项目的左边集合
-        set<char> a;
-        // 不是规约状态不考虑
-        if (!state.isEnd) continue;
+    return productionPrecedence(ctx, gid) != 0 && ctx.precedenceMap.count(c) > 0;
+}
 
-        // 规约状态
-        for (int cellid : state.cellV)
-        {
-            // 拿到这个cell
-            const dfaCell& cell = dfaCellVector[cellid];
-            // 获取文法
-            const grammarUnit gm = grammarDeque[cell.gid];
-            // 判断是不是规约项目
-            if (cell.index == gm.right.length() || gm.right == "@")
-            {
-                a.insert(gm.left);
-            }
-        }
+// 归约项目的动作字符串
+string reduceAction(const grammarContext& ctx, const grammarUnit& gm)
+{
+    return gm.left == ctx.trueStartSymbol ? "ACCEPT" : "r(" + string(1, gm.left) + "->" + gm.right + ")";
+}
 
-        for (char c1 : a)
-        {
-            for (char c2 : a)
-            {
-                if (c1 != c2)
-                {
-                    // 判断followSets[c1]和followSets[c2]是否有交集
-                    set<char> followSetC1 = followSets[c1].s;
-                    set<char> followSetC2 = followSets[c2].s;
-                    set<char> intersection;
-
-                    // 利用STL算法求交集
-                    set_intersection(
-                        followSetC1.begin(), followSetC1.end(),
-                        followSetC2.begin(), followSetC2.end(),
-                        inserter(intersection, intersection.begin())
-                    );
-
-                    // 如果交集非空，说明存在规约-规约冲突
-                    if (!intersection.empty())
-                    {
-                        return true;
+// 移进-归约冲突按%left等声明解决，供slr1::fillReduce调用
+struct precedenceResolver
+{
+    grammarContext& ctx;
+
+    int operator()(int gid, char c, int shift) const
+    {
+        if (!precedenceResolves(ctx, gid, c)) return slr1::unresolved;
+        // 产生式优先级高则归约，终结符优先级高则移进，相同时看结合性
+        int pp = productionPrecedence(ctx, gid);
+        const precUnit& tp = ctx.precedenceMap[c];
+        ++ctx.precResolvedCount;
+        if (pp > tp.level || (pp == tp.level && tp.assoc == assocLeft)) return -gid - 1;
+        if (pp == tp.level && tp.assoc == assocNonassoc) return 0;
+        return shift;
+    }
+};
+
+template <class Chars>
+slr1::charSet toCharSet(const Chars& chars)
+{
+    slr1::charSet s;
+    for (char c : chars) s.set(c);
+    return s;
+}
+
+// 填一行动作：移进和goto来自转移，归约由slr1::fillReduce按向前看符号填，和编译期分析表的填法、冲突判定相同
+// reduces为(文法编号, 向前看符号)，SLR1/LALR1/LR1只是向前看符号不同
+// 返回没有用优先级解决的冲突个数，kinds按位记录冲突种类（1移进-归约，2归约-归约）
+int fillActionRow(grammarContext& ctx, const vector<nextStateUnit>& nextStates, const vector<pair<int, slr1::charSet>>& reduces,
+    SLRUnit& slrunit, int* kinds)
+{
+    int row[256] = {};
+    for (const auto& next : nextStates)
+    {
+        if (isBigAlpha(next.c)) slrunit.m[next.c] = to_string(next.sid);
+        else row[(unsigned char)next.c] = next.sid + 1;
+    }
+    int conflicts = 0;
+    for (const auto& r : reduces)
+    {
+        int acceptGid = ctx.grammarDeque[r.first].left == ctx.trueStartSymbol ? r.first : -1;
+        conflicts += slr1::fillReduce(row, r.first, acceptGid, r.second, precedenceResolver{ ctx }, kinds);
+    }
+    for (int c = 0; c < 256; ++c)
+    {
+        int a = row[c];
+        if (a == 0) continue;
+        if (a == slr1::acceptAction) slrunit.m[(char)c] = "ACCEPT";
+        else if (a > 0) slrunit.m[(char)c] = "s" + to_string(a - 1);
+        else slrunit.m[(char)c] = reduceAction(ctx, ctx.grammarDeque[-a - 1]);
+    }
+    return conflicts;
+}
+
+// 填一个状态的SLR(1)动作，返回值和kinds同fillActionRow
+int fillSLRRow(grammarContext& ctx, const dfaState& ds, SLRUnit& slrunit, int* kinds = nullptr)
+{
+    // 如果是归约，follow集合每个元素都能归约
+    vector<pair<int, slr1::charSet>> reduces;
+    if (ds.isEnd)
+    {
+        for (int cellid : ds.cellV)
+        {
+            // 拿到这个cell
+            const dfaCell& cell = ctx.dfaCellVector[cellid];
+            // 获取文法
+            const grammarUnit& gm = ctx.grammarDeque[cell.gid];
+            // 判断是不是规约项目
+            if (cell.index == rightLength(gm)) reduces.push_back(make_pair(cell.gid, toCharSet(ctx.followSets[gm.left].s)));
+        }
+    }
+    return fillActionRow(ctx, ds.nextStateVector, reduces, slrunit, kinds);
+}
+
+// SLR1分析表（必须先调用getLR0），返回0没有冲突，1有移进-归约冲突，2有归约-归约冲突，3两种都有
+// 冲突按填表时实际遇到的判断，有冲突时不留下分析表
+int getSLR1Table(grammarContext& ctx)
+{
+    ctx.precResolvedCount = 0;
+    // 开始符号添加follow集合
+    ctx.followSets['^'].s.insert('$');
+    int kinds = 0;
+    for (const dfaState& ds : ctx.dfaStateVector)
+    {
+        SLRUnit slrunit = SLRUnit();
+        fillSLRRow(ctx, ds, slrunit, &kinds);
+        ctx.SLRVector.push_back(slrunit);
+    }
+    if (kinds != 0) ctx.SLRVector.clear();
+    return kinds;
+}
+
+/******************** LALR(1)分析 ***************************/
+// 在getLR0得到的LR(0)自动机上，用DeRemer-Pennello关系图算法求向前看符号，状态数与LR(0)相同
+
+// 是否为可空非终结符
+bool isNullable(const grammarContext& ctx, char c)
+{
+    if (!isBigAlpha(c)) return false;
+    auto it = ctx.firstSets.find(c);
+    return it != ctx.firstSets.end() && it->second.isEpsilon;
+}
+
+// 按左部整理文法编号
+map<char, vector<int>> getLeftToGid(const grammarContext& ctx)
+{
+    map<char, vector<int>> leftToGid;
+    for (const auto& g : ctx.grammarDeque)
+    {
+        leftToGid[g.left].push_back(g.gid);
+    }
+    return leftToGid;
+}
+
+// 求状态stateId经过字符c到达的状态，没有则返回-1
+int gotoState(const grammarContext& ctx, int stateId, char c)
+{
+    for (const auto& next : ctx.dfaStateVector[stateId].nextStateVector)
+    {
+        if (next.c == c) return next.sid;
+    }
+    return -1;
+}
+
+// 关系图算法的递归部分
+void traverseDigraph(int x, const vector<vector<int>>& R, vector<set<char>>& F, vector<int>& N, vector<int>& S)
+{
+    S.push_back(x);
+    int d = S.size();
+    N[x] = d;
+    for (int y : R[x])
+    {
+        if (N[y] == 0) traverseDigraph(y, R, F, N, S);
+        N[x] = min(N[x], N[y]);
+        F[x].insert(F[y].begin(), F[y].end());
+    }
+    // x是强连通分量的根，分量内所有点的集合相同
+    if (N[x] == d)
+    {
+        int top;
+        do
+        {
+            top = S.back();
+            S.pop_back();
+            N[top] = numeric_limits<int>::max();
+            if (top != x) F[top] = F[x];
+        } while (top != x);
+    }
+}
+
+// 关系图算法：F(x) = F'(x) ∪ { F(y) | x R y }，每条边只走一次
+void digraph(const vector<vector<int>>& R, vector<set<char>>& F)
+{
+    vector<int> N(F.size(), 0);
+    vector<int> S;
+    for (int x = 0; x < (int)F.size(); ++x)
+    {
+        if (N[x] == 0) traverseDigraph(x, R, F, N, S);
+    }
+}
+
+// 计算LALR1向前看符号（必须先调用getFirstSets和getLR0）
+void getLALR1Lookahead(grammarContext& ctx)
+{
+    // 收集非终结符转移
+    for (const dfaState& ds : ctx.dfaStateVector)
+    {
+        for (const auto& next : ds.nextStateVector)
+        {
+            if (isBigAlpha(next.c))
+            {
+                ctx.ntTransToInt[make_pair(ds.sid, next.c)] = ctx.ntTransVector.size();
+                ctx.ntTransVector.push_back({ ds.sid, next.c, next.sid });
+            }
+        }
+    }
+    // 开始符号没有真实转移，补一个虚拟转移，它的Follow就是$
+    if (ctx.ntTransToInt.find(make_pair(0, ctx.trueStartSymbol)) == ctx.ntTransToInt.end())
+    {
+        ctx.ntTransToInt[make_pair(0, ctx.trueStartSymbol)] = ctx.ntTransVector.size();
+        ctx.ntTransVector.push_back({ 0, ctx.trueStartSymbol, -1 });
+    }
+
+    int n = ctx.ntTransVector.size();
+    vector<set<char>> F(n);
+    vector<vector<int>> reads(n), includes(n);
+
+    // DR集合与reads关系
+    for (int i = 0; i < n; ++i)
+    {
+        const ntTransUnit& t = ctx.ntTransVector[i];
+        if (t.sid == 0 && t.c == ctx.trueStartSymbol) F[i].insert('$');
+        if (t.to == -1) continue;
+        for (const auto& next : ctx.dfaStateVector[t.to].nextStateVector)
+        {
+            if (isSmallAlpha(next.c)) F[i].insert(next.c);
+            else if (isNullable(ctx, next.c)) reads[i].push_back(ctx.ntTransToInt[make_pair(t.to, next.c)]);
+        }
+    }
+    digraph(reads, F);
+
+    map<char, vector<int>> leftToGid = getLeftToGid(ctx);
+
+    // includes与lookback关系
+    map<pair<int, int>, vector<int>> lookback;
+    for (int i = 0; i < n; ++i)
+    {
+        const ntTransUnit& t = ctx.ntTransVector[i];
+        for (int gid : leftToGid[t.c])
+        {
+            const grammarUnit& g = ctx.grammarDeque[gid];
+            int len = rightLength(g);
+            int q = t.sid;
+            for (int k = 0; k < len && q != -1; ++k)
+            {
+                char x = g.right[k];
+                if (isBigAlpha(x))
+                {
+                    // 后面全部可空，则(q, x) includes (p, A)
+                    int j = k + 1;
+                    while (j < len && isNullable(ctx, g.right[j])) ++j;
+                    if (j == len) includes[ctx.ntTransToInt[make_pair(q, x)]].push_back(i);
+                }
+                q = gotoState(ctx, q, x);
+            }
+            if (q != -1) lookback[make_pair(q, gid)].push_back(i);
+        }
+    }
+    digraph(includes, F);
+
+    // 向前看符号为lookback中所有转移Follow的并集
+    for (const auto& lb : lookback)
+    {
+        set<char>& la = ctx.lalrLookahead[lb.first];
+        for (int i : lb.second)
+        {
+            la.insert(F[i].begin(), F[i].end());
+        }
+    }
+}
+
+// LALR1分析表，返回值含义与getSLR1Table相同
+int getLALR1Table(grammarContext& ctx)
+{
+    ctx.precResolvedCount = 0;
+    getLALR1Lookahead(ctx);
+    int kinds = 0;
+    for (const dfaState& ds : ctx.dfaStateVector)
+    {
+        SLRUnit slrunit = SLRUnit();
+        // 按向前看符号填归约
+        vector<pair<int, slr1::charSet>> reduces;
+        for (int cellid : ds.cellV)
+        {
+            const dfaCell& cell = ctx.dfaCellVector[cellid];
+            if (cell.index != rightLength(ctx.grammarDeque[cell.gid])) continue;
+            reduces.push_back(make_pair(cell.gid, toCharSet(ctx.lalrLookahead[make_pair(ds.sid, cell.gid)])));
+        }
+        fillActionRow(ctx, ds.nextStateVector, reduces, slrunit, &kinds);
+        ctx.LALRVector.push_back(slrunit);
+    }
+    return kinds;
+}
+
+/******************** 最小LR(1)分析 ***************************/
+// 按Pager的弱相容判定在构造过程中合并LR(1)状态，分析能力与规范LR(1)相同，状态数接近LALR(1)
+
+// 规范LR1状态数上限，超过就不再继续构造（只用于对比，合并构造的状态数接近LALR1，不设上限）
+const size_t canonicalLR1Limit = 20000;
+
+// 求right[from..]的First集合，全部可空时并上tail
+void firstOfString(grammarContext& ctx, const string& right, int from, const set<char>& tail, set<char>& out)
+{
+    int len = right == "@" ? 0 : right.length();
+    for (int k = from; k < len; ++k)
+    {
+        char c = right[k];
+        if (isSmallAlpha(c))
+        {
+            out.insert(c);
+            return;
+        }
+        const set<char>& f = ctx.firstSets[c].s;
+        out.insert(f.begin(), f.end());
+        if (!isNullable(ctx, c)) return;
+    }
+    out.insert(tail.begin(), tail.end());
+}
+
+// LR1闭包
+lr1Items closureLR1(grammarContext& ctx, const lr1Items& kernel, const map<char, vector<int>>& leftToGid)
+{
+    lr1Items items = kernel;
+    queue<pair<int, int>> q;
+    for (const auto& item : kernel) q.push(item.first);
+    while (!q.empty())
+    {
+        pair<int, int> key = q.front();
+        q.pop();
+        const grammarUnit& g = ctx.grammarDeque[key.first];
+        if (key.second == rightLength(g) || !isBigAlpha(g.right[key.second])) continue;
+        auto it = leftToGid.find(g.right[key.second]);
+        if (it == leftToGid.end()) continue;
+
+        set<char> la;
+        firstOfString(ctx, g.right, key.second + 1, items[key], la);
+        for (int gid : it->second)
+        {
+            set<char>& target = items[make_pair(gid, 0)];
+            size_t before = target.size();
+            target.insert(la.begin(), la.end());
+            // 向前看符号有变化，需要继续传播
+            if (target.size() != before) q.push(make_pair(gid, 0));
+        }
+    }
+    return items;
+}
+
+// Pager弱相容：任意两个项目i、j，交叉的向前看不相交，或者某一方自身已经相交
+bool weakCompatible(const lr1Items& k1, const lr1Items& k2)
+{
+    vector<const set<char>*> l1, l2;
+    for (const auto& item : k1) l1.push_back(&item.second);
+    for (const auto& item : k2) l2.push_back(&item.second);
+    auto intersect = [](const set<char>& a, const set<char>& b)
+    {
+        for (char c : a)
+        {
+            if (b.count(c)) return true;
+        }
+        return false;
+    };
+    for (size_t i = 0; i < l1.size(); ++i)
+    {
+        for (size_t j = i + 1; j < l1.size(); ++j)
+        {
+            if (!intersect(*l1[i], *l2[j]) && !intersect(*l1[j], *l2[i])) continue;
+            if (intersect(*l1[i], *l1[j]) || intersect(*l2[i], *l2[j])) continue;
+            return false;
+        }
+    }
+    return true;
+}
+
+// 去掉从状态0走不到的状态，其余的按原来的顺序重新编号
+void removeUnreachableLR1States(vector<lr1State>& states)
+{
+    vector<int> newId(states.size(), -1);
+    vector<int> work(1, 0);
+    newId[0] = 0;
+    while (!work.empty())
+    {
+        int s = work.back();
+        work.pop_back();
+        for (const auto& next : states[s].nextStateVector)
+        {
+            if (newId[next.sid] != -1) continue;
+            newId[next.sid] = 0;
+            work.push_back(next.sid);
+        }
+    }
+    int count = 0;
+    for (size_t s = 0; s < states.size(); ++s)
+    {
+        if (newId[s] != -1) newId[s] = count++;
+    }
+    if (count == (int)states.size()) return;
+    vector<lr1State> kept;
+    kept.reserve(count);
+    for (size_t s = 0; s < states.size(); ++s)
+    {
+        if (newId[s] == -1) continue;
+        kept.push_back(move(states[s]));
+        kept.back().sid = newId[s];
+        for (auto& next : kept.back().nextStateVector) next.sid = newId[next.sid];
+    }
+    states = move(kept);
+}
+
+// 构造LR1状态，merge为false时是规范LR1，超过上限返回false；merge为true时总是构造完
+bool buildLR1States(grammarContext& ctx, vector<lr1State>& states, bool merge)
+{
+    map<char, vector<int>> leftToGid = getLeftToGid(ctx);
+    // 核心相同的状态
+    map<vector<pair<int, int>>, vector<int>> coreToSid;
+    queue<int> work;
+    vector<bool> inQueue;
+
+    // 查找可以合并的状态，没有就新建
+    auto findOrAdd = [&](const lr1Items& k) -> int
+    {
+        vector<pair<int, int>> core;
+        for (const auto& item : k) core.push_back(item.first);
+        vector<int>& same = coreToSid[core];
+        for (int t : same)
+        {
+            if (states[t].kernel == k) return t;
+        }
+        if (merge)
+        {
+            for (int t : same)
+            {
+                if (!weakCompatible(states[t].kernel, k)) continue;
+                bool grew = false;
+                for (const auto& item : k)
+                {
+                    set<char>& la = states[t].kernel[item.first];
+                    size_t before = la.size();
+                    la.insert(item.second.begin(), item.second.end());
+                    if (la.size() != before) grew = true;
+                }
+                // 向前看变大了，后继状态要重新传播
+                if (grew && !inQueue[t])
+                {
+                    inQueue[t] = true;
+                    work.push(t);
+                }
+                return t;
+            }
+        }
+        lr1State ns = lr1State();
+        ns.sid = states.size();
+        ns.kernel = k;
+        states.push_back(ns);
+        inQueue.push_back(true);
+        work.push(ns.sid);
+        same.push_back(ns.sid);
+        return ns.sid;
+    };
+
+    lr1Items start;
+    start[make_pair(0, 0)].insert('$');
+    findOrAdd(start);
+
+    while (!work.empty())
+    {
+        if (!merge && states.size() > canonicalLR1Limit) return false;
+        int s = work.front();
+        work.pop();
+        inQueue[s] = false;
+
+        lr1Items items = closureLR1(ctx, states[s].kernel, leftToGid);
+        lr1Items reduceItems;
+        map<char, lr1Items> gotoKernels;
+        for (const auto& item : items)
+        {
+            const grammarUnit& g = ctx.grammarDeque[item.first.first];
+            if (item.first.second == rightLength(g))
+            {
+                reduceItems[item.first] = item.second;
+                continue;
+            }
+            lr1Items& k = gotoKernels[g.right[item.first.second]];
+            set<char>& la = k[make_pair(item.first.first, item.first.second + 1)];
+            la.insert(item.second.begin(), item.second.end());
+        }
+
+        vector<nextStateUnit> nextStateVector;
+        for (const auto& gk : gotoKernels)
+        {
+            nextStateUnit n = nextStateUnit();
+            n.c = gk.first;
+            n.sid = findOrAdd(gk.second);
+            nextStateVector.push_back(n);
+        }
+        states[s].reduceItems = reduceItems;
+        states[s].nextStateVector = nextStateVector;
+    }
+    // 合并后重新传播的状态可能换了后继，原来的后继没有别的入口就成了孤立状态
+    if (merge) removeUnreachableLR1States(states);
+    return true;
+}
+
+// LR1状态占用的内存（字节，估算）
+size_t lr1Memory(const vector<lr1State>& states)
+{
+    size_t bytes = 0;
+    for (const lr1State& st : states)
+    {
+        bytes += sizeof(lr1State) + st.nextStateVector.size() * sizeof(nextStateUnit);
+        for (const auto& item : st.kernel) bytes += sizeof(item) + item.second.size();
+        for (const auto& item : st.reduceItems) bytes += sizeof(item) + item.second.size();
+    }
+    return bytes;
+}
+
+// 最小LR1分析表，返回值含义与getSLR1Table相同
+int getLR1Table(grammarContext& ctx)
+{
+    ctx.precResolvedCount = 0;
+    buildLR1States(ctx, ctx.lr1StateVector, true);
+    int kinds = 0;
+    for (const lr1State& st : ctx.lr1StateVector)
+    {
+        SLRUnit slrunit = SLRUnit();
+        vector<pair<int, slr1::charSet>> reduces;
+        for (const auto& item : st.reduceItems) reduces.push_back(make_pair(item.first.first, toCharSet(item.second)));
+        fillActionRow(ctx, st.nextStateVector, reduces, slrunit, &kinds);
+        ctx.LR1Vector.push_back(slrunit);
+    }
+    return kinds;
+}
+
+/******************** 词法分析 ***************************/
+// 正则表达式 -> Thompson NFA -> 子集构造DFA -> 最小化，生成表驱动的词法分析器
+// 最长匹配和优先级在生成时就定好：每个DFA状态只记录一个接受的单词
+
+// NFA状态：要么经过chars中的字符到charTo，要么经过空边到eps中的状态
+struct nfaState
+{
+    bitset<256> chars;
+    int charTo = -1;
+    vector<int> eps;
+    int token = -1; // 接受的单词（tokenDefs下标）
+};
+
+// NFA片段
+struct nfaFragment
+{
+    int start;
+    int end;
+};
+
+// 正则表达式解析，递归下降直接生成NFA片段
+// 支持 | * + ? () [] [^] . 和 \转义（\d \w \s \t \n 及其他字符本身）
+struct regexCompiler
+{
+    vector<nfaState>& states;
+    const string& re;
+    size_t pos = 0;
+    string error;
+
+    regexCompiler(vector<nfaState>& states, const string& re) : states(states), re(re) {}
+
+    int newState()
+    {
+        states.push_back(nfaState());
+        return states.size() - 1;
+    }
+
+    nfaFragment charFragment(const bitset<256>& chars)
+    {
+        nfaFragment f = { newState(), newState() };
+        states[f.start].chars = chars;
+        states[f.start].charTo = f.end;
+        return f;
+    }
+
+    nfaFragment emptyFragment()
+    {
+        nfaFragment f = { newState(), newState() };
+        states[f.start].eps.push_back(f.end);
+        return f;
+    }
+
+    // \d \w \s等转义对应的字符集合
+    bitset<256> escapeSet(char c)
+    {
+        bitset<256> set;
+        if (c == 'd' || c == 'w')
+        {
+            for (int x = '0'; x <= '9'; ++x) set.set(x);
+        }
+        if (c == 'w')
+        {
+            for (int x = 'a'; x <= 'z'; ++x) set.set(x);
+            for (int x = 'A'; x <= 'Z'; ++x) set.set(x);
+            set.set('_');
+        }
+        if (c == 's')
+        {
+            for (char x : string(" \t\n\v\f\r")) set.set(x);
+        }
+        if (set.none()) set.set((unsigned char)(c == 't' ? '\t' : c == 'n' ? '\n' : c == 'r' ? '\r' : c));
+        return set;
+    }
+
+    bitset<256> parseClass()
+    {
+        bitset<256> set;
+        bool negate = pos < re.length() && re[pos] == '^';
+        if (negate) ++pos;
+        bool first = true;
+        while (pos < re.length() && (re[pos] != ']' || first))
+        {
+            first = false;
+            unsigned char lo = re[pos++];
+            if (lo == '\\' && pos < re.length())
+            {
+                bitset<256> e = escapeSet(re[pos++]);
+                if (e.count() > 1)
+                {
+                    set |= e;
+                    continue;
+                }
+                for (int x = 0; x < 256; ++x) if (e.test(x)) lo = x;
+            }
+            unsigned char hi = lo;
+            if (pos + 1 < re.length() && re[pos] == '-' && re[pos + 1] != ']')
+            {
+                hi = re[pos + 1];
+                pos += 2;
+                if (hi == '\\' && pos < re.length()) hi = re[pos++];
+            }
+            for (int x = lo; x <= hi; ++x) set.set(x);
+        }
+        if (pos >= re.length())
+        {
+            error = "缺少]";
+            return set;
+        }
+        ++pos;
+        if (negate) set.flip();
+        return set;
+    }
+
+    nfaFragment parseAtom()
+    {
+        char c = re[pos++];
+        if (c == '(')
+        {
+            nfaFragment f = parseAlternation();
+            if (pos >= re.length() || re[pos] != ')') error = "括号不匹配";
+            else ++pos;
+            return f;
+        }
+        if (c == '[') return charFragment(parseClass());
+        if (c == '.')
+        {
+            bitset<256> set;
+            set.set();
+            set.reset('\n');
+            return charFragment(set);
+        }
+        if (c == '\\')
+        {
+            if (pos >= re.length())
+            {
+                error = "\\后面缺少字符";
+                return emptyFragment();
+            }
+            return charFragment(escapeSet(re[pos++]));
+        }
+        if (c == '*' || c == '+' || c == '?' || c == ')')
+        {
+            error = string("位置") + to_string(pos) + "的" + c + "前面缺少内容";
+            return emptyFragment();
+        }
+        bitset<256> set;
+        set.set((unsigned char)c);
+        return charFragment(set);
+    }
+
+    nfaFragment parseRepeat()
+    {
+        nfaFragment f = parseAtom();
+        while (pos < re.length() && (re[pos] == '*' || re[pos] == '+' || re[pos] == '?'))
+        {
+            char op = re[pos++];
+            nfaFragment g = { newState(), newState() };
+            states[g.start].eps.push_back(f.start);
+            if (op != '+') states[g.start].eps.push_back(g.end);
+            states[f.end].eps.push_back(g.end);
+            if (op != '?') states[f.end].eps.push_back(f.start);
+            f = g;
+        }
+        return f;
+    }
+
+    nfaFragment parseConcat()
+    {
+        if (pos >= re.length() || re[pos] == '|' || re[pos] == ')') return emptyFragment();
+        nfaFragment f = parseRepeat();
+        while (error.empty() && pos < re.length() && re[pos] != '|' && re[pos] != ')')
+        {
+            nfaFragment g = parseRepeat();
+            states[f.end].eps.push_back(g.start);
+            f.end = g.end;
+        }
+        return f;
+    }
+
+    nfaFragment parseAlternation()
+    {
+        nfaFragment f = parseConcat();
+        while (error.empty() && pos < re.length() && re[pos] == '|')
+        {
+            ++pos;
+            nfaFragment g = parseConcat();
+            nfaFragment h = { newState(), newState() };
+            states[h.start].eps.push_back(f.start);
+            states[h.start].eps.push_back(g.start);
+            states[f.end].eps.push_back(h.end);
+            states[g.end].eps.push_back(h.end);
+            f = h;
+        }
+        return f;
+    }
+
+    bool compile(nfaFragment& f)
+    {
+        f = parseAlternation();
+        if (error.empty() && pos < re.length()) error = "多余的)";
+        return error.empty();
+    }
+};
+
+// 根据单词声明生成词法分析器，出错时返回false
+bool buildLexer(const vector<tokenDef>& defs, lexerTable& lexer, string& error)
+{
+    // 所有单词的NFA从一个公共开始状态用空边连起来
+    vector<nfaState> states(1);
+    for (size_t i = 0; i < defs.size(); ++i)
+    {
+        regexCompiler rc(states, defs[i].regex);
+        nfaFragment f;
+        if (!rc.compile(f))
+        {
+            error = (defs[i].symbol ? string(1, defs[i].symbol) : string("%skip")) + "的正则表达式" + defs[i].regex + "：" + rc.error;
+            return false;
+        }
+        states[0].eps.push_back(f.start);
+        states[f.end].token = i;
+    }
+
+    // 字符等价类：被所有字符集合区分不开的字符归为一类
+    vector<const bitset<256>*> sets;
+    for (const auto& st : states)
+    {
+        if (st.charTo != -1) sets.push_back(&st.chars);
+    }
+    map<vector<bool>, int> classOf;
+    for (int c = 0; c < 256; ++c)
+    {
+        vector<bool> key(sets.size());
+        for (size_t i = 0; i < sets.size(); ++i) key[i] = sets[i]->test(c);
+        auto it = classOf.find(key);
+        if (it == classOf.end()) it = classOf.insert(make_pair(key, (int)classOf.size())).first;
+        lexer.charClass[c] = it->second;
+    }
+    int classCount = classOf.size();
+    vector<int> representative(classCount);
+    for (int c = 255; c >= 0; --c) representative[lexer.charClass[c]] = c;
+
+    // 子集构造，DFA状态0为空集（死状态）
+    auto closure = [&](vector<int> set)
+    {
+        vector<bool> in(states.size());
+        vector<int> st = set;
+        for (int x : set) in[x] = true;
+        while (!st.empty())
+        {
+            int x = st.back();
+            st.pop_back();
+            for (int y : states[x].eps)
+            {
+                if (in[y]) continue;
+                in[y] = true;
+                set.push_back(y);
+                st.push_back(y);
+            }
+        }
+        sort(set.begin(), set.end());
+        return set;
+    };
+    vector<vector<int>> dfaSets(1);
+    map<vector<int>, int> dfaIndex;
+    dfaIndex[vector<int>()] = 0;
+    dfaSets.push_back(closure(vector<int>(1, 0)));
+    dfaIndex[dfaSets[1]] = 1;
+    vector<int> dfaNext(2 * classCount, 0);
+    for (size_t d = 1; d < dfaSets.size(); ++d)
+    {
+        for (int k = 0; k < classCount; ++k)
+        {
+            vector<int> moved;
+            for (int x : dfaSets[d])
+            {
+                if (states[x].charTo != -1 && states[x].chars.test(representative[k])) moved.push_back(states[x].charTo);
+            }
+            if (moved.empty()) continue;
+            vector<int> target = closure(moved);
+            auto it = dfaIndex.find(target);
+            if (it == dfaIndex.end())
+            {
+                it = dfaIndex.insert(make_pair(target, (int)dfaSets.size())).first;
+                dfaSets.push_back(target);
+                dfaNext.resize(dfaSets.size() * classCount, 0);
+            }
+            dfaNext[d * classCount + k] = it->second;
+        }
+    }
+    // 每个DFA状态接受先声明的单词
+    int dfaCount = dfaSets.size();
+    vector<int> dfaToken(dfaCount, -1);
+    for (int d = 0; d < dfaCount; ++d)
+    {
+        for (int x : dfaSets[d])
+        {
+            if (states[x].token != -1 && (dfaToken[d] == -1 || states[x].token < dfaToken[d])) dfaToken[d] = states[x].token;
+        }
+    }
+
+    // 最小化：先按接受的单词划分，再按转移所到的划分反复细分，直到划分数不再变化
+    vector<int> part(dfaCount);
+    for (int d = 0; d < dfaCount; ++d)
+    {
+        // 同一终结符的不同声明接受的是同一个单词，可以合并
+        part[d] = dfaToken[d] == -1 ? 0 : defs[dfaToken[d]].symbol ? (unsigned char)defs[dfaToken[d]].symbol + 1 : 1;
+    }
+    int partCount = 0;
+    while (true)
+    {
+        map<vector<int>, int> signature;
+        vector<int> refined(dfaCount);
+        for (int d = 0; d < dfaCount; ++d)
+        {
+            vector<int> key(1, part[d]);
+            for (int k = 0; k < classCount; ++k) key.push_back(part[dfaNext[d * classCount + k]]);
+            auto it = signature.find(key);
+            if (it == signature.end()) it = signature.insert(make_pair(key, (int)signature.size())).first;
+            refined[d] = it->second;
+        }
+        part = refined;
+        if ((int)signature.size() == partCount) break;
+        partCount = signature.size();
+    }
+
+    // 死状态所在划分编为0，开始状态所在划分编为1
+    vector<int> newId(partCount, -1);
+    newId[part[0]] = 0;
+    if (part[1] == part[0])
+    {
+        error = "所有单词都匹配不到任何输入";
+        return false;
+    }
+    int count = 1;
+    if (newId[part[1]] == -1) newId[part[1]] = count++;
+    for (int d = 2; d < dfaCount; ++d)
+    {
+        if (newId[part[d]] == -1) newId[part[d]] = count++;
+    }
+    lexer.stateCount = count;
+    lexer.classCount = classCount;
+    lexer.next.assign(count * classCount, 0);
+    lexer.accept.assign(count, 0);
+    for (int d = 0; d < dfaCount; ++d)
+    {
+        int s = newId[part[d]];
+        for (int k = 0; k < classCount; ++k) lexer.next.edit(s * classCount + k) = newId[part[dfaNext[d * classCount + k]]];
+        if (dfaToken[d] != -1) lexer.accept.edit(s) = defs[dfaToken[d]].symbol ? defs[dfaToken[d]].symbol : -1;
+    }
+    lexer.nfaCount = states.size();
+    lexer.dfaCount = dfaCount;
+    return true;
+}
+
+// 用handleGrammar读到的单词声明生成词法分析器
+// 文法中用到但没有声明的终结符按字面匹配自身，优先级在所有声明之后；没有%skip时跳过空白
+void buildGrammarLexer(grammarContext& ctx)
+{
+    vector<tokenDef> defs = ctx.tokenDefs;
+    set<char> declared;
+    bool hasSkip = false;
+    for (const auto& d : ctx.tokenDefs)
+    {
+        if (d.symbol) declared.insert(d.symbol);
+        else hasSkip = true;
+    }
+    set<char> literal;
+    for (const auto& g : ctx.grammarDeque)
+    {
+        for (char c : g.right)
+        {
+            if (isSmallAlpha(c) && c != '$' && c != ctx.errorSymbol && !declared.count(c)) literal.insert(c);
+        }
+    }
+    for (char c : literal) defs.push_back({ c, "[" + string(c == '^' || c == ']' || c == '\\' ? "\\" : "") + c + "]" });
+    if (!hasSkip) defs.push_back({ 0, "\\s+" });
+
+    string error;
+    if (!buildLexer(defs, ctx.grammarLexer, error))
+    {
+        ctx.grammarLexer = lexerTable();
+        grammarError(ctx, "词法定义错误：" + error);
+    }
+}
+
+// 用词法分析器把句子切成单词，每个单词写成对应的终结符
+// 返回第一个无法识别的位置（单词下标），都能识别时返回-1；无法识别的字符写成0x7f，交给语法分析报错
+int lexSentence(const lexerTable& lexer, const string& sentence, string& out)
+{
+    out.clear();
+    const unsigned char* s = (const unsigned char*)sentence.data();
+    size_t n = sentence.length();
+    const int* next = lexer.next.data();
+    const int* accept = lexer.accept.data();
+    int classCount = lexer.classCount, stateCount = lexer.stateCount;
+    int bad = -1;
+    size_t i = 0;
+    while (i < n)
+    {
+        // 一直走到死状态，记下最后一次接受的位置（最长匹配）
+        int state = 1, token = 0;
+        size_t end = i;
+        for (size_t p = i; p < n; ++p)
+        {
+            state = next[state * classCount + lexer.charClass[s[p]]];
+            // 分析表文件载入时不逐项检查，越界的状态和死状态一样
+            if (state <= 0 || state >= stateCount) break;
+            int a = accept[state];
+            token = a != 0 ? a : token;
+            end = a != 0 ? p + 1 : end;
+        }
+        if (end == i)
+        {
+            if (bad < 0) bad = out.length();
+            out += '\x7f';
+            ++i;
+            continue;
+        }
+        if (token != -1) out += (char)token;
+        i = end;
+    }
+    return bad;
+}
+
+
+/******************** 输入预处理 ***************************/
+// 终结符都是单个ASCII字符，所以任意一个ASCII字符集合都能用两张16项的表表示：
+// 低4位表第l项的第h位表示字符h*16+l在集合中，高4位表第h项为1<<h（h>=8即非ASCII，为0）
+// 用pshufb查两张表再按位与，一次就能判断16/32个字符
+#if defined(SCAN_X86) && !defined(_MSC_VER)
+#define TARGET_SSSE3 __attribute__((target("ssse3")))
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#else
+#define TARGET_SSSE3
+#define TARGET_AVX2
+#endif
+
+// 字符分类表，两个128位通道各存一份，AVX2可以直接加载为32字节
+struct inputClassifier
+{
+    alignas(32) unsigned char termLo[32];
+    alignas(32) unsigned char termHi[32];
+    alignas(32) unsigned char spaceLo[32];
+    alignas(32) unsigned char spaceHi[32];
+    bool isTerminal[256]; // 标量版本用
+    bool isSpace[256];
+};
+
+// 预处理的实现级别
+enum scanLevel
+{
+    scanScalar,
+    scanSSSE3,
+    scanAVX2
+};
+
+// 按CPU支持情况选择最快的实现
+scanLevel detectScanLevel()
+{
+#if defined(SCAN_X86) && defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    int maxId = info[0];
+    __cpuid(info, 1);
+    bool ssse3 = (info[2] >> 9) & 1;
+    // AVX2还要求操作系统保存ymm寄存器
+    bool osAvx = ((info[2] >> 27) & 1) && ((info[2] >> 28) & 1) && (_xgetbv(0) & 6) == 6;
+    bool avx2 = false;
+    if (maxId >= 7 && osAvx)
+    {
+        __cpuidex(info, 7, 0);
+        avx2 = (info[1] >> 5) & 1;
+    }
+    return avx2 ? scanAVX2 : ssse3 ? scanSSSE3 : scanScalar;
+#elif defined(SCAN_X86)
+    __builtin_cpu_init();
+    if (__builtin_cpu_supports("avx2")) return scanAVX2;
+    if (__builtin_cpu_supports("ssse3")) return scanSSSE3;
+    return scanScalar;
+#else
+    return scanScalar;
+#endif
+}
+
+scanLevel currentScanLevel = detectScanLevel();
+
+const char* scanLevelName(scanLevel level)
+{
+    return level == scanAVX2 ? "AVX2" : level == scanSSSE3 ? "SSSE3" : "标量";
+}
+
+void makeNibbleTables(const bitset<128>& set, unsigned char* lo, unsigned char* hi)
+{
+    for (int i = 0; i < 16; ++i)
+    {
+        unsigned char l = 0;
+        for (int h = 0; h < 8; ++h)
+        {
+            if (set.test(h * 16 + i)) l |= 1 << h;
+        }
+        lo[i] = lo[i + 16] = l;
+        hi[i] = hi[i + 16] = i < 8 ? 1 << i : 0;
+    }
+}
+
+inputClassifier makeClassifier(const bitset<128>& terminals)
+{
+    inputClassifier k;
+    bitset<128> spaces;
+    for (char c : string(" \t\n\v\f\r")) spaces.set(c);
+    makeNibbleTables(terminals, k.termLo, k.termHi);
+    makeNibbleTables(spaces, k.spaceLo, k.spaceHi);
+    for (int c = 0; c < 256; ++c)
+    {
+        k.isTerminal[c] = c < 128 && terminals.test(c);
+        k.isSpace[c] = c < 128 && spaces.test(c);
+    }
+    return k;
+}
+
+// 压缩表：8位掩码中为1的字节依次排到前面，compressIndex是pshufb的下标
+struct compressTable
+{
+    unsigned char index[256][8];
+    unsigned char count[256];
+
+    compressTable()
+    {
+        for (int m = 0; m < 256; ++m)
+        {
+            int n = 0;
+            for (int i = 0; i < 8; ++i)
+            {
+                if (m >> i & 1) index[m][n++] = i;
+            }
+            count[m] = n;
+            for (int i = n; i < 8; ++i) index[m][i] = 0x80;
+        }
+    }
+};
+
+const compressTable compress8;
+
+// 掩码中第一个为1的位之前，keep中有几个1（去掉空白后的位置）
+int keptBefore(unsigned keep, unsigned bad)
+{
+    int i = 0;
+    while (!(bad >> i & 1)) ++i;
+    int n = 0;
+    for (int j = 0; j < i; ++j) n += keep >> j & 1;
+    return n;
+}
+
+// 标量版本：无分支地去掉空白，bad记录第一个非终结符的位置
+size_t scanInputScalar(const inputClassifier& k, const unsigned char* s, size_t n, char* out, int& bad, size_t j)
+{
+    for (size_t i = 0; i < n; ++i)
+    {
+        unsigned char c = s[i];
+        out[j] = c;
+        if (bad < 0 && !k.isTerminal[c] && !k.isSpace[c]) bad = j;
+        j += !k.isSpace[c];
+    }
+    return j;
+}
+
+#ifdef SCAN_X86
+// 16个字符中不在集合里的置0xff
+TARGET_SSSE3 inline __m128i notInSet16(__m128i v, const unsigned char* lo, const unsigned char* hi)
+{
+    __m128i low = _mm_and_si128(v, _mm_set1_epi8(0x0f));
+    __m128i high = _mm_and_si128(_mm_srli_epi16(v, 4), _mm_set1_epi8(0x0f));
+    __m128i m = _mm_and_si128(_mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)lo), low),
+        _mm_shuffle_epi8(_mm_loadu_si128((const __m128i*)hi), high));
+    return _mm_cmpeq_epi8(m, _mm_setzero_si128());
+}
+
+// 按keep掩码把16个字符中要保留的紧凑写到out，返回写入个数
+TARGET_SSSE3 inline size_t compress16(__m128i v, unsigned keep, char* out)
+{
+    if (keep == 0xffff)
+    {
+        _mm_storeu_si128((__m128i*)out, v);
+        return 16;
+    }
+    unsigned low = keep & 0xff, high = keep >> 8;
+    __m128i a = _mm_shuffle_epi8(v, _mm_loadl_epi64((const __m128i*)compress8.index[low]));
+    _mm_storel_epi64((__m128i*)out, a);
+    size_t n = compress8.count[low];
+    __m128i b = _mm_shuffle_epi8(_mm_srli_si128(v, 8), _mm_loadl_epi64((const __m128i*)compress8.index[high]));
+    _mm_storel_epi64((__m128i*)(out + n), b);
+    return n + compress8.count[high];
+}
+
+// 处理16个字符，返回新的输出位置
+TARGET_SSSE3 inline size_t scanBlock16(const inputClassifier& k, __m128i v, char* out, size_t j, int& bad)
+{
+    __m128i space = _mm_xor_si128(notInSet16(v, k.spaceLo, k.spaceHi), _mm_set1_epi8(-1));
+    __m128i other = _mm_andnot_si128(space, notInSet16(v, k.termLo, k.termHi));
+    unsigned keep = ~_mm_movemask_epi8(space) & 0xffff;
+    unsigned wrong = _mm_movemask_epi8(other);
+    if (wrong != 0 && bad < 0) bad = j + keptBefore(keep, wrong);
+    return j + compress16(v, keep, out + j);
+}
+
+// 处理32个字符
+TARGET_AVX2 inline size_t scanBlock32(const inputClassifier& k, __m256i v, char* out, size_t j, int& bad)
+{
+    const __m256i nibble = _mm256_set1_epi8(0x0f);
+    __m256i low = _mm256_and_si256(v, nibble);
+    __m256i high = _mm256_and_si256(_mm256_srli_epi16(v, 4), nibble);
+    __m256i term = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)k.termLo), low),
+        _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)k.termHi), high));
+    __m256i space = _mm256_and_si256(_mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)k.spaceLo), low),
+        _mm256_shuffle_epi8(_mm256_loadu_si256((const __m256i*)k.spaceHi), high));
+    unsigned keep = _mm256_movemask_epi8(_mm256_cmpeq_epi8(space, _mm256_setzero_si256()));
+    unsigned wrong = keep & _mm256_movemask_epi8(_mm256_cmpeq_epi8(term, _mm256_setzero_si256()));
+    if (wrong != 0 && bad < 0) bad = j + keptBefore(keep, wrong);
+    if (keep == 0xffffffffu)
+    {
+        _mm256_storeu_si256((__m256i*)(out + j), v);
+        return j + 32;
+    }
+    j += compress16(_mm256_castsi256_si128(v), keep & 0xffff, out + j);
+    return j + compress16(_mm256_extracti128_si256(v, 1), keep >> 16, out + j);
+}
+
+// 不足一块的结尾补空格凑成一整块，补的空格会被去掉
+TARGET_SSSE3 size_t scanInputSSSE3(const inputClassifier& k, const unsigned char* s, size_t n, char* out, int& bad)
+{
+    size_t i = 0, j = 0;
+    for (; i + 16 <= n; i += 16) j = scanBlock16(k, _mm_loadu_si128((const __m128i*)(s + i)), out, j, bad);
+    if (i == n) return j;
+    unsigned char tail[16];
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, s + i, n - i);
+    return scanBlock16(k, _mm_loadu_si128((const __m128i*)tail), out, j, bad);
+}
+
+TARGET_AVX2 size_t scanInputAVX2(const inputClassifier& k, const unsigned char* s, size_t n, char* out, int& bad)
+{
+    size_t i = 0, j = 0;
+    for (; i + 32 <= n; i += 32) j = scanBlock32(k, _mm256_loadu_si256((const __m256i*)(s + i)), out, j, bad);
+    if (i == n) return j;
+    unsigned char tail[32];
+    memset(tail, ' ', sizeof(tail));
+    memcpy(tail, s + i, n - i);
+    return scanBlock32(k, _mm256_loadu_si256((const __m256i*)tail), out, j, bad);
+}
+#endif
+
+// 去掉句子中的空白写到out，返回第一个不是终结符的字符位置（去空白后），都是终结符时返回-1
+int scanInput(const inputClassifier& k, const string& sentence, string& out, scanLevel level = currentScanLevel)
+{
+    // 向量版本整块写出，末尾多留一些空间
+    out.resize(sentence.length() + 32);
+    const unsigned char* s = (const unsigned char*)sentence.data();
+    int bad = -1;
+    size_t n;
+#ifdef SCAN_X86
+    if (level == scanAVX2) n = scanInputAVX2(k, s, sentence.length(), &out[0], bad);
+    else if (level == scanSSSE3) n = scanInputSSSE3(k, s, sentence.length(), &out[0], bad);
+    else n = scanInputScalar(k, s, sentence.length(), &out[0], bad, 0);
+#else
+    n = scanInputScalar(k, s, sentence.length(), &out[0], bad, 0);
+#endif
+    out.resize(n);
+    return bad;
+}
+
+// 从scanInput返回的位置开始，把不是终结符的字符换成0x7f（同lexSentence），这样它一定出错，$也不会被当成结束符
+void markInvalid(const inputClassifier& k, string& out, int bad)
+{
+    if (bad < 0) return;
+    for (size_t i = bad; i < out.length(); ++i)
+    {
+        if (!k.isTerminal[(unsigned char)out[i]]) out[i] = '\x7f';
+    }
+}
+
+
+/******************** 句子分析 ***************************/
+// 动作编码：0为出错，正数为移进到(值-1)号状态，负数为按(-值-1)号文法归约
+const int acceptAction = slr1::acceptAction;
+// 分析栈默认最多的状态数，超过时报告嵌套超过上限（--batch可以用--max-depth修改，每个分析各自带着上限）
+const size_t defaultNestingLimit = 1 << 22;
+
+// ASCII字符的集合，明确存成两个64位整数，分析表文件里的布局和内存中相同
+struct charBits
+{
+    uint64_t w[2] = { 0, 0 };
+
+    bool test(unsigned char c) const { return c < 128 && (w[c >> 6] >> (c & 63) & 1); }
+    void set(unsigned char c) { w[c >> 6] |= uint64_t(1) << (c & 63); }
+};
+
+// 运行时分析表（整数编码，按字符下标直接查表）
+struct runtimeTable
+{
+    int stateCount = 0;
+    tableArray<int> action; // stateCount * 128
+    tableArray<int> gotoTable; // stateCount * 128，-1为空
+    tableArray<char> prodLeft; // 每条文法的左部
+    tableArray<int> prodLen; // 每条文法右部长度
+    int unitEliminated = 0; // 被绕过的单产生式归约状态数
+    tableArray<charBits> expected; // 每个状态可以接受的终结符，出错时直接用来报告
+    tableArray<charBits> followBits; // 按非终结符下标的Follow集合，作为同步符号
+    char errorSymbol = 0; // 错误终结符
+    int acceptGid = 0; // 开始符号的产生式（接受时归约）
+    char startSymbol = 0; // 增广后的开始符号
+    inputClassifier classifier; // 输入预处理用，终结符为所有状态中有动作的字符
+    lexerTable lexer; // 有%token声明时用它切分单词
+
+    // 分析表文件载入时不逐项检查表项（见mappedTable），分析时把要用作下标的表项检查一遍，越界的当作出错
+    // 动作：移进的状态、归约的产生式在范围内，归约后栈里至少留下一个状态；depth为栈中的状态数
+    bool validAction(int a, size_t depth) const
+    {
+        if (a >= 0) return a <= stateCount || a == acceptAction;
+        return a >= -(int)prodLen.size() && (size_t)prodLen[-a - 1] < depth;
+    }
+    // goto：-1（空）和越界的都不能用
+    bool validGoto(int g) const { return (unsigned)g < (unsigned)stateCount; }
+};
+
+// 一处语法错误，期望的终结符由出错状态的expected给出
+struct parseDiagnostic
+{
+    int pos; // 出错的字符位置（去掉空白后）
+    char got; // 遇到的字符
+    int state; // 出错时的状态
+    bool tooDeep; // 栈深度超过上限，之后不再分析
+};
+
+// 分析过程每一步的动作
+enum traceCode : unsigned char
+{
+    traceShift,
+    traceReduce,
+    traceAccept,
+    traceError,
+    traceGotoError // 归约后goto出错
+};
+
+// 栈中的一个结点，parent指向它下面的结点，所有步骤的栈共享同一份结点
+struct traceNode
+{
+    int state;
+    int parent;
+    char symbol;
+};
+
+// 紧凑的一步记录，栈只记栈顶结点，每步最多新增几个结点（增量）
+struct traceStep
+{
+    int top; // 动作前的栈顶结点
+    int pos; // 动作前的输入位置
+    int arg; // 移进的状态或归约的文法编号
+    traceCode code;
+};
+
+// 分析过程记录，显示时再按需拼出某一行
+struct traceLog
+{
+    string input;
+    vector<traceNode> nodes;
+    vector<traceStep> steps;
+    vector<pair<int, string>> notes; // 错误恢复的说明，按步骤号排序
+    vector<int> nodeIndex; // 记录时与状态栈一一对应的结点
+    vector<string> rules; // 按文法编号的产生式文本，显示归约动作用（不随句子清空）
+
+    // 显示时栈和输入串最多显示的长度
+    static const int showLimit = 64;
+
+    void begin(const string& sentence)
+    {
+        input.clear();
+        nodes.clear();
+        steps.clear();
+        notes.clear();
+        nodeIndex.clear();
+        input = sentence;
+        nodes.push_back({ 0, -1, '$' });
+        nodeIndex.push_back(0);
+    }
+
+    // 一步结束后同步栈：保留前keep个结点，其余按当前栈新增
+    template <template <class> class Stack>
+    void sync(size_t keep, const Stack<int>& stateStack, const Stack<char>& symbolStack)
+    {
+        nodeIndex.resize(keep);
+        for (size_t k = keep; k < stateStack.size(); ++k)
+        {
+            nodes.push_back({ stateStack[k], nodeIndex.back(), symbolStack[k] });
+            nodeIndex.push_back(nodes.size() - 1);
+        }
+    }
+
+    size_t bytes() const
+    {
+        size_t n = input.capacity() + nodes.capacity() * sizeof(traceNode) + steps.capacity() * sizeof(traceStep);
+        for (const auto& note : notes) n += sizeof(note) + note.second.capacity();
+        return n;
+    }
+
+    // 第i步的状态栈（states为true）或符号栈，从栈顶往下最多取showLimit个
+    string stackText(int i, bool states) const
+    {
+        vector<int> part;
+        int n = steps[i].top;
+        while (n != -1 && part.size() < showLimit)
+        {
+            part.push_back(n);
+            n = nodes[n].parent;
+        }
+        string text = n != -1 ? "... " : "";
+        for (auto it = part.rbegin(); it != part.rend(); ++it)
+        {
+            if (states) text += to_string(nodes[*it].state) + " ";
+            else text += nodes[*it].symbol;
+        }
+        return text;
+    }
+
+    string inputText(int i) const
+    {
+        int pos = steps[i].pos;
+        if (input.length() - pos <= showLimit) return input.substr(pos);
+        return input.substr(pos, showLimit) + " ...";
+    }
+
+    string actionText(int i) const
+    {
+        const traceStep& st = steps[i];
+        string text;
+        switch (st.code)
+        {
+        case traceShift:
+            text = "移进 s" + to_string(st.arg);
+            break;
+        case traceReduce:
+        case traceGotoError:
+            text = "归约 " + (st.arg < (int)rules.size() ? rules[st.arg] : to_string(st.arg));
+            if (st.code == traceGotoError) text += "，goto出错";
+            break;
+        case traceAccept:
+            text = "接受";
+            break;
+        case traceError:
+            text = "出错";
+            break;
+        }
+        auto it = lower_bound(notes.begin(), notes.end(), make_pair(i, string()));
+        if (it != notes.end() && it->first == i) text += it->second;
+        return text;
+    }
+};
+
+// 当前句子的分析过程（表格直接读它，重新分析前不清空）
+traceLog parseTrace;
+
+// 把一个状态的字符串动作转成整数编码，action和gotoRow各128项，调用前填好0和-1
+void encodeRow(grammarContext& ctx, const SLRUnit& row, int* action, int* gotoRow)
+{
+    for (const auto& entry : row.m)
+    {
+        unsigned char c = entry.first;
+        const string& a = entry.second;
+        if (c >= 128) continue;
+        if (isBigAlpha(c)) gotoRow[c] = stoi(a);
+        else if (a == "ACCEPT") action[c] = acceptAction;
+        else if (a[0] == 's') action[c] = stoi(a.substr(1)) + 1;
+        else
+        {
+            // r(A->xxx)
+            int gid = ctx.grammarToInt[make_pair(a[2], a.substr(5, a.length() - 6))];
+            action[c] = -gid - 1;
+        }
+    }
+}
+
+// 把字符串形式的分析表（SLR1/LALR1/LR1通用）转成整数编码
+runtimeTable buildRuntimeTable(grammarContext& ctx, const vector<SLRUnit>& table)
+{
+    runtimeTable t;
+    t.stateCount = table.size();
+    t.startSymbol = ctx.trueStartSymbol;
+    t.action.assign(t.stateCount * 128, 0);
+    t.gotoTable.assign(t.stateCount * 128, -1);
+    for (const auto& g : ctx.grammarDeque)
+    {
+        if (g.left == ctx.trueStartSymbol) t.acceptGid = t.prodLeft.size();
+        t.prodLeft.push_back(g.left);
+        t.prodLen.push_back(rightLength(g));
+    }
+    for (int i = 0; i < t.stateCount; ++i)
+    {
+        encodeRow(ctx, table[i], &t.action.edit(i * 128), &t.gotoTable.edit(i * 128));
+    }
+
+    // 错误恢复用的数据，只在建表时算一次
+    t.expected.resize(t.stateCount);
+    bitset<128> terminals;
+    for (int i = 0; i < t.stateCount; ++i)
+    {
+        for (int c = 0; c < 128; ++c)
+        {
+            if (t.action[i * 128 + c] == 0) continue;
+            t.expected.edit(i).set(c);
+            terminals.set(c);
+        }
+    }
+    // $是结束符，句子中出现时当作非法字符
+    terminals.reset('$');
+    t.classifier = makeClassifier(terminals);
+    t.lexer = ctx.grammarLexer;
+    t.followBits.resize(128);
+    for (const auto& f : ctx.followSets)
+    {
+        for (char c : f.second.s)
+        {
+            if ((unsigned char)c < 128) t.followBits.edit((unsigned char)f.first).set((unsigned char)c);
+        }
+    }
+    t.errorSymbol = ctx.errorSymbol;
+    return t;
+}
+
+// 绕过单产生式归约：只会按A->B归约的状态不再进入，goto(s, B)直接指向goto(s, A)
+void eliminateUnitReductions(const grammarContext& ctx, runtimeTable& t)
+{
+    // 每个状态唯一的单产生式归约，-1表示不是这种状态
+    vector<int> unitGid(t.stateCount, -1);
+    for (int s = 0; s < t.stateCount; ++s)
+    {
+        int act = 0;
+        bool only = true;
+        for (int c = 0; c < 128 && only; ++c)
+        {
+            int a = t.action[s * 128 + c];
+            if (t.gotoTable[s * 128 + c] != -1 || a > 0) only = false;
+            else if (a != 0)
+            {
+                if (act == 0) act = a;
+                else if (act != a) only = false;
+            }
+        }
+        if (!only || act >= 0) continue;
+        int gid = -act - 1;
+        if (t.prodLen[gid] == 1 && isBigAlpha(ctx.grammarDeque[gid].right[0]))
+        {
+            unitGid[s] = gid;
+        }
+    }
+
+    set<int> bypassed;
+    for (int s = 0; s < t.stateCount; ++s)
+    {
+        for (int c = 'A'; c <= 'Z'; ++c)
+        {
+            int target = t.gotoTable[s * 128 + c];
+            if (target == -1) continue;
+            // 沿着单产生式链一直往上走
+            int guard = 0;
+            while (unitGid[target] != -1 && guard++ < t.stateCount)
+            {
+                int next = t.gotoTable[s * 128 + t.prodLeft[unitGid[target]]];
+                if (next == -1) break;
+                bypassed.insert(target);
+                target = next;
+            }
+            t.gotoTable.edit(s * 128 + c) = target;
+        }
+    }
+    t.unitEliminated = bypassed.size();
+}
+
+// 状态最小化：先去掉从0号状态走不到的状态，再把动作相同、移进和goto都转到等价状态的状态合并（Hopcroft划分求精）
+// 动作行完全相同，出错位置和期望的终结符都不变，返回减少的状态数
+int minimizeStates(runtimeTable& t)
+{
+    const runtimeTable& src = t;
+    int n = src.stateCount;
+    // 状态s读入c后转到的状态，-1为没有转移
+    auto target = [&](int s, int c)
+    {
+        int a = src.action[s * 128 + c];
+        if (a > 0 && a != acceptAction) return a - 1;
+        return src.gotoTable[s * 128 + c];
+    };
+
+    // 可达状态，按编号从小到大
+    vector<char> reached(n, 0);
+    vector<int> order(1, 0);
+    reached[0] = 1;
+    for (size_t k = 0; k < order.size(); ++k)
+    {
+        for (int c = 0; c < 128; ++c)
+        {
+            int to = target(order[k], c);
+            if (to >= 0 && !reached[to])
+            {
+                reached[to] = 1;
+                order.push_back(to);
+            }
+        }
+    }
+    vector<int> live;
+    for (int s = 0; s < n; ++s)
+    {
+        if (reached[s]) live.push_back(s);
+    }
+    int m = live.size();
+    vector<int> liveId(n, -1);
+    for (int i = 0; i < m; ++i) liveId[live[i]] = i;
+
+    // 有转移的符号
+    vector<int> symbols;
+    for (int c = 0; c < 128; ++c)
+    {
+        for (int s : live)
+        {
+            if (target(s, c) >= 0)
+            {
+                symbols.push_back(c);
+                break;
+            }
+        }
+    }
+    int k = symbols.size();
+
+    // 按目标状态和符号分组的前驱（CSR），划分求精时查pre(B, c)
+    vector<int> predStart(m * k + 1, 0), preds;
+    for (int i = 0; i < m; ++i)
+    {
+        for (int j = 0; j < k; ++j)
+        {
+            int to = target(live[i], symbols[j]);
+            if (to >= 0) ++predStart[liveId[to] * k + j + 1];
+        }
+    }
+    for (int x = 0; x < m * k; ++x) predStart[x + 1] += predStart[x];
+    preds.resize(predStart[m * k]);
+    vector<int> fill(predStart.begin(), predStart.end() - 1);
+    for (int i = 0; i < m; ++i)
+    {
+        for (int j = 0; j < k; ++j)
+        {
+            int to = target(live[i], symbols[j]);
+            if (to >= 0) preds[fill[liveId[to] * k + j]++] = i;
+        }
+    }
+
+    // 初始划分：动作行相同（移进只看有没有，不看去哪），有goto的非终结符也相同
+    vector<int> blockOf(m);
+    vector<int> blockStart, blockEnd;
+    {
+        map<vector<int>, int> rowBlock;
+        vector<int> key(256);
+        vector<int> blockSize;
+        for (int i = 0; i < m; ++i)
+        {
+            int s = live[i];
+            for (int c = 0; c < 128; ++c)
+            {
+                int a = src.action[s * 128 + c];
+                key[c] = a > 0 && a != acceptAction ? 1 : a;
+                key[128 + c] = src.gotoTable[s * 128 + c] >= 0;
+            }
+            auto it = rowBlock.find(key);
+            if (it == rowBlock.end())
+            {
+                it = rowBlock.insert(make_pair(key, (int)blockSize.size())).first;
+                blockSize.push_back(0);
+            }
+            blockOf[i] = it->second;
+            ++blockSize[it->second];
+        }
+        int start = 0;
+        for (int size : blockSize)
+        {
+            blockStart.push_back(start);
+            blockEnd.push_back(start);
+            start += size;
+        }
+    }
+    // elems按块连续存放，pos为每个状态在elems中的位置
+    vector<int> elems(m), pos(m);
+    for (int i = 0; i < m; ++i)
+    {
+        pos[i] = blockEnd[blockOf[i]]++;
+        elems[pos[i]] = i;
+    }
+
+    // 待处理的(块, 符号)，开始时放入全部
+    vector<pair<int, int>> work;
+    vector<char> waiting;
+    for (int b = 0; b < (int)blockStart.size(); ++b)
+    {
+        for (int j = 0; j < k; ++j)
+        {
+            work.push_back(make_pair(b, j));
+            waiting.push_back(1);
+        }
+    }
+    vector<int> marked(blockStart.size(), 0), touched, splitter;
+    while (!work.empty())
+    {
+        int b = work.back().first, j = work.back().second;
+        work.pop_back();
+        waiting[b * k + j] = 0;
+
+        // 先收集pre(b, c)，标记时会在块内交换位置
+        splitter.clear();
+        for (int x = blockStart[b]; x < blockEnd[b]; ++x)
+        {
+            int e = elems[x] * k + j;
+            splitter.insert(splitter.end(), preds.begin() + predStart[e], preds.begin() + predStart[e + 1]);
+        }
+        for (int p : splitter)
+        {
+            int x = blockOf[p];
+            int boundary = blockStart[x] + marked[x];
+            if (pos[p] < boundary) continue;
+            if (marked[x] == 0) touched.push_back(x);
+            // 换到块前部的已标记区
+            int q = elems[boundary];
+            swap(elems[pos[p]], elems[boundary]);
+            pos[q] = pos[p];
+            pos[p] = boundary;
+            ++marked[x];
+        }
+
+        for (int x : touched)
+        {
+            int count = marked[x];
+            marked[x] = 0;
+            if (count == blockEnd[x] - blockStart[x]) continue;
+            // 已标记的部分分成新块y
+            int y = blockStart.size();
+            blockStart.push_back(blockStart[x]);
+            blockEnd.push_back(blockStart[x] + count);
+            blockStart[x] += count;
+            marked.push_back(0);
+            for (int z = blockStart[y]; z < blockEnd[y]; ++z) blockOf[elems[z]] = y;
+            bool yIsSmaller = count <= blockEnd[x] - blockStart[x];
+            waiting.resize(waiting.size() + k, 0);
+            for (int c = 0; c < k; ++c)
+            {
+                // x已在等待时两半都要处理，否则只处理小的一半
+                int add = waiting[x * k + c] || yIsSmaller ? y : x;
+                if (waiting[add * k + c]) continue;
+                waiting[add * k + c] = 1;
+                work.push_back(make_pair(add, c));
+            }
+        }
+        touched.clear();
+    }
+
+    // 按块中最小的原状态编号重新编号，0号状态仍是开始状态
+    int blocks = blockStart.size();
+    vector<int> newId(blocks, -1), representative;
+    for (int i = 0; i < m; ++i)
+    {
+        int b = blockOf[i];
+        if (newId[b] != -1) continue;
+        newId[b] = representative.size();
+        representative.push_back(live[i]);
+    }
+    auto renumber = [&](int s) { return newId[blockOf[liveId[s]]]; };
+
+    tableArray<int> action, gotoTable;
+    tableArray<charBits> expected;
+    action.assign(blocks * 128, 0);
+    gotoTable.assign(blocks * 128, -1);
+    expected.resize(blocks);
+    for (int b = 0; b < blocks; ++b)
+    {
+        int s = representative[b];
+        for (int c = 0; c < 128; ++c)
+        {
+            int a = src.action[s * 128 + c];
+            int g = src.gotoTable[s * 128 + c];
+            action.edit(b * 128 + c) = a > 0 && a != acceptAction ? renumber(a - 1) + 1 : a;
+            gotoTable.edit(b * 128 + c) = g >= 0 ? renumber(g) : -1;
+        }
+        expected.edit(b) = src.expected[s];
+    }
+    t.action = move(action);
+    t.gotoTable = move(gotoTable);
+    t.expected = move(expected);
+    t.stateCount = blocks;
+    return n - blocks;
+}
+
+// 错误恢复：有错误产生式时移进错误终结符，否则按Follow集合做紧急恢复，how返回恢复方式
+template <template <class> class Stack>
+bool recoverFromError(const runtimeTable& t, Stack<int>& stateStack, Stack<char>& symbolStack,
+    const string& input, int& pos, string& how)
+{
+    int last = input.length() - 1; // $的位置
+
+    // 错误产生式：弹栈直到能移进错误终结符，再跳过不能接受的输入
+    if (t.errorSymbol != 0)
+    {
+        int depth = stateStack.size();
+        while (depth > 0 && t.action[stateStack[depth - 1] * 128 + t.errorSymbol] <= 0) --depth;
+        if (depth > 0)
+        {
+            int a = t.action[stateStack[depth - 1] * 128 + t.errorSymbol];
+            if (a != acceptAction && t.validAction(a, depth))
+            {
+                stateStack.resize(depth);
+                symbolStack.resize(depth);
+                stateStack.push_back(a - 1);
+                symbolStack.push_back(t.errorSymbol);
+                int skipped = 0;
+                while (pos < last && t.action[stateStack.back() * 128 + (unsigned char)input[pos]] == 0)
+                {
+                    ++pos;
+                    ++skipped;
+                }
+                how = "移进错误符号" + string(1, t.errorSymbol) + "，跳过" + to_string(skipped) + "个输入";
+                return t.action[stateStack.back() * 128 + (unsigned char)input[pos]] != 0;
+            }
+        }
+    }
+
+    // 紧急恢复：找到栈中最近的、有非终结符goto的状态，选跳过输入最少的那个非终结符
+    for (int depth = stateStack.size(); depth > 0; --depth)
+    {
+        int s = stateStack[depth - 1];
+        int bestPos = -1;
+        char bestA = 0;
+        for (int A = 'A'; A <= 'Z'; ++A)
+        {
+            if (!t.validGoto(t.gotoTable[s * 128 + A])) continue;
+            int p = pos;
+            while (p < last && !t.followBits[A].test((unsigned char)input[p])) ++p;
+            if (!t.followBits[A].test((unsigned char)input[p])) continue;
+            if (bestPos == -1 || p < bestPos)
+            {
+                bestPos = p;
+                bestA = A;
+            }
+        }
+        if (bestPos == -1) continue;
+        how = "弹出" + to_string(stateStack.size() - depth) + "个状态，跳过" + to_string(bestPos - pos)
+            + "个输入，假定归约出" + string(1, bestA);
+        stateStack.resize(depth);
+        symbolStack.resize(depth);
+        stateStack.push_back(t.gotoTable[s * 128 + bestA]);
+        symbolStack.push_back(bestA);
+        pos = bestPos;
+        return true;
+    }
+    how = "无法恢复";
+    return false;
+}
+
+/******************** 语法树 ***************************/
+// 语法树结点，孩子指针按产生式右部长度连续存放在内存池中
+struct treeNode
+{
+    char symbol;
+    int gid; // 归约用的文法编号，终结符和错误恢复产生的结点为-1
+    int pos; // 终结符在输入中的位置
+    treeNode** children;
+    int childCount;
+};
+
+// bump内存池：按块顺序分配，不单独释放，clear后整块复用
+struct treeArena
+{
+    static const size_t blockSize = 64 * 1024;
+    vector<unique_ptr<char[]>> blocks;
+    size_t used = blockSize; // 当前块已用字节
+    size_t totalBytes = 0;
+
+    void* allocate(size_t bytes)
+    {
+        bytes = (bytes + alignof(treeNode) - 1) / alignof(treeNode) * alignof(treeNode);
+        if (used + bytes > blockSize)
+        {
+            blocks.emplace_back(new char[bytes > blockSize ? bytes : blockSize]);
+            used = 0;
+        }
+        void* p = blocks.back().get() + used;
+        used += bytes;
+        totalBytes += bytes;
+        return p;
+    }
+
+    treeNode* newNode(char symbol, int gid, int pos)
+    {
+        treeNode* n = static_cast<treeNode*>(allocate(sizeof(treeNode)));
+        n->symbol = symbol;
+        n->gid = gid;
+        n->pos = pos;
+        n->children = nullptr;
+        n->childCount = 0;
+        return n;
+    }
+
+    // 保留第一块，下一个句子接着用
+    void clear()
+    {
+        if (blocks.size() > 1) blocks.resize(1);
+        used = blocks.empty() ? blockSize : 0;
+        totalBytes = 0;
+    }
+};
+
+// 语法树转成括号形式，超过limit个字符就截断（用显式栈，深的树也不会爆栈）
+string treeToString(const treeNode* root, size_t limit)
+{
+    string out;
+    vector<pair<const treeNode*, int>> st;
+    st.push_back(make_pair(root, 0));
+    while (!st.empty() && out.length() < limit)
+    {
+        const treeNode* n = st.back().first;
+        int& k = st.back().second;
+        if (k == 0)
+        {
+            if (!out.empty() && out.back() != '(') out += ' ';
+            out += n->symbol;
+            if (n->gid < 0)
+            {
+                st.pop_back();
+                continue;
+            }
+            out += '(';
+        }
+        if (k < n->childCount)
+        {
+            st.push_back(make_pair(n->children[k++], 0));
+            continue;
+        }
+        out += ')';
+        st.pop_back();
+    }
+    if (!st.empty()) out += "...";
+    return out;
+}
+
+// 分析用的栈和输入缓冲，反复分析时复用，避免每个句子都重新分配
+// 栈分段分配，嵌套很深时也不用整体搬动；Stack可以换成别的栈，测试时和vector实现的结果比对
+template <template <class> class Stack>
+struct basicParseWorkspace
+{
+    Stack<int> stateStack;
+    Stack<char> symbolStack;
+    string input;
+    Stack<treeNode*> nodeStack; // 与状态栈对应的树结点（不含栈底）
+    size_t nestingLimit = defaultNestingLimit; // 状态栈最多的状态数
+    bool tooDeep = false; // 最近一次分析是否因为嵌套超过上限而停止
+};
+typedef basicParseWorkspace<segmentedStack> parseWorkspace;
+
+// 分析驱动，BuildTree为false时建树的代码在编译期就去掉了
+template <bool BuildTree, class Workspace>
+bool parseSentenceImpl(const runtimeTable& t, const string& sentence, int& steps, traceLog* trace,
+    vector<parseDiagnostic>* diagnostics, treeArena* arena, treeNode** root, Workspace& ws)
+{
+    // 终结符都是单个字符，忽略空白；有词法分析器时先切分成单词
+    string& input = ws.input;
+    int bad = t.lexer.stateCount > 0 ? lexSentence(t.lexer, sentence, input) : scanInput(t.classifier, sentence, input);
+    ws.tooDeep = false;
+    // 有不是终结符的字符一定不能接受，不需要报告错误时直接返回
+    if (bad >= 0 && diagnostics == nullptr && trace == nullptr)
+    {
+        steps = 0;
+        return false;
+    }
+    // 要报告错误时继续分析，出错的字符在分析中报告
+    if (t.lexer.stateCount == 0) markInvalid(t.classifier, input, bad);
+    input += '$';
+
+    auto& stateStack = ws.stateStack;
+    auto& symbolStack = ws.symbolStack;
+    auto& nodeStack = ws.nodeStack;
+    stateStack.limit = symbolStack.limit = nodeStack.limit = ws.nestingLimit;
+    stateStack.assign(1, 0);
+    symbolStack.assign(1, '$');
+    nodeStack.clear();
+    if (trace) trace->begin(input);
+    int pos = 0;
+    steps = 0;
+    // 上次出错后成功移进的个数，不足3个时不重复报告（避免连锁错误）
+    int shiftedSinceError = 3;
+    int lastErrorPos = -1;
+    bool hasError = false;
+    while (true)
+    {
+        int s = stateStack.back();
+        unsigned char c = input[pos];
+        int a = c < 128 ? t.action[s * 128 + c] : 0;
+        if (!t.validAction(a, stateStack.size())) a = 0;
+        ++steps;
+
+        // 本步的记录，keep为本步中栈没有动过的部分
+        traceStep* row = nullptr;
+        size_t keep = stateStack.size();
+        string note;
+        if (trace)
+        {
+            trace->steps.push_back({ trace->nodeIndex.back(), pos, 0, traceError });
+            row = &trace->steps.back();
+        }
+
+        bool done = false, accepted = false, error = false, tooDeep = false;
+        if (a == 0)
+        {
+            error = true;
+        }
+        else if (a == acceptAction)
+        {
+            if (trace) row->code = traceAccept;
+            done = true;
+            accepted = !hasError;
+            if (BuildTree)
+            {
+                // 接受时归约的是开始符号的产生式，把它也建成结点
+                // 增广的^->S不建结点，S就是树根
+                if (t.startSymbol == '^') *root = nodeStack.back();
+                else
+                {
+                    int len = nodeStack.size();
+                    treeNode* n = arena->newNode(t.startSymbol, t.acceptGid, -1);
+                    n->childCount = len;
+                    n->children = static_cast<treeNode**>(arena->allocate(len * sizeof(treeNode*)));
+                    nodeStack.copyTop(0, n->children);
+                    *root = n;
+                }
+            }
+        }
+        else if (a > 0)
+        {
+            if (trace)
+            {
+                row->code = traceShift;
+                row->arg = a - 1;
+            }
+            if (!stateStack.push_back(a - 1)) tooDeep = true;
+            else
+            {
+                symbolStack.push_back(c);
+                if (BuildTree) nodeStack.push_back(arena->newNode(c, -1, pos));
+                ++pos;
+                ++shiftedSinceError;
+            }
+        }
+        else
+        {
+            int gid = -a - 1;
+            if (trace)
+            {
+                row->code = traceReduce;
+                row->arg = gid;
+            }
+            int len = t.prodLen[gid];
+            stateStack.pop(len);
+            symbolStack.pop(len);
+            keep = stateStack.size();
+            if (BuildTree)
+            {
+                // 孩子就是栈顶的len个结点，连续拷贝到内存池
+                treeNode* n = arena->newNode(t.prodLeft[gid], gid, -1);
+                n->childCount = len;
+                n->children = static_cast<treeNode**>(arena->allocate(len * sizeof(treeNode*)));
+                nodeStack.copyTop(nodeStack.size() - len, n->children);
+                nodeStack.resize(nodeStack.size() - len);
+                nodeStack.push_back(n);
+            }
+            int next = t.gotoTable[stateStack.back() * 128 + t.prodLeft[gid]];
+            if (!t.validGoto(next))
+            {
+                if (trace) row->code = traceGotoError;
+                error = true;
+                if (BuildTree) nodeStack.pop_back();
+            }
+            else if (!stateStack.push_back(next))
+            {
+                tooDeep = true;
+                if (BuildTree) nodeStack.pop_back();
+            }
+            else symbolStack.push_back(t.prodLeft[gid]);
+        }
+
+        // 栈深度超过上限，不再恢复
+        if (tooDeep)
+        {
+            if (trace)
+            {
+                row->code = traceError;
+                note = "，嵌套超过上限" + to_string(ws.nestingLimit);
+            }
+            if (diagnostics) diagnostics->push_back({ pos, (char)c, s, true });
+            ws.tooDeep = true;
+            hasError = true;
+            done = true;
+        }
+        else if (error)
+        {
+            hasError = true;
+            if (diagnostics == nullptr)
+            {
+                done = true;
+            }
+            else
+            {
+                if (shiftedSinceError >= 3) diagnostics->push_back({ pos, (char)c, s, false });
+                // 同一位置反复出错，丢掉一个输入保证前进
+                if (pos == lastErrorPos && shiftedSinceError == 0)
+                {
+                    if (pos + 1 >= (int)input.length())
+                    {
+                        if (trace) note = "，无法恢复";
+                        done = true;
+                    }
+                    else ++pos;
+                }
+                if (!done)
+                {
+                    string how;
+                    if (!recoverFromError(t, stateStack, symbolStack, input, pos, how)) done = true;
+                    else if (BuildTree)
+                    {
+                        // 恢复时弹栈并压入了一个符号，用没有孩子的结点代替
+                        nodeStack.resize(stateStack.size() - 2);
+                        nodeStack.push_back(arena->newNode(symbolStack.back(), -1, pos));
+                    }
+                    if (trace) note = "，" + how;
+                    keep = min(keep, stateStack.size() - 1);
+                }
+                lastErrorPos = pos;
+                shiftedSinceError = 0;
+            }
+        }
+        if (trace)
+        {
+            if (!note.empty()) trace->notes.push_back(make_pair((int)trace->steps.size() - 1, note));
+            trace->sync(keep, stateStack, symbolStack);
+        }
+        if (done) return accepted;
+    }
+}
+
+// 分析一个句子，steps返回分析步数，trace不为空时记录分析过程
+// diagnostics不为空时出错后继续恢复分析，一遍报告所有错误；为空时遇到第一个错误就停止
+// arena不为空时在内存池中建语法树，接受后root为树根
+bool parseSentence(const runtimeTable& t, const string& sentence, int& steps, traceLog* trace,
+    vector<parseDiagnostic>* diagnostics = nullptr, treeArena* arena = nullptr, treeNode** root = nullptr)
+{
+    parseWorkspace ws;
+    if (arena != nullptr) return parseSentenceImpl<true>(t, sentence, steps, trace, diagnostics, arena, root, ws);
+    return parseSentenceImpl<false>(t, sentence, steps, trace, diagnostics, nullptr, nullptr, ws);
+}
+
+// 期望的终结符，用于报错
+string expectedString(const runtimeTable& t, int state)
+{
+    string result;
+    for (int c = 0; c < 128; ++c)
+    {
+        if (t.expected[state].test(c)) result += string(result.empty() ? "" : " ") + (char)c;
+    }
+    return result;
+}
+
+// 依次尝试SLR1、LALR1、最小LR1，返回第一个没有冲突的分析表（必须先调用getFirstSets、getFollowSets、getLR0）
+const vector<SLRUnit>* chooseParseTable(grammarContext& ctx)
+{
+    if (getSLR1Table(ctx) == 0) return &ctx.SLRVector;
+    if (getLALR1Table(ctx) == 0) return &ctx.LALRVector;
+    if (getLR1Table(ctx) == 0) return &ctx.LR1Vector;
+    return nullptr;
+}
+
+/******************** 增量分析 ***************************/
+// 按固定的单词间隔保存状态栈检查点。句子修改后，从修改处之前最近的检查点重新分析，
+// 越过修改处后只要在某个旧检查点处状态栈一致，后面的分析就和原来完全相同，直接沿用
+
+// 检查点：已移进pos个单词后的状态栈
+struct parseCheckpoint
+{
+    int pos;
+    int steps; // 到这里为止的分析步数
+    vector<int> stack;
+};
+
+struct incrementalParser
+{
+    runtimeTable table; // 自己保存一份，界面重新建表不影响
+    int interval = 64; // 检查点间隔（单词数）
+    string input; // 切分后的单词串，以$结尾
+    vector<parseCheckpoint> checkpoints; // 按pos递增，第一个pos为0
+    bool accepted = false;
+    int steps = 0; // 整个句子的分析步数
+    // 最近一次分析的情况
+    int restartPos = 0; // 从哪个单词重新开始
+    int executedSteps = 0; // 实际执行的步数
+    int syncPos = -1; // 在哪个单词处与原分析同步，-1为没有同步
+
+    // 第一次分析，全部重新做
+    void parse(const runtimeTable& t, const string& sentence)
+    {
+        table = t;
+        tokenize(sentence, input);
+        checkpoints.assign(1, parseCheckpoint{ 0, 0, vector<int>(1, 0) });
+        vector<parseCheckpoint> none;
+        run(none, numeric_limits<int>::max(), 0, 0);
+    }
+
+    // 句子修改后重新分析
+    void update(const string& sentence)
+    {
+        string newInput;
+        tokenize(sentence, newInput);
+        // 新旧单词串的公共前缀和公共后缀之间就是修改的部分
+        size_t prefix = 0, suffix = 0;
+        size_t limit = min(input.length(), newInput.length());
+        while (prefix < limit && input[prefix] == newInput[prefix]) ++prefix;
+        while (suffix < limit - prefix && input[input.length() - 1 - suffix] == newInput[newInput.length() - 1 - suffix]) ++suffix;
+        if (prefix == input.length() && input.length() == newInput.length())
+        {
+            restartPos = input.length();
+            executedSteps = 0;
+            syncPos = -1;
+            return;
+        }
+        int delta = (int)newInput.length() - (int)input.length();
+        int editEnd = newInput.length() - suffix;
+        input.swap(newInput);
+
+        // 保留修改处之前的检查点，之后的留着用来同步
+        size_t keep = 1;
+        while (keep < checkpoints.size() && checkpoints[keep].pos <= (int)prefix) ++keep;
+        vector<parseCheckpoint> old(make_move_iterator(checkpoints.begin() + keep), make_move_iterator(checkpoints.end()));
+        checkpoints.resize(keep);
+        run(old, editEnd, delta, steps);
+    }
+
+private:
+    void tokenize(const string& sentence, string& out)
+    {
+        if (table.lexer.stateCount > 0) lexSentence(table.lexer, sentence, out);
+        else markInvalid(table.classifier, out, scanInput(table.classifier, sentence, out));
+        out += '$';
+    }
+
+    // 从最后一个检查点开始分析；pos不小于editEnd后，遇到pos与旧检查点（位置加delta）相同且栈相同就同步
+    void run(vector<parseCheckpoint>& old, int editEnd, int delta, int oldSteps)
+    {
+        const runtimeTable& t = table;
+        // 分析中会往checkpoints里加检查点，不能留着指向最后一个的引用
+        vector<int> stack = checkpoints.back().stack;
+        int pos = checkpoints.back().pos, n = checkpoints.back().steps, startSteps = n;
+        restartPos = pos;
+        syncPos = -1;
+        size_t oi = 0;
+        while (true)
+        {
+            int s = stack.back();
+            unsigned char c = input[pos];
+            int a = c < 128 ? t.action[s * 128 + c] : 0;
+            ++n;
+            if (a == 0 || a == acceptAction)
+            {
+                accepted = a != 0;
+                break;
+            }
+            if (a > 0)
+            {
+                stack.push_back(a - 1);
+                ++pos;
+                // 越过修改处后尝试与旧的分析同步
+                while (oi < old.size() && old[oi].pos + delta < pos) ++oi;
+                if (pos >= editEnd && oi < old.size() && old[oi].pos + delta == pos && old[oi].stack == stack)
+                {
+                    syncPos = pos;
+                    executedSteps = n - startSteps;
+                    int shift = n - old[oi].steps;
+                    for (; oi < old.size(); ++oi)
+                    {
+                        old[oi].pos += delta;
+                        old[oi].steps += shift;
+                        checkpoints.push_back(move(old[oi]));
+                    }
+                    steps = oldSteps + shift;
+                    return;
+                }
+                if (pos - checkpoints.back().pos >= interval) checkpoints.push_back(parseCheckpoint{ pos, n, stack });
+            }
+            else
+            {
+                int gid = -a - 1;
+                stack.resize(stack.size() - t.prodLen[gid]);
+                int next = t.gotoTable[stack.back() * 128 + t.prodLeft[gid]];
+                if (next == -1)
+                {
+                    accepted = false;
+                    break;
+                }
+                stack.push_back(next);
+            }
+        }
+        executedSteps = n - startSteps;
+        steps = n;
+    }
+};
+
+/******************** 推送式分析 ***************************/
+// 网络、管道输入的文本分批到达：每送入一批就分析到用完为止，然后返回等下一批，不占用线程等待。
+// 分析状态（状态栈、切了一半的单词）都在对象里，一个线程可以轮流推进成千上万个分析
+
+enum pushStatus
+{
+    pushNeedMore, // 送入的都分析完了，等待更多输入
+    pushAccepted,
+    pushRejected
+};
+
+struct pushParser
+{
+    const runtimeTable* table;
+    segmentedStack<int> stateStack; // 分段分配，网络输入嵌套再深也不会一次申请大块内存
+    pushStatus status = pushNeedMore;
+    long long steps = 0;
+    long long consumed = 0; // 已移进的单词数
+    int errorState = -1; // 出错时的状态，用expectedString报告期望的终结符
+    bool tooDeep = false; // 因为嵌套超过上限而出错
+    // 词法分析的进度：pending从当前单词开头起，已有scanned个字节走过DFA
+    string pending;
+    size_t scanned = 0;
+    size_t lexEnd = 0; // 最后一次接受的位置
+    int lexState = 1;
+    int lexToken = 0;
+    string tokens; // 切分结果，复用
+
+    explicit pushParser(const runtimeTable& t, size_t nestingLimit = defaultNestingLimit) : table(&t)
+    {
+        stateStack.limit = nestingLimit;
+        stateStack.assign(1, 0);
+    }
+
+    // 送入切分好的单词（终结符字符），$为结束符；单词用完时返回pushNeedMore
+    pushStatus feed(const char* tok, size_t n)
+    {
+        if (status != pushNeedMore) return status;
+        const runtimeTable& t = *table;
+        for (size_t i = 0; i < n; ++i)
+        {
+            unsigned char c = tok[i];
+            // 一直归约到可以移进这个单词
+            while (true)
+            {
+                int s = stateStack.back();
+                int a = c < 128 ? t.action[s * 128 + c] : 0;
+                if (!t.validAction(a, stateStack.size())) a = 0;
+                ++steps;
+                if (a == acceptAction)
+                {
+                    status = pushAccepted;
+                    return status;
+                }
+                if (a == 0)
+                {
+                    errorState = s;
+                    status = pushRejected;
+                    return status;
+                }
+                if (a > 0)
+                {
+                    if (!stateStack.push_back(a - 1)) return overflow(s);
+                    ++consumed;
+                    break;
+                }
+                int gid = -a - 1;
+                stateStack.resize(stateStack.size() - t.prodLen[gid]);
+                int next = t.gotoTable[stateStack.back() * 128 + t.prodLeft[gid]];
+                if (!t.validGoto(next))
+                {
+                    errorState = stateStack.back();
+                    status = pushRejected;
+                    return status;
+                }
+                if (!stateStack.push_back(next)) return overflow(stateStack.back());
+            }
+        }
+        return status;
+    }
+
+    // 送入一段原文：有词法分析器时按最长匹配切分，末尾可能跨段的单词留到下一段；否则只去掉空白
+    pushStatus feedText(const char* text, size_t n)
+    {
+        if (status != pushNeedMore) return status;
+        tokens.clear();
+        pending.append(text, n);
+        if (table->lexer.stateCount > 0) lexPending(false);
+        else
+        {
+            markInvalid(table->classifier, tokens, scanInput(table->classifier, pending, tokens));
+            pending.clear();
+        }
+        return feed(tokens.data(), tokens.length());
+    }
+
+    // 输入结束：切出最后一个单词，送入结束符
+    pushStatus finish()
+    {
+        if (status != pushNeedMore) return status;
+        tokens.clear();
+        if (table->lexer.stateCount > 0) lexPending(true);
+        tokens += '$';
+        return feed(tokens.data(), tokens.length());
+    }
+
+private:
+    pushStatus overflow(int state)
+    {
+        errorState = state;
+        tooDeep = true;
+        status = pushRejected;
+        return status;
+    }
+
+    // 与lexSentence相同的最长匹配，但DFA走到pending末尾还没到死状态时停下，下一段接着走，不重新扫描
+    void lexPending(bool last)
+    {
+        const lexerTable& lexer = table->lexer;
+        const unsigned char* s = (const unsigned char*)pending.data();
+        size_t n = pending.length(), start = 0;
+        while (start < n)
+        {
+            for (; scanned < n && lexState != 0; ++scanned)
+            {
+                lexState = lexer.next[lexState * lexer.classCount + lexer.charClass[s[scanned]]];
+                if (lexState < 0 || lexState >= lexer.stateCount) lexState = 0;
+                int a = lexState != 0 ? lexer.accept[lexState] : 0;
+                if (a != 0)
+                {
+                    lexToken = a;
+                    lexEnd = scanned + 1;
+                }
+            }
+            // 后面的输入还可能让单词变长
+            if (lexState != 0 && !last) break;
+            if (lexEnd == start)
+            {
+                tokens += '\x7f';
+                lexEnd = start + 1;
+            }
+            else if (lexToken != -1) tokens += (char)lexToken;
+            start = lexEnd;
+            scanned = start;
+            lexState = 1;
+            lexToken = 0;
+        }
+        pending.erase(0, start);
+        scanned -= start;
+        lexEnd -= start;
+    }
+};
+
+#ifdef SLR_COROUTINE
+// 协程包装（C++20编译时才有）：分析写成普通的循环，没有输入时co_await挂起，送入输入后从挂起处继续
+struct parseTask
+{
+    // 挂起时送进来的一段原文，closed为输入结束
+    struct inputChunk
+    {
+        const char* data;
+        size_t size;
+        bool closed;
+    };
+
+    struct promise_type
+    {
+        inputChunk input = { nullptr, 0, false };
+        pushStatus status = pushNeedMore;
+        long long steps = 0;
+        bool tooDeep = false;
+
+        parseTask get_return_object() { return parseTask(coroutine_handle<promise_type>::from_promise(*this)); }
+        // 一开始就运行到第一次等待输入
+        suspend_never initial_suspend() noexcept { return {}; }
+        // 结束后不销毁，结果留给调用方读取
+        suspend_always final_suspend() noexcept { return {}; }
+        void return_value(const pushParser& parser)
+        {
+            status = parser.status;
+            steps = parser.steps;
+            tooDeep = parser.tooDeep;
+        }
+        void unhandled_exception() { throw; }
+    };
+
+    // co_await nextInput{} 挂起到下一次送入
+    struct nextInput
+    {
+        promise_type* promise = nullptr;
+        bool await_ready() noexcept { return false; }
+        void await_suspend(coroutine_handle<promise_type> h) noexcept { promise = &h.promise(); }
+        inputChunk await_resume() noexcept { return promise->input; }
+    };
+
+    coroutine_handle<promise_type> handle;
+
+    explicit parseTask(coroutine_handle<promise_type> h) : handle(h) {}
+    parseTask(parseTask&& o) noexcept : handle(o.handle) { o.handle = nullptr; }
+    parseTask& operator=(parseTask&& o) noexcept
+    {
+        if (this != &o)
+        {
+            if (handle) handle.destroy();
+            handle = o.handle;
+            o.handle = nullptr;
+        }
+        return *this;
+    }
+    parseTask(const parseTask&) = delete;
+    parseTask& operator=(const parseTask&) = delete;
+    ~parseTask()
+    {
+        if (handle) handle.destroy();
+    }
+
+    pushStatus feedText(const char* text, size_t n) { return resume(inputChunk{ text, n, false }); }
+    pushStatus finish() { return resume(inputChunk{ nullptr, 0, true }); }
+    long long steps() const { return handle.promise().steps; }
+    bool tooDeep() const { return handle.promise().tooDeep; }
+
+private:
+    pushStatus resume(inputChunk input)
+    {
+        if (handle.done()) return handle.promise().status;
+        handle.promise().input = input;
+        handle.resume();
+        return handle.done() ? handle.promise().status : pushNeedMore;
+    }
+};
+
+// 分析协程：状态都在协程帧里，挂起时不占线程
+parseTask parseCoroutine(const runtimeTable& t, size_t nestingLimit)
+{
+    pushParser parser(t, nestingLimit);
+    while (true)
+    {
+        parseTask::inputChunk input = co_await parseTask::nextInput{};
+        if (input.closed) parser.finish();
+        else parser.feedText(input.data, input.size);
+        if (parser.status != pushNeedMore) co_return parser;
+    }
+}
+
+// 流式分析用的分析器，C++20编译时经过协程包装
+typedef parseTask streamParser;
+streamParser openStream(const runtimeTable& t, size_t nestingLimit) { return parseCoroutine(t, nestingLimit); }
+long long streamSteps(const streamParser& p) { return p.steps(); }
+bool streamTooDeep(const streamParser& p) { return p.tooDeep(); }
+#else
+typedef pushParser streamParser;
+streamParser openStream(const runtimeTable& t, size_t nestingLimit) { return pushParser(t, nestingLimit); }
+long long streamSteps(const streamParser& p) { return p.steps; }
+bool streamTooDeep(const streamParser& p) { return p.tooDeep; }
+#endif
+
+
+/******************** GLR分析 ***************************/
+// 不是LR(1)文法时，在LALR(1)自动机上保留冲突格子里的所有动作，用图结构栈(GSS)同时走所有分支，
+// 结果是共享压缩分析森林(SPPF)。没有分叉时按普通LR分析，只有遇到冲突格子才转成GSS
+
+// 冲突格子在action中的编码，conflictBase - a为冲突动作列表的下标
+const int conflictBase = -(1 << 24);
+
+// GLR分析表：base是每格的第一个动作，冲突格子改成冲突编码
+struct glrTable
+{
+    runtimeTable base;
+    vector<vector<int>> conflicts;
+    bool hasEpsilon = false; // 有空产生式时，新加的边可能让同一层已处理过的结点产生新的归约路径
+};
+
+// 界面当前文法的GLR分析表
+glrTable grammarGLR;
+
+// 在LALR(1)向前看符号上构造GLR分析表，返回冲突格子数
+int buildGLRTable(grammarContext& ctx, glrTable& table)
+{
+    if (ctx.lalrLookahead.empty()) getLALR1Lookahead(ctx);
+    ctx.GLRVector.clear();
+    vector<SLRUnit> first;
+    vector<map<char, vector<string>>> cells;
+    for (const dfaState& ds : ctx.dfaStateVector)
+    {
+        map<char, vector<string>> cell;
+        SLRUnit slrunit = SLRUnit();
+        for (const auto& next : ds.nextStateVector)
+        {
+            if (isBigAlpha(next.c)) slrunit.m[next.c] = to_string(next.sid);
+            else cell[next.c].push_back("s" + to_string(next.sid));
+        }
+        for (int cellid : ds.cellV)
+        {
+            const dfaCell& dc = ctx.dfaCellVector[cellid];
+            const grammarUnit& gm = ctx.grammarDeque[dc.gid];
+            if (dc.index != rightLength(gm)) continue;
+            for (char ch : ctx.lalrLookahead[make_pair(ds.sid, dc.gid)])
+            {
+                vector<string>& actions = cell[ch];
+                string reduce = reduceAction(ctx, gm);
+                // 和移进冲突且声明了优先级的，按优先级只留一个（和LR分析表一致）
+                if (!actions.empty() && actions[0][0] == 's' && precedenceResolves(ctx, dc.gid, ch))
+                {
+                    int pp = productionPrecedence(ctx, dc.gid);
+                    const precUnit& tp = ctx.precedenceMap[ch];
+                    if (pp > tp.level || (pp == tp.level && tp.assoc == assocLeft)) actions[0] = reduce;
+                    else if (pp == tp.level && tp.assoc == assocNonassoc) actions.erase(actions.begin());
+                    continue;
+                }
+                if (find(actions.begin(), actions.end(), reduce) == actions.end()) actions.push_back(reduce);
+            }
+        }
+        SLRUnit shown = slrunit;
+        for (const auto& c : cell)
+        {
+            if (c.second.empty()) continue;
+            slrunit.m[c.first] = c.second[0];
+            string joined;
+            for (const auto& a : c.second) joined += (joined.empty() ? "" : "/") + a;
+            shown.m[c.first] = joined;
+        }
+        first.push_back(slrunit);
+        ctx.GLRVector.push_back(shown);
+        cells.push_back(cell);
+    }
+
+    table = glrTable();
+    table.base = buildRuntimeTable(ctx, first);
+    for (size_t i = 0; i < cells.size(); ++i)
+    {
+        for (const auto& c : cells[i])
+        {
+            if (c.second.size() < 2) continue;
+            // 冲突动作用运行时的整数编码，复用base对单个动作的解析结果
+            vector<int> actions;
+            for (const auto& a : c.second)
+            {
+                SLRUnit one;
+                one.m[c.first] = a;
+                runtimeTable single = buildRuntimeTable(ctx, vector<SLRUnit>(1, one));
+                actions.push_back(single.action[(unsigned char)c.first]);
+            }
+            table.base.action.edit(i * 128 + (unsigned char)c.first) = conflictBase - (int)table.conflicts.size();
+            table.conflicts.push_back(actions);
+        }
+    }
+    for (const auto& g : ctx.grammarDeque)
+    {
+        if (rightLength(g) == 0) table.hasEpsilon = true;
+    }
+    return table.conflicts.size();
+}
+
+// SPPF结点：终结符叶子没有alternatives，非终结符的每种分析是一个(文法编号, 孩子)
+struct sppfNode
+{
+    char symbol;
+    int start; // 覆盖的单词区间[start, end)
+    int end;
+    vector<pair<int, vector<sppfNode*>>> alternatives;
+};
+
+struct gssNode;
+
+// GSS的边，tree是这条边对应的分析森林结点
+struct gssEdge
+{
+    gssNode* to;
+    sppfNode* tree;
+};
+
+struct gssNode
+{
+    int state;
+    int level; // 所在的单词位置
+    vector<gssEdge> edges;
+};
+
+// 一次GLR分析的结果
+struct glrResult
+{
+    bool accepted = false;
+    sppfNode* root = nullptr;
+    int errorPos = -1; // 所有分支都失败的单词位置
+    int forkPos = -1; // 第一次遇到冲突格子的位置，-1表示全程是确定的LR分析
+    int gssNodes = 0;
+    int sppfNodes = 0;
+};
+
+// GLR分析器，GSS和SPPF结点都放在deque里，地址不变，一个句子分析完整体释放
+struct glrParser
+{
+    const glrTable* g = nullptr;
+    deque<gssNode> gss;
+    deque<sppfNode> forest;
+    string input;
+    int pos = 0;
+    // 当前层：按状态找结点
+    vector<gssNode*> byState;
+    vector<gssNode*> frontier;
+    // 当前层的非终结符结点，按(符号, 起点)共享
+    map<pair<char, int>, sppfNode*> levelTrees;
+    // 待处理的归约：(结点, 文法编号, 只走哪条边，-1为所有边)
+    struct reduction
+    {
+        gssNode* node;
+        int gid;
+        int edge;
+    };
+    vector<reduction> reductions;
+    vector<pair<gssNode*, int>> shifts;
+    vector<gssNode*> acceptNodes;
+
+    sppfNode* newTree(char symbol, int start, int end)
+    {
+        forest.push_back(sppfNode{ symbol, start, end, {} });
+        return &forest.back();
+    }
+
+    gssNode* newNode(int state, int level)
+    {
+        gss.push_back(gssNode{ state, level, {} });
+        return &gss.back();
+    }
+
+    // 第gid条产生式归约出的结点，同一层同一符号同一起点的共享，并去掉重复的分析
+    sppfNode* reducedTree(int gid, int start, const vector<sppfNode*>& children)
+    {
+        char A = g->base.prodLeft[gid];
+        sppfNode*& t = levelTrees[make_pair(A, start)];
+        if (t == nullptr) t = newTree(A, start, pos);
+        for (const auto& alt : t->alternatives)
+        {
+            if (alt.first == gid && alt.second == children) return t;
+        }
+        t->alternatives.push_back(make_pair(gid, children));
+        return t;
+    }
+
+    // 结点v在当前向前看符号下的动作，edge不为-1时只加经过这条边的归约
+    void addActions(gssNode* v, int edge)
+    {
+        const runtimeTable& t = g->base;
+        int a = t.action[v->state * 128 + (unsigned char)input[pos]];
+        const int* list = &a;
+        int count = 1;
+        if (a <= conflictBase)
+        {
+            const vector<int>& c = g->conflicts[conflictBase - a];
+            list = c.data();
+            count = c.size();
+        }
+        for (int i = 0; i < count; ++i)
+        {
+            int x = list[i];
+            if (x == 0) continue;
+            if (x == acceptAction)
+            {
+                if (edge == -1) acceptNodes.push_back(v);
+            }
+            else if (x > 0)
+            {
+                if (edge == -1) shifts.push_back(make_pair(v, x - 1));
+            }
+            else
+            {
+                int gid = -x - 1;
+                if (t.prodLen[gid] == 0 && edge != -1) continue;
+                reductions.push_back({ v, gid, edge });
+            }
+        }
+    }
+
+    // 从v出发长度为len的所有路径，对每条路径调用f(路径终点, 孩子)
+    template <class F>
+    void forEachPath(gssNode* v, int len, int edge, F f)
+    {
+        vector<sppfNode*> children(len);
+        // 显式栈：(结点, 深度, 下一条边)
+        vector<pair<gssNode*, pair<int, size_t>>> st;
+        st.push_back(make_pair(v, make_pair(0, edge == -1 ? (size_t)0 : (size_t)edge)));
+        while (!st.empty())
+        {
+            gssNode* u = st.back().first;
+            int depth = st.back().second.first;
+            size_t& k = st.back().second.second;
+            if (depth == len)
+            {
+                f(u, children);
+                st.pop_back();
+                continue;
+            }
+            // 第一条边被限定时只走那一条
+            size_t limit = depth == 0 && edge != -1 ? (size_t)edge + 1 : u->edges.size();
+            if (k >= limit)
+            {
+                st.pop_back();
+                continue;
+            }
+            const gssEdge& e = u->edges[k++];
+            children[len - 1 - depth] = e.tree;
+            st.push_back(make_pair(e.to, make_pair(depth + 1, (size_t)0)));
+        }
+    }
+
+    // 沿一条路径归约到w：找到或新建goto状态的结点，加边
+    void reduceTo(gssNode* w, int gid, const vector<sppfNode*>& children)
+    {
+        const runtimeTable& t = g->base;
+        int k = t.gotoTable[w->state * 128 + t.prodLeft[gid]];
+        if (k == -1) return;
+        sppfNode* tree = reducedTree(gid, w->level, children);
+        gssNode* u = byState[k];
+        if (u == nullptr)
+        {
+            u = byState[k] = newNode(k, pos);
+            frontier.push_back(u);
+            u->edges.push_back(gssEdge{ w, tree });
+            addActions(u, -1);
+            return;
+        }
+        for (const auto& e : u->edges)
+        {
+            if (e.to == w) return;
+        }
+        u->edges.push_back(gssEdge{ w, tree });
+        addActions(u, u->edges.size() - 1);
+        // 有空产生式时，经过空归约得到的结点的路径也可能用到这条新边，重新处理本层的归约（重复的会被去掉）
+        if (g->hasEpsilon)
+        {
+            for (gssNode* x : frontier)
+            {
+                if (x == u) continue;
+                for (size_t i = 0; i < x->edges.size(); ++i)
+                {
+                    if (x->edges[i].to->level == pos) addActions(x, i);
+                }
+            }
+        }
+    }
+
+    // 处理当前层的所有归约
+    void reduceAll()
+    {
+        while (!reductions.empty())
+        {
+            reduction r = reductions.back();
+            reductions.pop_back();
+            int len = g->base.prodLen[r.gid];
+            if (len == 0)
+            {
+                reduceTo(r.node, r.gid, vector<sppfNode*>());
+                continue;
+            }
+            forEachPath(r.node, len, r.edge, [&](gssNode* w, const vector<sppfNode*>& children)
+            {
+                reduceTo(w, r.gid, children);
+            });
+        }
+    }
+
+    // 接受：沿开始符号产生式的路径回到栈底
+    sppfNode* acceptTree(gssNode* v)
+    {
+        const runtimeTable& t = g->base;
+        sppfNode* root = nullptr;
+        forEachPath(v, t.prodLen[t.acceptGid], -1, [&](gssNode* w, const vector<sppfNode*>& children)
+        {
+            if (w->level != 0 || !w->edges.empty()) return;
+            // 增广的^->S不建结点
+            root = t.startSymbol == '^' ? children[0] : reducedTree(t.acceptGid, 0, children);
+        });
+        return root;
+    }
+
+    bool parse(const glrTable& table, const string& sentence, glrResult& r)
+    {
+        g = &table;
+        const runtimeTable& t = table.base;
+        gss.clear();
+        forest.clear();
+        r = glrResult();
+        if (t.lexer.stateCount > 0) lexSentence(t.lexer, sentence, input);
+        else markInvalid(t.classifier, input, scanInput(t.classifier, sentence, input));
+        input += '$';
+        pos = 0;
+
+        // 确定性阶段：普通LR分析，直到遇到冲突格子
+        vector<pair<int, sppfNode*>> stack(1, make_pair(0, (sppfNode*)nullptr));
+        while (true)
+        {
+            int a = t.action[stack.back().first * 128 + (unsigned char)input[pos]];
+            if (a <= conflictBase) break;
+            if (a == 0)
+            {
+                r.errorPos = pos;
+                return finish(r);
+            }
+            if (a == acceptAction)
+            {
+                vector<sppfNode*> children;
+                for (size_t i = stack.size() - t.prodLen[t.acceptGid]; i < stack.size(); ++i) children.push_back(stack[i].second);
+                levelTrees.clear();
+                r.root = t.startSymbol == '^' ? children[0] : reducedTree(t.acceptGid, 0, children);
+                r.accepted = true;
+                return finish(r);
+            }
+            if (a > 0)
+            {
+                stack.push_back(make_pair(a - 1, newTree(input[pos], pos, pos + 1)));
+                ++pos;
+                continue;
+            }
+            int gid = -a - 1;
+            int len = t.prodLen[gid];
+            vector<sppfNode*> children(len);
+            for (int i = 0; i < len; ++i) children[i] = stack[stack.size() - len + i].second;
+            int start = len == 0 ? pos : children[0]->start;
+            stack.resize(stack.size() - len);
+            sppfNode* tree = newTree(t.prodLeft[gid], start, pos);
+            tree->alternatives.push_back(make_pair(gid, move(children)));
+            int next = t.gotoTable[stack.back().first * 128 + t.prodLeft[gid]];
+            if (next == -1)
+            {
+                r.errorPos = pos;
+                return finish(r);
+            }
+            stack.push_back(make_pair(next, tree));
+        }
+
+        // 把LR栈转成一条GSS链，之后按层同时处理所有分支
+        r.forkPos = pos;
+        gssNode* top = newNode(0, 0);
+        for (size_t i = 1; i < stack.size(); ++i)
+        {
+            gssNode* u = newNode(stack[i].first, stack[i].second->end);
+            u->edges.push_back(gssEdge{ top, stack[i].second });
+            top = u;
+        }
+        byState.assign(t.stateCount, nullptr);
+        frontier.assign(1, top);
+        byState[top->state] = top;
+        while (true)
+        {
+            levelTrees.clear();
+            reductions.clear();
+            shifts.clear();
+            acceptNodes.clear();
+            for (size_t i = 0; i < frontier.size(); ++i) addActions(frontier[i], -1);
+            reduceAll();
+            for (gssNode* v : frontier) byState[v->state] = nullptr;
+            if (input[pos] == '$')
+            {
+                // 多个接受结点只会得到同一个根（共享的SPPF结点）
+                for (gssNode* v : acceptNodes)
+                {
+                    sppfNode* root = acceptTree(v);
+                    if (root != nullptr) r.root = root;
+                }
+                r.accepted = r.root != nullptr;
+                if (!r.accepted) r.errorPos = pos;
+                return finish(r);
+            }
+            if (shifts.empty())
+            {
+                r.errorPos = pos;
+                return finish(r);
+            }
+            // 移进到下一层，同一状态合并成一个结点
+            sppfNode* leaf = newTree(input[pos], pos, pos + 1);
+            ++pos;
+            frontier.clear();
+            for (const auto& sh : shifts)
+            {
+                gssNode*& u = byState[sh.second];
+                if (u == nullptr)
+                {
+                    u = newNode(sh.second, pos);
+                    frontier.push_back(u);
+                }
+                u->edges.push_back(gssEdge{ sh.first, leaf });
+            }
+        }
+    }
+
+    bool finish(glrResult& r)
+    {
+        r.gssNodes = gss.size();
+        r.sppfNodes = forest.size();
+        return r.accepted;
+    }
+};
+
+// 分析森林中的分析树个数（有环时为无穷），以及有多种分析的结点数
+double countTrees(sppfNode* root, int& ambiguous)
+{
+    ambiguous = 0;
+    map<sppfNode*, double> count;
+    set<sppfNode*> visiting;
+    // 显式栈的后序遍历：(结点, 是否已展开)
+    vector<pair<sppfNode*, bool>> st;
+    st.push_back(make_pair(root, false));
+    while (!st.empty())
+    {
+        sppfNode* n = st.back().first;
+        bool expanded = st.back().second;
+        st.pop_back();
+        if (!expanded)
+        {
+            if (count.count(n)) continue;
+            if (visiting.count(n))
+            {
+                count[n] = numeric_limits<double>::infinity();
+                continue;
+            }
+            visiting.insert(n);
+            st.push_back(make_pair(n, true));
+            for (const auto& alt : n->alternatives)
+            {
+                for (sppfNode* c : alt.second) st.push_back(make_pair(c, false));
+            }
+            continue;
+        }
+        visiting.erase(n);
+        if (n->alternatives.size() > 1) ++ambiguous;
+        double total = n->alternatives.empty() ? 1 : 0;
+        for (const auto& alt : n->alternatives)
+        {
+            double product = 1;
+            for (sppfNode* c : alt.second)
+            {
+                auto it = count.find(c);
+                product *= it == count.end() ? numeric_limits<double>::infinity() : it->second;
+            }
+            total += product;
+        }
+        count[n] = total;
+    }
+    return count[root];
+}
+
+// 分析森林转成括号形式，只展开每个结点的第一种分析，有多种分析的结点标出个数，如E{2}(...)
+string sppfToString(const sppfNode* root, size_t limit)
+{
+    string out;
+    vector<pair<const sppfNode*, int>> st;
+    st.push_back(make_pair(root, 0));
+    while (!st.empty() && out.length() < limit)
+    {
+        const sppfNode* n = st.back().first;
+        int& k = st.back().second;
+        if (k == 0)
+        {
+            if (!out.empty() && out.back() != '(') out += ' ';
+            out += n->symbol;
+            if (n->alternatives.empty())
+            {
+                st.pop_back();
+                continue;
+            }
+            if (n->alternatives.size() > 1) out += "{" + to_string(n->alternatives.size()) + "}";
+            // 空串归约
+            out += n->alternatives[0].second.empty() ? "(@" : "(";
+        }
+        const vector<sppfNode*>& children = n->alternatives[0].second;
+        if (k < (int)children.size())
+        {
+            st.push_back(make_pair(children[k++], 0));
+            continue;
+        }
+        out += ')';
+        st.pop_back();
+    }
+    if (!st.empty()) out += "...";
+    return out;
+}
+
+
+/******************** yacc文法导入 ***************************/
+// 一遍流式读取bison/yacc的.y文件（声明段和规则段），转成一行一个产生式的文法格式
+// 符号名映射成单个字符：非终结符用A-Z，终结符优先用字面字符，其余依次分配空闲的可见字符
+// 因此只能导入最多26个非终结符、约65个终结符的文法，几百条规则的生产级文法（如C语言的文法）导入不了，
+// 要支持需要把各阶段的单字符符号（集合、项目、分析表、表文件）都改成整数编号，没有做
+
+// 词法单元类型
+enum yaccTokenType
+{
+    yIdent, // 名字
+    yChar, // 'x'
+    yString, // "xx"
+    yColon,
+    yBar,
+    ySemi,
+    yMark, // %%
+    yDirective, // %token等
+    yAction, // {...}或<type>，忽略
+    yEnd,
+    yOther
+};
+
+struct yaccToken
+{
+    yaccTokenType type;
+    string text;
+};
+
+// .y文件的词法分析，只向前看一个字符
+struct yaccReader
+{
+    istream& in;
+    int line = 1;
+    vector<yaccToken> pending; // 回退的词法单元，后进先出
+
+    yaccReader(istream& s) : in(s) {}
+
+    int get()
+    {
+        int c = in.get();
+        if (c == '\n') ++line;
+        return c;
+    }
+
+    // 跳过配对的括号，其中的字符串和字符常量不计括号
+    void skipBlock(char open, char close)
+    {
+        int depth = 1;
+        int c;
+        while (depth > 0 && (c = get()) != EOF)
+        {
+            if (c == open) ++depth;
+            else if (c == close) --depth;
+            else if (open == '{' && (c == '"' || c == '\''))
+            {
+                int q = c;
+                while ((c = get()) != EOF && c != q && c != '\n')
+                {
+                    if (c == '\\') get();
+                }
+            }
+        }
+    }
+
+    void unget(const yaccToken& t)
+    {
+        pending.push_back(t);
+    }
+
+    yaccToken next()
+    {
+        if (!pending.empty())
+        {
+            yaccToken t = pending.back();
+            pending.pop_back();
+            return t;
+        }
+        int c;
+        while (true)
+        {
+            c = get();
+            if (c == EOF) return { yEnd, "" };
+            if (isspace(c)) continue;
+            // 注释
+            if (c == '/' && in.peek() == '*')
+            {
+                get();
+                int prev = 0;
+                while ((c = get()) != EOF && !(prev == '*' && c == '/')) prev = c;
+                continue;
+            }
+            if (c == '/' && in.peek() == '/')
+            {
+                while ((c = get()) != EOF && c != '\n');
+                continue;
+            }
+            break;
+        }
+        if (isalpha(c) || c == '_' || c == '.')
+        {
+            string name(1, (char)c);
+            while (isalnum(in.peek()) || in.peek() == '_' || in.peek() == '.') name += (char)get();
+            return { yIdent, name };
+        }
+        if (c == '\'' || c == '"')
+        {
+            int q = c;
+            string text;
+            while ((c = get()) != EOF && c != q && c != '\n')
+            {
+                if (c == '\\')
+                {
+                    c = get();
+                    if (c == 'n') c = '\n';
+                    else if (c == 't') c = '\t';
+                }
+                text += (char)c;
+            }
+            return { q == '\'' ? yChar : yString, text };
+        }
+        if (c == '%')
+        {
+            if (in.peek() == '%')
+            {
+                get();
+                return { yMark, "%%" };
+            }
+            if (in.peek() == '{')
+            {
+                // %{ ... %} 代码段
+                get();
+                int prev = 0;
+                while ((c = get()) != EOF && !(prev == '%' && c == '}')) prev = c;
+                return next();
+            }
+            string name = "%";
+            while (isalnum(in.peek()) || in.peek() == '_' || in.peek() == '-') name += (char)get();
+            return { yDirective, name };
+        }
+        if (c == '{')
+        {
+            skipBlock('{', '}');
+            return { yAction, "{}" };
+        }
+        if (c == '<')
+        {
+            skipBlock('<', '>');
+            return { yAction, "<>" };
+        }
+        if (c == ':') return { yColon, ":" };
+        if (c == '|') return { yBar, "|" };
+        if (c == ';') return { ySemi, ";" };
+        return { yOther, string(1, (char)c) };
+    }
+};
+
+// 导入时的符号
+struct yaccSymbol
+{
+    string name;
+    bool literal = false; // 'x'形式的单字符终结符
+    bool nonTerminal = false; // 出现在规则左部
+    int precLevel = 0;
+    string assoc;
+    char ch = 0; // 映射后的字符
+};
+
+// 导入时的产生式
+struct yaccRule
+{
+    int left;
+    vector<int> right;
+    int prec = -1; // %prec指定的符号
+};
+
+// 能作为终结符的字符（$是结束符，@是空串，^是增广开始符号）
+bool isFreeTerminalChar(char c)
+{
+    return c > ' ' && c < 127 && !isBigAlpha(c) && c != '$' && c != '@' && c != '^';
+}
+
+// 导入yacc文法，成功时out为文法文本，失败时error为原因
+bool importYaccGrammar(istream& in, string& out, string& error)
+{
+    yaccReader reader(in);
+    vector<yaccSymbol> symbols;
+    map<string, int> symbolId;
+    vector<yaccRule> rules;
+    string startName;
+
+    auto getSymbol = [&](const yaccToken& t) -> int
+    {
+        string key = t.type == yIdent ? t.text : "'" + t.text + "'";
+        auto it = symbolId.find(key);
+        if (it != symbolId.end()) return it->second;
+        yaccSymbol sym;
+        sym.name = key;
+        sym.literal = t.type != yIdent && t.text.length() == 1;
+        symbolId[key] = symbols.size();
+        symbols.push_back(sym);
+        return symbols.size() - 1;
+    };
+
+    // 声明段
+    string directive;
+    int level = 0;
+    yaccToken t;
+    while ((t = reader.next()).type != yMark)
+    {
+        if (t.type == yEnd)
+        {
+            error = "没有找到规则段（%%）";
+            return false;
+        }
+        if (t.type == yDirective)
+        {
+            directive = t.text;
+            if (directive == "%left" || directive == "%right" || directive == "%nonassoc" || directive == "%precedence") ++level;
+            continue;
+        }
+        if (t.type != yIdent && t.type != yChar && t.type != yString) continue;
+        if (directive == "%start")
+        {
+            startName = t.text;
+        }
+        else if (directive == "%token")
+        {
+            getSymbol(t);
+        }
+        else if (directive == "%left" || directive == "%right" || directive == "%nonassoc" || directive == "%precedence")
+        {
+            yaccSymbol& sym = symbols[getSymbol(t)];
+            sym.precLevel = level;
+            sym.assoc = directive == "%left" || directive == "%right" ? directive : "%nonassoc";
+        }
+    }
+
+    // 规则段：名字 : 候选式 | 候选式 ;
+    while ((t = reader.next()).type != yEnd && t.type != yMark)
+    {
+        if (t.type == ySemi) continue;
+        if (t.type != yIdent || reader.next().type != yColon)
+        {
+            error = "第" + to_string(reader.line) + "行：规则应为“非终结符 : 候选式”";
+            return false;
+        }
+        yaccRule rule;
+        rule.left = getSymbol(t);
+        symbols[rule.left].nonTerminal = true;
+        if (startName.empty()) startName = t.text;
+
+        bool ruleEnd = false;
+        while (!ruleEnd)
+        {
+            yaccToken x = reader.next();
+            switch (x.type)
+            {
+            case yIdent:
+            {
+                // 省略分号时，“名字 :”是下一条规则
+                yaccToken after = reader.next();
+                reader.unget(after);
+                if (after.type == yColon)
+                {
+                    reader.unget(x);
+                    ruleEnd = true;
+                }
+                else rule.right.push_back(getSymbol(x));
+                break;
+            }
+            case yChar:
+            case yString:
+                rule.right.push_back(getSymbol(x));
+                break;
+            case yDirective:
+                if (x.text == "%prec") rule.prec = getSymbol(reader.next());
+                break;
+            case yBar:
+                rules.push_back(rule);
+                rule.right.clear();
+                rule.prec = -1;
+                break;
+            case yMark:
+            case yEnd:
+                reader.unget(x);
+                ruleEnd = true;
+                break;
+            case ySemi:
+                ruleEnd = true;
+                break;
+            default:
+                // 语义动作、%empty等忽略
+                break;
+            }
+        }
+        rules.push_back(rule);
+    }
+    if (rules.empty())
+    {
+        error = "规则段为空";
+        return false;
+    }
+    if (!symbolId.count(startName) || !symbols[symbolId[startName]].nonTerminal)
+    {
+        error = "开始符号" + startName + "没有规则";
+        return false;
+    }
+
+    // 文法里每个符号是一个字符：非终结符只有A-Z，终结符是其余可见字符，超过时无法导入
+    int nonTerminalCount = 0;
+    for (const auto& sym : symbols) nonTerminalCount += sym.nonTerminal;
+    if (nonTerminalCount > 26)
+    {
+        error = "有" + to_string(nonTerminalCount) + "个非终结符，单字符文法最多26个（A-Z）";
+        return false;
+    }
+
+    // 分配字符：先满足字面字符，再尽量用名字首字母
+    set<char> used;
+    for (auto& sym : symbols)
+    {
+        if (!sym.nonTerminal && sym.literal && isFreeTerminalChar(sym.name[1]) && !used.count(sym.name[1]))
+        {
+            sym.ch = sym.name[1];
+            used.insert(sym.ch);
+        }
+    }
+    // 开始符号放在最前面
+    vector<int> order;
+    order.push_back(symbolId[startName]);
+    for (int i = 0; i < (int)symbols.size(); ++i)
+    {
+        if (i != order[0]) order.push_back(i);
+    }
+    for (int i : order)
+    {
+        yaccSymbol& sym = symbols[i];
+        if (sym.ch != 0) continue;
+        char first = sym.literal ? sym.name[1] : sym.name[0] == '\'' ? 0 : sym.name[0];
+        if (sym.nonTerminal)
+        {
+            char c = toupper(first);
+            if (!isBigAlpha(c) || used.count(c))
+            {
+                for (c = 'A'; c <= 'Z' && used.count(c); ++c);
+            }
+            sym.ch = c;
+        }
+        else
+        {
+            char c = tolower(first);
+            if (!isFreeTerminalChar(c) || used.count(c))
+            {
+                for (c = 33; c < 127 && (!isFreeTerminalChar(c) || used.count(c)); ++c);
+            }
+            if (c >= 127)
+            {
+                error = "有" + to_string(symbols.size() - nonTerminalCount) + "个终结符，超过单字符文法可用的字符数";
+                return false;
+            }
+            sym.ch = c;
+        }
+        used.insert(sym.ch);
+    }
+
+    // 输出：符号对照、优先级声明、产生式（开始符号的产生式在前）
+    ostringstream oss;
+    oss << "# 由yacc文法导入：" << rules.size() << "条产生式\n";
+    for (const auto& sym : symbols)
+    {
+        if (sym.name != string(1, sym.ch) && sym.name != "'" + string(1, sym.ch) + "'")
+        {
+            oss << "# " << sym.ch << " = " << sym.name << "\n";
+        }
+    }
+    for (int lv = 1; lv <= level; ++lv)
+    {
+        string line;
+        for (const auto& sym : symbols)
+        {
+            if (sym.precLevel != lv) continue;
+            if (line.empty()) line = sym.assoc;
+            line += string(" ") + sym.ch;
+        }
+        if (!line.empty()) oss << line << "\n";
+    }
+    if (symbolId.count("error")) oss << "%error " << symbols[symbolId["error"]].ch << "\n";
+    int start = symbolId[startName];
+    for (int pass = 0; pass < 2; ++pass)
+    {
+        for (const auto& rule : rules)
+        {
+            if ((rule.left == start) != (pass == 0)) continue;
+            oss << symbols[rule.left].ch << "->";
+            if (rule.right.empty()) oss << "@";
+            for (int x : rule.right) oss << symbols[x].ch;
+            if (rule.prec != -1) oss << " %prec " << symbols[rule.prec].ch;
+            oss << "\n";
+        }
+    }
+    out = oss.str();
+    return true;
+}
+
+
+/*清空上下文中的全部分析结果*/
+void reset(grammarContext& ctx)
+{
+    ctx = grammarContext();
+}
+
+/******************** 按需生成自动机 ***************************/
+// 很大的文法每次只用到一小部分时，不预先生成整个LR(0)自动机：开始只有初始状态，
+// 分析器第一次走到某个状态时才求闭包、转移和SLR(1)动作，生成后保存起来，之后（包括其他线程）直接使用
+
+// 没有界面时读入文法并求First、Follow集合，文法有错时返回false
+bool prepareGrammar(grammarContext& ctx, const string& grammarText, string& error)
+{
+    allocPhase phase(phaseGrammar);
+    reset(ctx);
+    ctx.quiet = true;
+    ctx.grammarStr = grammarText;
+    handleGrammar(ctx);
+    if (!ctx.errors.empty() || ctx.grammarDeque.empty())
+    {
+        error = ctx.errors.empty() ? "文法为空" : ctx.errors.front();
+        return false;
+    }
+    pruneGrammar(ctx);
+    phase.enter(phaseFirstFollow);
+    getFirstSets(ctx);
+    getFollowSets(ctx);
+    return true;
+}
+
+// 一个状态的动作和goto，编码同runtimeTable，生成后不再修改
+struct lazyRow
+{
+    int action[128];
+    int gotoRow[128];
+};
+
+struct lazyAutomaton
+{
+    static const int blockBits = 10; // 每块1024个状态
+    static const int maxBlocks = 4096;
+
+    // 分析时只读
+    vector<char> prodLeft;
+    vector<int> prodLen;
+    inputClassifier classifier;
+    lexerTable lexer;
+
+    lazyAutomaton()
+    {
+        for (auto& b : blocks) b.store(nullptr, memory_order_relaxed);
+    }
+
+    ~lazyAutomaton()
+    {
+        for (auto& b : blocks)
+        {
+            atomic<const lazyRow*>* block = b.load(memory_order_relaxed);
+            if (block == nullptr) continue;
+            for (int i = 0; i < 1 << blockBits; ++i) delete block[i].load(memory_order_relaxed);
+            delete[] block;
+        }
+    }
+
+    lazyAutomaton(const lazyAutomaton&) = delete;
+    lazyAutomaton& operator=(const lazyAutomaton&) = delete;
+
+    // 读入文法，只创建初始状态
+    bool prepare(const string& grammarText, string& error)
+    {
+        if (!prepareGrammar(ctx, grammarText, error)) return false;
+        allocPhase phase(phaseLR0);
+        ctx.followSets['^'].s.insert('$');
+        createFirstState(ctx);
+        ensureBlock(0);
+        // 终结符直接从文法中收集，不必等所有状态生成
+        bitset<128> terminals;
+        for (const auto& g : ctx.grammarDeque)
+        {
+            prodLeft.push_back(g.left);
+            prodLen.push_back(rightLength(g));
+            if (g.right == "@") continue;
+            for (char c : g.right)
+            {
+                if (isBigAlpha(c)) ctx.VN.insert(c);
+                else
+                {
+                    ctx.VT.insert(c);
+                    if ((unsigned char)c < 128) terminals.set((unsigned char)c);
+                }
+            }
+        }
+        classifier = makeClassifier(terminals);
+        lexer = ctx.grammarLexer;
+        return true;
+    }
+
+    // 状态s的动作，第一次用到时生成；已生成的直接读，不加锁
+    const lazyRow* row(int s)
+    {
+        const lazyRow* r = slot(s).load(memory_order_acquire);
+        return r != nullptr ? r : expand(s);
+    }
+
+    // 已经生成动作的状态数、已知的状态数（包括还没展开的）、没有用优先级解决的冲突数
+    int expandedCount()
+    {
+        lock_guard<mutex> guard(lock);
+        return expanded;
+    }
+
+    int knownCount()
+    {
+        lock_guard<mutex> guard(lock);
+        return ctx.dfaStateVector.size();
+    }
+
+    int conflictCount()
+    {
+        lock_guard<mutex> guard(lock);
+        return conflicts;
+    }
+
+    // 展开还没展开的状态，导出完整的分析表之前用；状态数超过上限时返回false
+    bool expandAll()
+    {
+        for (int s = 0; s < knownCount(); ++s)
+        {
+            if (row(s) == nullptr) return false;
+        }
+        return true;
+    }
+
+    // 把已经生成的部分导出成普通分析表，没展开过的状态没有动作（导出文件前先expandAll）
+    runtimeTable snapshot()
+    {
+        lock_guard<mutex> guard(lock);
+        vector<SLRUnit> rows = ctx.SLRVector;
+        rows.resize(ctx.dfaStateVector.size());
+        return buildRuntimeTable(ctx, rows);
+    }
+
+    // 导出分析表文件要用文法
+    const grammarContext& grammar() const { return ctx; }
+
+private:
+    mutex lock; // 生成状态时持有
+    grammarContext ctx; // 持有lock时才能修改
+    int expanded = 0;
+    int conflicts = 0;
+    // 按状态号分块存放的行，块和行都只增加，读的时候不加锁
+    atomic<atomic<const lazyRow*>*> blocks[maxBlocks];
+
+    atomic<const lazyRow*>& slot(int s)
+    {
+        return blocks[s >> blockBits].load(memory_order_acquire)[s & ((1 << blockBits) - 1)];
+    }
+
+    // 新状态的块必须在它的编号出现在某一行之前分配好，读的线程才能看到
+    bool ensureBlock(int s)
+    {
+        int b = s >> blockBits;
+        if (b >= maxBlocks) return false;
+        if (blocks[b].load(memory_order_relaxed) != nullptr) return true;
+        atomic<const lazyRow*>* block = new atomic<const lazyRow*>[1 << blockBits];
+        for (int i = 0; i < 1 << blockBits; ++i) block[i].store(nullptr, memory_order_relaxed);
+        blocks[b].store(block, memory_order_release);
+        return true;
+    }
+
+    const lazyRow* expand(int s)
+    {
+        lock_guard<mutex> guard(lock);
+        // 等锁期间可能已经被其他线程生成了
+        const lazyRow* r = slot(s).load(memory_order_relaxed);
+        if (r != nullptr) return r;
+        allocPhase phase(phaseLR0);
+        expandLR0State(ctx, s);
+        for (const auto& next : ctx.dfaStateVector[s].nextStateVector)
+        {
+            if (!ensureBlock(next.sid)) return nullptr;
+        }
+        phase.enter(phaseTable);
+        SLRUnit unit;
+        conflicts += fillSLRRow(ctx, ctx.dfaStateVector[s], unit);
+        lazyRow* made = new lazyRow;
+        fill(made->action, made->action + 128, 0);
+        fill(made->gotoRow, made->gotoRow + 128, -1);
+        encodeRow(ctx, unit, made->action, made->gotoRow);
+        if ((int)ctx.SLRVector.size() <= s) ctx.SLRVector.resize(s + 1);
+        ctx.SLRVector[s] = unit;
+        ++expanded;
+        slot(s).store(made, memory_order_release);
+        return made;
+    }
+};
+
+// 用按需生成的自动机分析一个句子，遇到第一个错误就停止
+bool parseLazy(lazyAutomaton& a, const string& sentence, int& steps, parseWorkspace& ws)
+{
+    string& input = ws.input;
+    steps = 0;
+    ws.tooDeep = false;
+    if ((a.lexer.stateCount > 0 ? lexSentence(a.lexer, sentence, input) : scanInput(a.classifier, sentence, input)) >= 0)
+    {
+        return false;
+    }
+    input += '$';
+    segmentedStack<int>& stateStack = ws.stateStack;
+    stateStack.limit = ws.nestingLimit;
+    stateStack.assign(1, 0);
+    const lazyRow* row = a.row(0);
+    int pos = 0;
+    while (row != nullptr)
+    {
+        unsigned char c = input[pos];
+        int act = c < 128 ? row->action[c] : 0;
+        ++steps;
+        if (act == 0) return false;
+        if (act == acceptAction) return true;
+        if (act > 0)
+        {
+            if (!stateStack.push_back(act - 1))
+            {
+                ws.tooDeep = true;
+                return false;
+            }
+            ++pos;
+        }
+        else
+        {
+            int gid = -act - 1;
+            stateStack.resize(stateStack.size() - a.prodLen[gid]);
+            // 栈中的状态都已经生成过
+            int next = a.row(stateStack.back())->gotoRow[(unsigned char)a.prodLeft[gid]];
+            if (next == -1) return false;
+            if (!stateStack.push_back(next))
+            {
+                ws.tooDeep = true;
+                return false;
+            }
+        }
+        row = a.row(stateStack.back());
+    }
+    // 状态数超过上限
+    return false;
+}
+
+/******************** 分析表文件 ***************************/
+// 分析表导出为二进制文件。载入时把整个文件只读映射，各数组直接指向映射的内存，不做任何解析，
+// 只检查文件头、各段的位置和产生式，所以载入时间与状态数无关，多个进程映射同一个文件时共享同一份物理页
+// 动作和goto表项不在载入时逐项检查，分析时用到哪项检查哪项（runtimeTable::validAction）；--verify时载入就全部检查
+// 文件内只用相对文件头的偏移（可以映射到任意地址），各段按64字节对齐；数据按本机字节序写，载入时检查
+// 各段都是整数和字节数组，不直接写bitset、bool等布局由编译器决定的类型
+
+const char tableFileMagic[8] = { 'S', 'L', 'R', 'T', 'A', 'B', 'L', 'E' };
+const uint32_t tableFileVersion = 2;
+const uint32_t tableFileByteOrder = 0x01020304;
+const size_t tableFileAlign = 64;
+
+// 文件中的各段
+enum tableSectionId
+{
+    sectionAction, // int32[stateCount * 128]
+    sectionGoto, // int32[stateCount * 128]
+    sectionProdLeft, // char[productionCount]
+    sectionProdLen, // int32[productionCount]
+    sectionExpected, // uint64[stateCount][2]，即charBits
+    sectionFollow, // uint64[128][2]
+    sectionTerminals, // uint64[2]，输入中可以出现的终结符，载入时由它重建inputClassifier
+    sectionLexerClass, // unsigned char[256]
+    sectionLexerNext, // int32[lexerStates * lexerClasses]
+    sectionLexerAccept, // int32[lexerStates]
+    sectionRuleIndex, // uint32[productionCount + 1]，每条产生式文本在sectionRuleText中的起始位置
+    sectionRuleText, // 产生式文本，如E->E+T
+    sectionSymbols, // 终结符、非终结符，各以'\0'结尾
+    sectionCount
+};
+
+struct tableSection
+{
+    uint64_t offset;
+    uint64_t size;
+};
+
+// 文件头，放在文件开始
+struct tableFileHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t headerSize; // 结构大小，编译器布局不同时对不上
+    uint32_t byteOrder; // 写入tableFileByteOrder，字节序不同时读出来不相等
+    uint32_t stateCount;
+    uint32_t productionCount;
+    int32_t acceptGid;
+    int32_t unitEliminated;
+    int32_t lexerStates;
+    int32_t lexerClasses;
+    char startSymbol;
+    char errorSymbol;
+    char reserved[2];
+    uint64_t fileSize;
+    uint64_t checksum; // 文件头之后所有字节的FNV-1a，只在要求校验时计算
+    tableSection sections[sectionCount];
+};
+
+// FNV-1a散列
+uint64_t tableChecksum(const unsigned char* data, size_t size)
+{
+    uint64_t h = 14695981039346656037ULL;
+    for (size_t i = 0; i < size; ++i)
+    {
+        h ^= data[i];
+        h *= 1099511628211ULL;
+    }
+    return h;
+}
+
+// 把当前文法的分析表写成分析表文件，产生式文本和符号取自当前文法
+bool saveTableFile(const grammarContext& ctx, const runtimeTable& t, const string& path, string& error)
+{
+    tableFileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, tableFileMagic, sizeof(header.magic));
+    header.version = tableFileVersion;
+    header.headerSize = sizeof(header);
+    header.byteOrder = tableFileByteOrder;
+    header.stateCount = t.stateCount;
+    header.productionCount = t.prodLeft.size();
+    header.acceptGid = t.acceptGid;
+    header.unitEliminated = t.unitEliminated;
+    header.lexerStates = t.lexer.stateCount;
+    header.lexerClasses = t.lexer.classCount;
+    header.startSymbol = t.startSymbol;
+    header.errorSymbol = t.errorSymbol;
+
+    vector<uint32_t> ruleIndex;
+    string ruleText;
+    for (const auto& g : ctx.grammarDeque)
+    {
+        ruleIndex.push_back(ruleText.length());
+        ruleText += string(1, g.left) + "->" + g.right;
+    }
+    ruleIndex.push_back(ruleText.length());
+    string symbols;
+    for (char c : ctx.VT) symbols += c;
+    symbols += '\0';
+    for (char c : ctx.VN) symbols += c;
+    symbols += '\0';
+
+    // 文件头之后依次放各段
+    vector<unsigned char> body;
+    auto addSection = [&](tableSectionId id, const void* data, size_t size)
+    {
+        size_t offset = (sizeof(header) + body.size() + tableFileAlign - 1) / tableFileAlign * tableFileAlign;
+        body.resize(offset - sizeof(header), 0);
+        const unsigned char* p = (const unsigned char*)data;
+        body.insert(body.end(), p, p + size);
+        header.sections[id].offset = offset;
+        header.sections[id].size = size;
+    };
+    addSection(sectionAction, t.action.data(), t.action.size() * sizeof(int));
+    addSection(sectionGoto, t.gotoTable.data(), t.gotoTable.size() * sizeof(int));
+    addSection(sectionProdLeft, t.prodLeft.data(), t.prodLeft.size());
+    addSection(sectionProdLen, t.prodLen.data(), t.prodLen.size() * sizeof(int));
+    charBits terminals;
+    for (int c = 0; c < 128; ++c)
+    {
+        if (t.classifier.isTerminal[c]) terminals.set(c);
+    }
+    addSection(sectionExpected, t.expected.data(), t.expected.size() * sizeof(charBits));
+    addSection(sectionFollow, t.followBits.data(), t.followBits.size() * sizeof(charBits));
+    addSection(sectionTerminals, terminals.w, sizeof(terminals.w));
+    addSection(sectionLexerClass, t.lexer.charClass, sizeof(t.lexer.charClass));
+    addSection(sectionLexerNext, t.lexer.next.data(), t.lexer.next.size() * sizeof(int));
+    addSection(sectionLexerAccept, t.lexer.accept.data(), t.lexer.accept.size() * sizeof(int));
+    addSection(sectionRuleIndex, ruleIndex.data(), ruleIndex.size() * sizeof(uint32_t));
+    addSection(sectionRuleText, ruleText.data(), ruleText.length());
+    addSection(sectionSymbols, symbols.data(), symbols.length());
+    header.fileSize = sizeof(header) + body.size();
+    header.checksum = tableChecksum(body.data(), body.size());
+
+    ofstream file(path, ios::binary | ios::trunc);
+    file.write((const char*)&header, sizeof(header));
+    file.write((const char*)body.data(), body.size());
+    if (!file)
+    {
+        error = "无法写入分析表文件" + path;
+        return false;
+    }
+    return true;
+}
+
+// 映射载入的分析表，table()的数组指向映射的内存，析构时解除映射
+// 只给出const引用，读的时候不会复制，文件本身也不会被改动
+struct mappedTable
+{
+    uint64_t fileSize = 0;
+
+    mappedTable() {}
+    mappedTable(const mappedTable&) = delete;
+    mappedTable& operator=(const mappedTable&) = delete;
+    ~mappedTable() { unload(); }
+
+    // 检查文件头、各段的位置和大小以及产生式，用时与状态数无关；
+    // verify为true时再校验整个文件的散列、逐项检查动作和goto表（不检查时分析中用到的表项会检查）
+    bool load(const string& path, bool verify, string& error)
+    {
+        unload();
+        file.reset(new QFile(QString::fromLocal8Bit(path.c_str())));
+        if (!file->open(QIODevice::ReadOnly))
+        {
+            error = "无法打开分析表文件" + path;
+            return false;
+        }
+        fileSize = file->size();
+        if (fileSize < sizeof(tableFileHeader))
+        {
+            error = "不是分析表文件";
+            return false;
+        }
+        base = file->map(0, fileSize);
+        if (base == nullptr)
+        {
+            error = "无法映射分析表文件" + path;
+            return false;
+        }
+        if (!check(verify, error) || !checkRules(error) || (verify && !checkEntries(error)))
+        {
+            unload();
+            return false;
+        }
+
+        const tableFileHeader& h = header();
+        runtimeTable& table = loaded;
+        table = runtimeTable();
+        table.stateCount = h.stateCount;
+        table.acceptGid = h.acceptGid;
+        table.unitEliminated = h.unitEliminated;
+        table.startSymbol = h.startSymbol;
+        table.errorSymbol = h.errorSymbol;
+        table.action.borrow(section<int>(sectionAction), h.stateCount * 128);
+        table.gotoTable.borrow(section<int>(sectionGoto), h.stateCount * 128);
+        table.prodLeft.borrow(section<char>(sectionProdLeft), h.productionCount);
+        table.prodLen.borrow(section<int>(sectionProdLen), h.productionCount);
+        table.expected.borrow(section<charBits>(sectionExpected), h.stateCount);
+        table.followBits.borrow(section<charBits>(sectionFollow), 128);
+        // 定长的小结构直接复制
+        const uint64_t* w = section<uint64_t>(sectionTerminals);
+        bitset<128> terminals;
+        for (int c = 0; c < 128; ++c) terminals[c] = w[c >> 6] >> (c & 63) & 1;
+        table.classifier = makeClassifier(terminals);
+        memcpy(table.lexer.charClass, section<char>(sectionLexerClass), sizeof(table.lexer.charClass));
+        table.lexer.stateCount = h.lexerStates;
+        table.lexer.classCount = h.lexerClasses;
+        table.lexer.dfaCount = h.lexerStates;
+        table.lexer.next.borrow(section<int>(sectionLexerNext), h.lexerStates * h.lexerClasses);
+        table.lexer.accept.borrow(section<int>(sectionLexerAccept), h.lexerStates);
+        return true;
+    }
+
+    const runtimeTable& table() const { return loaded; }
+
+    void unload()
+    {
+        loaded = runtimeTable();
+        if (file && base) file->unmap(base);
+        base = nullptr;
+        file.reset();
+    }
+
+    // 按文法编号取产生式文本
+    string rule(int gid) const
+    {
+        const uint32_t* index = section<uint32_t>(sectionRuleIndex);
+        return string(section<char>(sectionRuleText) + index[gid], index[gid + 1] - index[gid]);
+    }
+    string terminals() const { return section<char>(sectionSymbols); }
+    string nonterminals() const
+    {
+        const char* s = section<char>(sectionSymbols);
+        return s + strlen(s) + 1;
+    }
+
+private:
+    const tableFileHeader& header() const { return *(const tableFileHeader*)base; }
+    template <class T>
+    const T* section(tableSectionId id) const { return (const T*)(base + header().sections[id].offset); }
+
+    bool check(bool verify, string& error) const
+    {
+        const tableFileHeader& h = header();
+        if (memcmp(h.magic, tableFileMagic, sizeof(h.magic)) != 0)
+        {
+            error = "不是分析表文件";
+            return false;
+        }
+        if (h.version != tableFileVersion)
+        {
+            error = "分析表文件版本为" + to_string(h.version) + "，只支持版本" + to_string(tableFileVersion);
+            return false;
+        }
+        if (h.byteOrder != tableFileByteOrder || h.headerSize != sizeof(tableFileHeader))
+        {
+            error = "分析表文件由字节序或结构布局不同的程序生成";
+            return false;
+        }
+        if (h.fileSize != fileSize)
+        {
+            error = "分析表文件不完整";
+            return false;
+        }
+        // 各段的大小必须和文件头里的数量一致，且都在文件内
+        uint64_t states = h.stateCount, productions = h.productionCount;
+        uint64_t lexerStates = h.lexerStates < 0 ? 0 : h.lexerStates, lexerClasses = h.lexerClasses < 0 ? 0 : h.lexerClasses;
+        const uint64_t expectedSize[sectionCount] = {
+            states * 128 * sizeof(int), states * 128 * sizeof(int), productions, productions * sizeof(int),
+            states * sizeof(charBits), 128 * sizeof(charBits), sizeof(charBits), 256,
+            lexerStates * lexerClasses * sizeof(int), lexerStates * sizeof(int), (productions + 1) * sizeof(uint32_t),
+            h.sections[sectionRuleText].size, h.sections[sectionSymbols].size
+        };
+        for (int i = 0; i < sectionCount; ++i)
+        {
+            const tableSection& s = h.sections[i];
+            if (s.size != expectedSize[i] || s.offset % tableFileAlign != 0 || s.offset < sizeof(tableFileHeader)
+                || s.offset > fileSize || s.size > fileSize - s.offset)
+            {
+                error = "分析表文件第" + to_string(i) + "段损坏";
+                return false;
+            }
+        }
+        if (states == 0 || h.acceptGid < 0 || (uint64_t)h.acceptGid >= productions
+            || (lexerStates > 0 && lexerStates < 2))
+        {
+            error = "分析表文件内容不合法";
+            return false;
+        }
+        const char* symbols = section<char>(sectionSymbols);
+        size_t symbolBytes = h.sections[sectionSymbols].size;
+        if (symbolBytes < 2 || symbols[symbolBytes - 1] != '\0' || memchr(symbols, '\0', symbolBytes - 1) == nullptr)
+        {
+            error = "分析表文件符号段损坏";
+            return false;
+        }
+        const uint32_t* index = section<uint32_t>(sectionRuleIndex);
+        if (index[productions] != h.sections[sectionRuleText].size)
+        {
+            error = "分析表文件产生式段损坏";
+            return false;
+        }
+        if (verify && tableChecksum(base + sizeof(tableFileHeader), fileSize - sizeof(tableFileHeader)) != h.checksum)
+        {
+            error = "分析表文件校验失败";
+            return false;
+        }
+        return true;
+    }
+
+    // 各段大小已经检查过；产生式和词法分析器的字符类在分析时直接用作下标，载入时检查（与状态数无关）
+    bool checkRules(string& error) const
+    {
+        const tableFileHeader& h = header();
+        int productions = h.productionCount;
+        const char* prodLeft = section<char>(sectionProdLeft);
+        const int* prodLen = section<int>(sectionProdLen);
+        const uint32_t* index = section<uint32_t>(sectionRuleIndex);
+        for (int g = 0; g < productions; ++g)
+        {
+            // 产生式文本是“左部->右部”，右部长度不会超过文本长度
+            if (index[g] > index[g + 1] || (unsigned char)prodLeft[g] >= 128 || prodLen[g] < 0
+                || (uint64_t)prodLen[g] + 3 > index[g + 1] - index[g])
+            {
+                error = "分析表文件第" + to_string(g) + "条产生式损坏";
+                return false;
+            }
+        }
+        if ((unsigned char)h.startSymbol >= 128 || (unsigned char)h.errorSymbol >= 128)
+        {
+            error = "分析表文件内容不合法";
+            return false;
+        }
+        if (h.lexerStates <= 0) return true;
+        const unsigned char* charClass = section<unsigned char>(sectionLexerClass);
+        bool lexerOk = h.lexerClasses > 0;
+        for (int c = 0; c < 256 && lexerOk; ++c) lexerOk = charClass[c] < h.lexerClasses;
+        if (!lexerOk)
+        {
+            error = "分析表文件词法分析表损坏";
+            return false;
+        }
+        return true;
+    }
+
+    // 逐项检查动作、goto和词法分析器的转移（--verify），用时与表的大小成正比
+    bool checkEntries(string& error) const
+    {
+        const tableFileHeader& h = header();
+        int states = h.stateCount, productions = h.productionCount;
+        const int* action = section<int>(sectionAction);
+        const int* gotoTable = section<int>(sectionGoto);
+        for (size_t i = 0, n = (size_t)states * 128; i < n; ++i)
+        {
+            int a = action[i], g = gotoTable[i];
+            bool actionOk = a == 0 || a == acceptAction || (a > 0 && a <= states) || (a < 0 && -(long long)a <= productions);
+            if (!actionOk || g < -1 || g >= states)
+            {
+                error = "分析表文件状态" + to_string(i / 128) + "的表项损坏";
+                return false;
+            }
+        }
+        int lexerStates = h.lexerStates, lexerClasses = h.lexerClasses;
+        if (lexerStates <= 0) return true;
+        const int* next = section<int>(sectionLexerNext);
+        const int* accept = section<int>(sectionLexerAccept);
+        bool lexerOk = true;
+        for (size_t i = 0, n = (size_t)lexerStates * lexerClasses; i < n && lexerOk; ++i) lexerOk = next[i] >= 0 && next[i] < lexerStates;
+        for (int s = 0; s < lexerStates && lexerOk; ++s) lexerOk = accept[s] >= -1 && accept[s] < 128;
+        if (!lexerOk)
+        {
+            error = "分析表文件词法分析表损坏";
+            return false;
+        }
+        return true;
+    }
+
+    runtimeTable loaded;
+    unique_ptr<QFile> file;
+    unsigned char* base = nullptr;
+};
+
+/******************** 批量分析 ***************************/
+// 批量分析的统计结果
+struct batchResult
+{
+    long long sentences = 0;
+    long long accepted = 0;
+    long long steps = 0;
+    long long symbols = 0; // 输入的字符数
+    int threads = 0;
+    double ms = 0;
+};
+
+// 批量分析中每个句子的结果
+enum batchOutcome : char
+{
+    outcomeRejected,
+    outcomeAccepted,
+    outcomeTooDeep // 嵌套超过上限
+};
+
+// 多线程批量分析：分析表只读共享，每个线程有自己的栈和内存池
+// 句子按块领取，results不为空时按下标记录每句的结果（batchOutcome）
+batchResult parseBatch(const runtimeTable& t, const vector<string>& sentences, int threadCount, bool buildTree,
+    vector<char>* results, lazyAutomaton* lazy = nullptr, size_t nestingLimit = defaultNestingLimit)
+{
+    if (threadCount <= 0) threadCount = max(1u, thread::hardware_concurrency());
+    if (results) results->assign(sentences.size(), 0);
+
+    const size_t chunk = 256;
+    atomic<size_t> next(0);
+    vector<batchResult> partial(threadCount);
+    auto worker = [&](int id)
+    {
+        parseWorkspace ws;
+        ws.nestingLimit = nestingLimit;
+        treeArena arena;
+        allocPhase phase(phaseParse);
+        // 计数先放在局部变量里，最后再写回，避免线程间伪共享
+        long long accepted = 0, steps = 0, symbols = 0;
+        while (true)
+        {
+            size_t begin = next.fetch_add(chunk);
+            if (begin >= sentences.size()) break;
+            size_t end = min(begin + chunk, sentences.size());
+            for (size_t i = begin; i < end; ++i)
+            {
+                int n = 0;
+                bool ok;
+                if (lazy != nullptr)
+                {
+                    ok = parseLazy(*lazy, sentences[i], n, ws);
+                }
+                else if (buildTree)
+                {
+                    treeNode* root = nullptr;
+                    arena.clear();
+                    ok = parseSentenceImpl<true>(t, sentences[i], n, nullptr, nullptr, &arena, &root, ws);
+                }
+                else
+                {
+                    ok = parseSentenceImpl<false>(t, sentences[i], n, nullptr, nullptr, nullptr, nullptr, ws);
+                }
+                if (ok) ++accepted;
+                if (results) (*results)[i] = ok ? outcomeAccepted : ws.tooDeep ? outcomeTooDeep : outcomeRejected;
+                steps += n;
+                symbols += sentences[i].length();
+            }
+        }
+        partial[id].accepted = accepted;
+        partial[id].steps = steps;
+        partial[id].symbols = symbols;
+    };
+
+    auto start = chrono::steady_clock::now();
+    vector<thread> pool;
+    for (int i = 1; i < threadCount; ++i) pool.emplace_back(worker, i);
+    worker(0);
+    for (auto& th : pool) th.join();
+
+    batchResult r;
+    r.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    r.threads = threadCount;
+    r.sentences = sentences.size();
+    for (const auto& p : partial)
+    {
+        r.accepted += p.accepted;
+        r.steps += p.steps;
+        r.symbols += p.symbols;
+    }
+    return r;
+}
+
+// 流式分析：同时有window个句子在分析中，每轮给每个句子送入chunk字节，在一个线程里交替推进
+batchResult streamBatch(const runtimeTable& t, const vector<string>& sentences, size_t chunk, size_t window,
+    vector<char>* results, size_t nestingLimit = defaultNestingLimit)
+{
+    if (results) results->assign(sentences.size(), 0);
+    batchResult r;
+    r.threads = 1;
+    r.sentences = sentences.size();
+    auto start = chrono::steady_clock::now();
+    allocPhase phase(phaseParse);
+
+    // 分析中的句子：下标、已送入的字节数和分析器
+    vector<size_t> active, sent;
+    vector<streamParser> parsers;
+    size_t next = 0;
+    while (next < sentences.size() || !active.empty())
+    {
+        while (active.size() < window && next < sentences.size())
+        {
+            active.push_back(next++);
+            sent.push_back(0);
+            parsers.push_back(openStream(t, nestingLimit));
+        }
+        for (size_t k = 0; k < active.size(); )
+        {
+            const string& s = sentences[active[k]];
+            size_t n = min(chunk, s.length() - sent[k]);
+            pushStatus status = n > 0 ? parsers[k].feedText(s.data() + sent[k], n) : parsers[k].finish();
+            sent[k] += n;
+            if (status == pushNeedMore)
+            {
+                ++k;
+                continue;
+            }
+            // 分析完的句子用最后一个代替
+            r.accepted += status == pushAccepted;
+            r.steps += streamSteps(parsers[k]);
+            r.symbols += s.length();
+            if (results)
+            {
+                (*results)[active[k]] = status == pushAccepted ? outcomeAccepted
+                    : streamTooDeep(parsers[k]) ? outcomeTooDeep : outcomeRejected;
+            }
+            active[k] = active.back();
+            active.pop_back();
+            sent[k] = sent.back();
+            sent.pop_back();
+            swap(parsers[k], parsers.back());
+            parsers.pop_back();
+        }
+    }
+    r.ms = chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+    return r;
+}
+
+// 输出一次批量分析的吞吐量
+void printBatchResult(const batchResult& r)
+{
+    double seconds = r.ms / 1000;
+    cout << r.threads << "线程：" << r.sentences << "句，接受" << r.accepted << "句，共" << r.steps << "步，用时"
+        << (long long)r.ms << "ms，" << (long long)(seconds > 0 ? r.sentences / seconds : 0) << "句/秒，"
+        << (long long)(seconds > 0 ? r.symbols / seconds / 1e3 : 0) << "K字符/秒" << endl;
+}
+
+// 输入预处理的吞吐量：每种实现把全部句子处理若干遍，并和标量版本的结果对比
+void scanBenchmark(const runtimeTable& t, const vector<string>& sentences)
+{
+    long long bytes = 0;
+    for (const auto& s : sentences) bytes += s.length();
+    int rounds = max(1LL, 200000000LL / max(1LL, bytes));
+    vector<string> expected(sentences.size());
+    vector<int> expectedBad(sentences.size());
+    for (size_t i = 0; i < sentences.size(); ++i) expectedBad[i] = scanInput(t.classifier, sentences[i], expected[i], scanScalar);
+
+    string out;
+    for (int level = scanScalar; level <= currentScanLevel; ++level)
+    {
+        bool same = true;
+        long long kept = 0;
+        auto start = chrono::steady_clock::now();
+        for (int r = 0; r < rounds; ++r)
+        {
+            for (size_t i = 0; i < sentences.size(); ++i)
+            {
+                int bad = scanInput(t.classifier, sentences[i], out, (scanLevel)level);
+                kept += out.length();
+                if (r == 0 && (bad != expectedBad[i] || out != expected[i])) same = false;
+            }
+        }
+        double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+        cout << "输入预处理（" << scanLevelName((scanLevel)level) << "）：" << (long long)(bytes * rounds / seconds / 1e6)
+            << "MB/秒，保留" << kept / rounds << "个字符" << (same ? "" : "，结果与标量版本不一致！") << endl;
+    }
+}
+
+// 没有界面时从文法文本生成运行时分析表（依次尝试SLR(1)、LALR(1)、LR(1)），文法有错或都不是时返回false
+bool compileGrammar(grammarContext& ctx, const string& grammarText, runtimeTable& table, string& error,
+    string* kind = nullptr)
+{
+    if (!prepareGrammar(ctx, grammarText, error)) return false;
+    allocPhase phase(phaseLR0);
+    getLR0(ctx);
+    phase.enter(phaseTable);
+    const vector<SLRUnit>* chosen = chooseParseTable(ctx);
+    if (chosen == nullptr)
+    {
+        error = "该文法不是LR(1)文法，无法分析句子";
+        return false;
+    }
+    phase.enter(phaseRuntime);
+    table = buildRuntimeTable(ctx, *chosen);
+    if (kind) *kind = chosen == &ctx.SLRVector ? "SLR(1)" : chosen == &ctx.LALRVector ? "LALR(1)" : "LR(1)";
+    return true;
+}
+
+// --alloc-report输出各阶段的内存分配，--alloc-budget按文件检查上限（每行：阶段 最多次数 最多字节数，#开头为注释）
+// 超出上限时返回3，否则返回原来的结果
+int checkAllocations(bool report, const string& budgetPath, int status)
+{
+    if (!report && budgetPath.empty()) return status;
+#ifndef SLR_COUNT_ALLOCATIONS
+    cerr << "编译时没有定义SLR_COUNT_ALLOCATIONS，无法统计内存分配" << endl;
+    return 2;
+#else
+    if (report)
+    {
+        for (int i = 0; i < phaseCount; ++i)
+        {
+            cout << "内存分配 " << allocPhaseNames[i] << "：" << allocCount[i] << "次，" << allocBytes[i] << "字节" << endl;
+        }
+    }
+    if (budgetPath.empty()) return status;
+    ifstream budgetFile(budgetPath);
+    if (!budgetFile)
+    {
+        cerr << "无法打开内存分配上限文件" << budgetPath << endl;
+        return 2;
+    }
+    bool over = false;
+    string line;
+    while (getline(budgetFile, line))
+    {
+        istringstream iss(line);
+        string name;
+        long long maxCount, maxBytes;
+        if (!(iss >> name) || name[0] == '#') continue;
+        int phase = find(allocPhaseNames, allocPhaseNames + phaseCount, name) - allocPhaseNames;
+        if (phase == phaseCount || !(iss >> maxCount >> maxBytes))
+        {
+            cerr << "内存分配上限文件格式错误：" << line << endl;
+            return 2;
+        }
+        if (allocCount[phase] > maxCount || allocBytes[phase] > maxBytes)
+        {
+            cerr << "阶段" << name << "分配了" << allocCount[phase] << "次、" << allocBytes[phase] << "字节，超出上限"
+                << maxCount << "次、" << maxBytes << "字节" << endl;
+            over = true;
+        }
+    }
+    return over ? 3 : status;
+#endif
+}
+
+// 读入文法文件，.y/.yy按yacc文法导入
+bool readGrammarFile(const string& path, string& grammarText, string& error)
+{
+    ifstream grammarFile(path);
+    if (!grammarFile)
+    {
+        error = "无法打开文法文件" + path;
+        return false;
+    }
+    if (path.length() > 2 && (path.substr(path.length() - 2) == ".y"
+        || path.substr(path.length() - 3) == ".yy"))
+    {
+        if (!importYaccGrammar(grammarFile, grammarText, error))
+        {
+            error = "yacc文法导入失败：" + error;
+            return false;
+        }
+        return true;
+    }
+    stringstream buffer;
+    buffer << grammarFile.rdbuf();
+    grammarText = buffer.str();
+    return true;
+}
+
+// 命令行批量分析（不启动界面）
+// 用法：--batch 文法文件 句子文件 [-j 线程数] [--tree] [--scale] [--scan-bench] [--save-table 分析表文件] [--verify]
+//       [--alloc-report] [--alloc-budget 上限文件] [--lazy]
+// 句子文件每行一句，-表示标准输入；--scale从1线程开始成倍增加线程数，对比加速比
+// --scan-bench先测输入预处理（去空白、检查非法字符）各实现的吞吐量
+// 文法文件以.slrt结尾时直接映射之前用--save-table导出的分析表，不再生成；--verify载入时校验整个文件的散列并逐项检查表项
+// --lazy按需生成SLR(1)自动机，只生成句子用到的状态（不支持--tree、--scan-bench），--save-table导出分析后已生成的部分
+int batchMain(int argc, char* argv[])
+{
+    grammarContext ctx;
+    if (argc < 4)
+    {
+        cerr << "用法：" << argv[0] << " --batch 文法文件 句子文件 [-j 线程数] [--tree] [--scale] [--scan-bench]"
+            << " [--save-table 分析表文件] [--verify] [--alloc-report] [--alloc-budget 上限文件] [--lazy] [--minimize]"
+            << " [--stream 每次送入字节数] [--max-depth 最大嵌套深度]" << endl;
+        return 2;
+    }
+    int threadCount = 0;
+    bool buildTree = false, scale = false, scanBench = false, verify = false, allocReport = false, lazyMode = false;
+    bool minimize = false;
+    int streamChunk = 0;
+    size_t nestingLimit = defaultNestingLimit;
+    string savePath, budgetPath;
+    for (int i = 4; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threadCount = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--tree") == 0) buildTree = true;
+        else if (strcmp(argv[i], "--scale") == 0) scale = true;
+        else if (strcmp(argv[i], "--scan-bench") == 0) scanBench = true;
+        else if (strcmp(argv[i], "--save-table") == 0 && i + 1 < argc) savePath = argv[++i];
+        else if (strcmp(argv[i], "--verify") == 0) verify = true;
+        else if (strcmp(argv[i], "--alloc-report") == 0) allocReport = true;
+        else if (strcmp(argv[i], "--lazy") == 0) lazyMode = true;
+        else if (strcmp(argv[i], "--minimize") == 0) minimize = true;
+        else if (strcmp(argv[i], "--stream") == 0 && i + 1 < argc) streamChunk = max(1, atoi(argv[++i]));
+        else if (strcmp(argv[i], "--max-depth") == 0 && i + 1 < argc) nestingLimit = max(1LL, atoll(argv[++i]));
+        else if (strcmp(argv[i], "--alloc-budget") == 0 && i + 1 < argc) budgetPath = argv[++i];
+    }
+
+    string grammarText, error;
+    string grammarPath = argv[2];
+    mappedTable mapped;
+    runtimeTable built;
+    lazyAutomaton lazy;
+    bool fromFile = grammarPath.length() > 5 && grammarPath.substr(grammarPath.length() - 5) == ".slrt";
+    if (fromFile)
+    {
+        auto start = chrono::steady_clock::now();
+        if (!mapped.load(grammarPath, verify, error))
+        {
+            cerr << error << endl;
+            return 2;
+        }
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        cout << "映射分析表文件" << grammarPath << "（" << mapped.fileSize << "字节），用时" << (long long)us << "微秒" << endl;
+    }
+    else
+    {
+        if (!readGrammarFile(grammarPath, grammarText, error))
+        {
+            cerr << error << endl;
+            return 2;
+        }
+
+        auto start = chrono::steady_clock::now();
+        if (lazyMode ? !lazy.prepare(grammarText, error) : !compileGrammar(ctx, grammarText, built, error))
+        {
+            cerr << error << endl;
+            return 1;
+        }
+        double us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+        cout << (lazyMode ? "按需模式读入文法" : "生成分析表") << "用时" << (long long)us << "微秒" << endl;
+        if (minimize && !lazyMode)
+        {
+            int before = built.stateCount;
+            start = chrono::steady_clock::now();
+            int removed = minimizeStates(built);
+            us = chrono::duration<double, micro>(chrono::steady_clock::now() - start).count();
+            // 每个状态一行action、一行goto和expected
+            size_t rowBytes = 128 * sizeof(int) * 2 + sizeof(charBits);
+            cout << "状态最小化：" << before << "个状态合并为" << built.stateCount << "个，减少" << removed << "个（"
+                << (before == 0 ? 0 : removed * 1000 / before / 10.0) << "%），分析表" << before * rowBytes / 1024
+                << "KB→" << built.stateCount * rowBytes / 1024 << "KB，用时" << (long long)us << "微秒" << endl;
+        }
+        if (!savePath.empty() && !lazyMode)
+        {
+            if (!saveTableFile(ctx, built, savePath, error))
+            {
+                cerr << error << endl;
+                return 2;
+            }
+            cout << "分析表已导出到" << savePath << endl;
+        }
+    }
+    // 生成后冻结，各线程只读
+    const runtimeTable& frozen = fromFile ? mapped.table() : built;
+
+    vector<string> sentences;
+    ifstream sentenceFile;
+    if (strcmp(argv[3], "-") != 0)
+    {
+        sentenceFile.open(argv[3]);
+        if (!sentenceFile)
+        {
+            cerr << "无法打开句子文件" << argv[3] << endl;
+            return 2;
+        }
+    }
+    istream& in = strcmp(argv[3], "-") == 0 ? cin : sentenceFile;
+    string line;
+    while (getline(in, line))
+    {
+        if (!line.empty() && line.back() == '\r') line.pop_back();
+        if (!line.empty()) sentences.push_back(line);
+    }
+    lazyMode = lazyMode && !fromFile;
+    if (lazyMode) cout << "按需生成分析表，读入" << sentences.size() << "句" << endl;
+    else cout << "分析表" << frozen.stateCount << "个状态，读入" << sentences.size() << "句" << endl;
+    if (scanBench && !lazyMode) scanBenchmark(frozen, sentences);
+
+    if (scale)
+    {
+        int maxThreads = threadCount > 0 ? threadCount : max(1u, thread::hardware_concurrency());
+        double base = 0;
+        for (int n = 1; ; n = min(n * 2, maxThreads))
+        {
+            batchResult r = parseBatch(frozen, sentences, n, buildTree, nullptr, lazyMode ? &lazy : nullptr, nestingLimit);
+            if (n == 1) base = r.ms;
+            printBatchResult(r);
+            cout << "  加速比" << (int)(r.ms > 0 ? base / r.ms * 100 : 0) / 100.0 << endl;
+            if (n == maxThreads) break;
+        }
+        return checkAllocations(allocReport, budgetPath, 0);
+    }
+    vector<char> results;
+    batchResult r;
+    if (streamChunk > 0 && !lazyMode)
+    {
+        const size_t window = 4096;
+        cout << "流式分析：同时分析" << min(window, sentences.size()) << "句，每次送入" << streamChunk << "字节"
+#ifdef SLR_COROUTINE
+            << "（协程）"
+#endif
+            << endl;
+        r = streamBatch(frozen, sentences, streamChunk, window, &results, nestingLimit);
+    }
+    else r = parseBatch(frozen, sentences, threadCount, buildTree, &results, lazyMode ? &lazy : nullptr, nestingLimit);
+    printBatchResult(r);
+    if (lazyMode)
+    {
+        cout << "按需生成了" << lazy.expandedCount() << "个状态（已知" << lazy.knownCount() << "个）";
+        if (lazy.conflictCount() > 0) cout << "，有" << lazy.conflictCount() << "处冲突没有用优先级解决，该文法不是SLR(1)文法";
+        cout << endl;
+        if (!savePath.empty())
+        {
+            // 文件里的表要完整：没展开的状态载入后会把合法的句子当成错误，有冲突的行也不能用
+            if (!lazy.expandAll())
+            {
+                cerr << "状态数超过上限，无法导出分析表" << endl;
+                return 2;
+            }
+            if (lazy.conflictCount() > 0)
+            {
+                cerr << "有" << lazy.conflictCount() << "处冲突没有用优先级解决，不导出分析表" << endl;
+                return 2;
+            }
+            if (!saveTableFile(lazy.grammar(), lazy.snapshot(), savePath, error))
+            {
+                cerr << error << endl;
+                return 2;
+            }
+            cout << "展开全部" << lazy.expandedCount() << "个状态，分析表已导出到" << savePath << endl;
+        }
+    }
+    // 列出前几个不接受的句子，嵌套超过上限的单独说明
+    int shown = 0;
+    long long tooDeep = count(results.begin(), results.end(), (char)outcomeTooDeep);
+    if (tooDeep > 0) cout << "有" << tooDeep << "句嵌套超过上限" << nestingLimit << endl;
+    for (size_t i = 0; i < results.size() && shown < 10; ++i)
+    {
+        if (results[i] == outcomeAccepted) continue;
+        if (results[i] == outcomeTooDeep) cout << "第" << i + 1 << "句嵌套超过上限" << nestingLimit << "：";
+        else cout << "第" << i + 1 << "句不接受：";
+        cout << sentences[i].substr(0, 200) << (sentences[i].length() > 200 ? "..." : "") << endl;
+        ++shown;
+    }
+    return checkAllocations(allocReport, budgetPath, r.accepted == r.sentences ? 0 : 1);
+}
+
+/******************** 句子生成 ***************************/
+// 从文法随机推导句子，生成吞吐量测试用的语料
+// 预先求出每个非终结符最少能推出几个终结符、最少要推导几层，展开时据此控制长度和深度，保证推导一定结束
+
+const int derivationInfinity = numeric_limits<int>::max() / 4; // 推不出终结符串
+
+// 展开一个非终结符时可选的一条产生式
+struct derivationChoice
+{
+    int minLen; // 右部最少推出的终结符个数
+    int grow; // 比左部的最短长度多出的部分
+    int height; // 用这条产生式展开后最少还要推导的层数（含这一层）
+    string reversed; // 倒序的右部，直接压栈
+};
+
+// 每个非终结符的最小推导长度和深度
+struct derivationInfo
+{
+    int minLen[128]; // 非终结符最少推出的终结符个数
+    int height[128]; // 非终结符最少推导层数
+    bool nonterminal[128];
+    vector<vector<derivationChoice>> choices; // 按左部字符，按最短长度从小到大排列，不含推不出终结符串的产生式
+};
+
+// 不动点迭代，长度和深度都只会变小，最终收敛；含错误终结符的产生式不参与生成
+derivationInfo computeDerivationInfo(const grammarContext& ctx)
+{
+    derivationInfo info;
+    fill(info.minLen, info.minLen + 128, derivationInfinity);
+    fill(info.height, info.height + 128, derivationInfinity);
+    fill(info.nonterminal, info.nonterminal + 128, false);
+    int n = ctx.grammarDeque.size();
+    vector<int> prodMinLen(n, derivationInfinity), prodHeight(n, derivationInfinity);
+    for (const auto& g : ctx.grammarDeque) info.nonterminal[(unsigned char)g.left] = true;
+    bool changed = true;
+    while (changed)
+    {
+        changed = false;
+        for (const auto& g : ctx.grammarDeque)
+        {
+            if (ctx.errorSymbol != 0 && g.right.find(ctx.errorSymbol) != string::npos) continue;
+            int len = 0, h = 0;
+            bool ok = true;
+            if (g.right != "@")
+            {
+                for (char c : g.right)
+                {
+                    unsigned char u = c;
+                    if (!info.nonterminal[u])
+                    {
+                        ++len;
+                        continue;
+                    }
+                    if (info.minLen[u] == derivationInfinity)
+                    {
+                        ok = false;
+                        break;
                     }
+                    len += info.minLen[u];
+                    h = max(h, info.height[u]);
                 }
             }
+            if (!ok) continue;
+            unsigned char left = g.left;
+            prodMinLen[g.gid] = len;
+            prodHeight[g.gid] = h + 1;
+            if (len < info.minLen[left])
+            {
+                info.minLen[left] = len;
+                changed = true;
+            }
+            if (h + 1 < info.height[left])
+            {
+                info.height[left] = h + 1;
+                changed = true;
+            }
+        }
+    }
+    info.choices.resize(128);
+    for (const auto& g : ctx.grammarDeque)
+    {
+        if (prodMinLen[g.gid] == derivationInfinity) continue;
+        string reversed = g.right == "@" ? string() : string(g.right.rbegin(), g.right.rend());
+        int grow = prodMinLen[g.gid] - info.minLen[(unsigned char)g.left];
+        info.choices[(unsigned char)g.left].push_back({ prodMinLen[g.gid], grow, prodHeight[g.gid], reversed });
+    }
+    for (auto& list : info.choices)
+    {
+        stable_sort(list.begin(), list.end(), [](const derivationChoice& a, const derivationChoice& b) { return a.minLen < b.minLen; });
+    }
+    return info;
+}
+
+// 词法分析器中被接受为token的最短字符串，每个等价类取一个可见字符代表；没有则返回空串
+string shortestLexeme(const lexerTable& lexer, int token)
+{
+    vector<int> sample(lexer.classCount, -1);
+    for (int c = 33; c < 127; ++c)
+    {
+        if (sample[lexer.charClass[c]] == -1) sample[lexer.charClass[c]] = c;
+    }
+    for (int c = 0; c < 256; ++c)
+    {
+        if (sample[lexer.charClass[c]] == -1) sample[lexer.charClass[c]] = c;
+    }
+    // 从开始状态1广度优先
+    vector<int> from(lexer.stateCount, -2), via(lexer.stateCount, 0);
+    queue<int> q;
+    from[1] = -1;
+    q.push(1);
+    while (!q.empty())
+    {
+        int s = q.front();
+        q.pop();
+        if (s != 1 && lexer.accept[s] == token)
+        {
+            string text;
+            for (; from[s] != -1; s = from[s]) text += (char)via[s];
+            reverse(text.begin(), text.end());
+            return text;
+        }
+        for (int k = 0; k < lexer.classCount; ++k)
+        {
+            int t = lexer.next[s * lexer.classCount + k];
+            if (t == 0 || from[t] != -2) continue;
+            from[t] = s;
+            via[t] = sample[k];
+            q.push(t);
         }
     }
+    return string();
+}
 
-    
-    return false;
+struct sentenceGenerator
+{
+    const grammarContext& ctx;
+    derivationInfo info;
+    char start;
+    string lexemes[128]; // 有词法分析器时每个终结符输出的单词
+    string terminalText[128]; // 每个终结符实际输出的内容（单词加分隔）
+    string separator; // 单词之间的分隔（能被%skip跳过的字符），避免相邻单词粘连
+    string unmatched; // 词法分析器匹配不了的终结符
+    mt19937_64 rng; // 只用引擎本身，不用标准库的分布（各家实现不同），同样的种子在各平台生成同样的语料
+    vector<pair<char, int>> work; // 待展开的符号和它的深度
+    vector<const derivationChoice*> candidates;
+
+    sentenceGenerator(const grammarContext& c, unsigned long long seed) : ctx(c), info(computeDerivationInfo(c)),
+        start(c.trueStartSymbol), rng(seed)
+    {
+        const lexerTable& lexer = ctx.grammarLexer;
+        for (int c = 0; c < 128; ++c) terminalText[c] = string(1, (char)c);
+        if (lexer.stateCount == 0) return;
+        for (const auto& g : ctx.grammarDeque)
+        {
+            for (char t : g.right)
+            {
+                unsigned char u = t;
+                if (u >= 128 || info.nonterminal[u] || t == '@' || !lexemes[u].empty() || unmatched.find(t) != string::npos) continue;
+                lexemes[u] = shortestLexeme(lexer, u);
+                if (lexemes[u].empty()) unmatched += t;
+            }
+        }
+        for (char c : string(" \t"))
+        {
+            int s = lexer.next[lexer.classCount + lexer.charClass[(unsigned char)c]];
+            if (s != 0 && lexer.accept[s] == -1)
+            {
+                separator = string(1, c);
+                break;
+            }
+        }
+        for (int c = 0; c < 128; ++c) terminalText[c] = lexemes[c] + separator;
+    }
+
+    // [low, high]中的随机数，范围不超过2^32时用乘法代替取模
+    long long randomIn(long long low, long long high)
+    {
+        unsigned long long range = high - low + 1;
+        if (range <= 0xffffffffULL) return low + (long long)(((rng() & 0xffffffffULL) * range) >> 32);
+        return low + (long long)(rng() % range);
+    }
+
+    // 开始符号能否推出终结符串
+    bool productive() const
+    {
+        return info.minLen[(unsigned char)start] != derivationInfinity;
+    }
+
+    // 最浅能推导出句子的深度
+    int minDepth() const
+    {
+        return info.height[(unsigned char)start];
+    }
+
+    // 推导一句追加到out，targetLen为目标终结符个数，maxDepth为推导树的最大深度（不小于minDepth）
+    // 还有余量时按产生式能增加的长度加权随机选择，超出目标时只选最短的，深度不够时只选能在限度内结束的
+    void generate(string& out, int targetLen, int maxDepth)
+    {
+        size_t begin = out.length();
+        long long produced = 0;
+        long long pendingMin = info.minLen[(unsigned char)start];
+        work.assign(1, make_pair(start, 0));
+        while (!work.empty())
+        {
+            unsigned char u = work.back().first;
+            int depth = work.back().second;
+            work.pop_back();
+            if (!info.nonterminal[u])
+            {
+                out += terminalText[u];
+                ++produced;
+                --pendingMin;
+                continue;
+            }
+            pendingMin -= info.minLen[u];
+            long long slack = targetLen - produced - pendingMin;
+            // 按最短长度排好序，深度来得及的第一条就是最短的，长度放得下的是它开始的一段
+            const derivationChoice* chosen = nullptr;
+            candidates.clear();
+            for (const derivationChoice& ch : info.choices[u])
+            {
+                if (depth + ch.height > maxDepth) continue;
+                if (chosen == nullptr) chosen = &ch;
+                if (ch.grow > slack) break;
+                candidates.push_back(&ch);
+            }
+            // 离目标长度还差一半以上时不选不增加长度的产生式，否则句子常常还没长起来就结束了
+            size_t first = 0;
+            if (2 * (targetLen - slack) < targetLen)
+            {
+                while (first < candidates.size() && candidates[first]->grow == 0) ++first;
+                if (first == candidates.size()) first = 0;
+            }
+            if (candidates.size() - first == 1) chosen = candidates[first];
+            else if (candidates.size() - first > 1)
+            {
+                long long totalWeight = 0;
+                for (size_t k = first; k < candidates.size(); ++k) totalWeight += 1 + candidates[k]->grow;
+                long long r = randomIn(0, totalWeight - 1);
+                for (size_t k = first; k < candidates.size(); ++k)
+                {
+                    r -= 1 + candidates[k]->grow;
+                    if (r < 0)
+                    {
+                        chosen = candidates[k];
+                        break;
+                    }
+                }
+            }
+            pendingMin += chosen->minLen;
+            for (char c : chosen->reversed) work.push_back(make_pair(c, depth + 1));
+        }
+        if (!separator.empty() && out.length() > begin) out.pop_back();
+    }
+};
+
+// 解析"最小-最大"或单个数
+bool parseRange(const char* text, int& low, int& high)
+{
+    char* end;
+    low = strtol(text, &end, 10);
+    high = low;
+    if (*end == '-') high = strtol(end + 1, &end, 10);
+    return *end == '\0' && low >= 0 && high >= low;
 }
 
+// 解析带K/M/G后缀的字节数
+long long parseBytes(const char* text)
+{
+    char* end;
+    double v = strtod(text, &end);
+    if (*end == 'K' || *end == 'k') v *= 1 << 10;
+    else if (*end == 'M' || *end == 'm') v *= 1 << 20;
+    else if (*end == 'G' || *end == 'g') v *= 1 << 30;
+    return (long long)v;
+}
 
-// SLR1分析
-int SLR1Analyse()
+// 命令行生成句子语料（不启动界面）
+// 用法：--generate 文法文件 输出文件 [-n 句数] [--bytes 总大小] [--size 最短-最长] [--depth 最浅-最深] [--seed 种子] [--check]
+// 输出文件为-时写到标准输出；--bytes可以带K/M/G后缀，和-n都给时先到为止；都不给时生成1000句
+// --size为每句终结符个数的目标范围（默认1-40），--depth为推导深度上限的范围（默认64），每句在范围内均匀取值
+// 同样的文法、参数和种子总是生成同样的语料；--check用生成的分析表检查每句都能接受
+int generateMain(int argc, char* argv[])
 {
-    // 开始符号添加follow集合
-    followSets['^'].s.insert('$');
+    if (argc < 4)
+    {
+        cerr << "用法：" << argv[0] << " --generate 文法文件 输出文件 [-n 句数] [--bytes 总大小] [--size 最短-最长]"
+            << " [--depth 最浅-最深] [--seed 种子] [--check]" << endl;
+        return 2;
+    }
+    long long count = -1, maxBytes = -1;
+    int sizeLow = 1, sizeHigh = 40, depthLow = 64, depthHigh = 64;
+    unsigned long long seed = 1;
+    bool check = false;
+    for (int i = 4; i < argc; ++i)
+    {
+        bool ok = true;
+        if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) count = atoll(argv[++i]);
+        else if (strcmp(argv[i], "--bytes") == 0 && i + 1 < argc) maxBytes = parseBytes(argv[++i]);
+        else if (strcmp(argv[i], "--size") == 0 && i + 1 < argc) ok = parseRange(argv[++i], sizeLow, sizeHigh);
+        else if (strcmp(argv[i], "--depth") == 0 && i + 1 < argc) ok = parseRange(argv[++i], depthLow, depthHigh);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = strtoull(argv[++i], nullptr, 10);
+        else if (strcmp(argv[i], "--check") == 0) check = true;
+        if (!ok)
+        {
+            cerr << "范围格式错误：" << argv[i] << endl;
+            return 2;
+        }
+    }
+    if (count < 0 && maxBytes < 0) count = 1000;
 
-    bool flag1 = SLR1Fun1();
-    bool flag2 = SLR1Fun2();
-    if (flag1 && flag2)
+    string grammarText, error;
+    if (!readGrammarFile(argv[2], grammarText, error))
     {
-        return 3;
+        cerr << error << endl;
+        return 2;
+    }
+    grammarContext ctx;
+    runtimeTable table;
+    bool canCheck = false;
+    if (check)
+    {
+        canCheck = compileGrammar(ctx, grammarText, table, error);
+        if (!canCheck) cerr << error << "，不检查生成的句子" << endl;
+    }
+    if (!canCheck && !prepareGrammar(ctx, grammarText, error))
+    {
+        cerr << error << endl;
+        return 1;
+    }
+    sentenceGenerator gen(ctx, seed);
+    if (!gen.productive())
+    {
+        cerr << "开始符号推不出终结符串" << endl;
+        return 1;
     }
-    else if (flag1)
+    if (!gen.unmatched.empty())
     {
+        cerr << "终结符" << gen.unmatched << "没有能匹配的单词" << endl;
         return 1;
     }
-    else if (flag2)
+    if (ctx.grammarLexer.stateCount > 0 && gen.separator.empty()) cerr << "没有能跳过的空白，相邻单词可能粘连" << endl;
+    if (depthHigh < gen.minDepth()) cerr << "推导深度至少为" << gen.minDepth() << "，已放宽上限" << endl;
+
+    ofstream file;
+    vector<char> buffer(1 << 20);
+    if (strcmp(argv[3], "-") != 0)
+    {
+        file.rdbuf()->pubsetbuf(buffer.data(), buffer.size());
+        file.open(argv[3], ios::binary);
+        if (!file)
+        {
+            cerr << "无法写入" << argv[3] << endl;
+            return 2;
+        }
+    }
+    ostream& out = strcmp(argv[3], "-") == 0 ? cout : file;
+
+    parseWorkspace ws;
+    string sentence;
+    long long written = 0, bytes = 0, rejected = 0;
+    auto start = chrono::steady_clock::now();
+    while ((count < 0 || written < count) && (maxBytes < 0 || bytes < maxBytes))
+    {
+        sentence.clear();
+        int target = gen.randomIn(sizeLow, sizeHigh);
+        int depth = max((int)gen.randomIn(depthLow, depthHigh), gen.minDepth());
+        gen.generate(sentence, target, depth);
+        if (canCheck)
+        {
+            int steps = 0;
+            if (!parseSentenceImpl<false>(table, sentence, steps, nullptr, nullptr, nullptr, nullptr, ws))
+            {
+                if (rejected == 0)
+                {
+                    cerr << "第" << written + 1 << "句" << (ws.tooDeep ? "嵌套超过上限" + to_string(ws.nestingLimit) : string("不接受"))
+                        << "：" << sentence << endl;
+                }
+                ++rejected;
+            }
+        }
+        sentence += '\n';
+        out.write(sentence.data(), sentence.length());
+        ++written;
+        bytes += sentence.length();
+    }
+    out.flush();
+    double seconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+    cerr << "生成" << written << "句，" << bytes << "字节，用时" << (long long)(seconds * 1000) << "ms，"
+        << (long long)(seconds > 0 ? bytes / seconds / 1e6 : 0) << "MB/秒";
+    if (canCheck) cerr << "；检查" << written << "句，不接受" << rejected << "句";
+    cerr << endl;
+    if (!out)
     {
+        cerr << "写入" << argv[3] << "失败" << endl;
         return 2;
     }
-    // 没有冲突，是SLR(1)文法
-    return 0;
+    return rejected == 0 ? 0 : 1;
 }
 
-struct SLRUnit
+/******************** 后台服务 ***************************/
+// 常驻进程：生成过的分析表按文法文本的散列留在内存中，通过Unix域套接字接受请求，省去每次启动进程和建表
+// 帧格式（整数都是小端）：长度u32（不含长度本身）| 请求号u32 | 类型u8 | 内容
+//   generate：内容为文法文本；回复 散列u64 | 状态数u32 | 分析表类型
+//   parse：内容为 散列u64 | 句子（以\n分隔）；回复 句子数u32 | 每句 是否接受u8 步数u32
+//   stats：内容为空；回复统计信息文本
+// 回复帧：长度u32 | 请求号u32 | 状态u8（0成功，1出错，内容为错误信息）| 内容
+// 同一连接上可以连续发送请求不等回复，请求由工作线程并行处理，回复按完成的顺序发回，用请求号对应
+
+enum serverRequest : unsigned char
 {
-    map<char, string> m;
+    requestGenerate = 1,
+    requestParse = 2,
+    requestStats = 3
 };
 
-vector<SLRUnit> SLRVector;
+const uint32_t maxFrameSize = 64 << 20; // 超过就认为协议出错，断开连接
+const size_t maxQueuedJobs = 256; // 排队的请求数和字节数超过上限时读线程暂停读取，让客户端阻塞在发送上
+const size_t maxQueuedBytes = 256 << 20;
+const size_t maxCachedGrammars = 1024; // 缓存满了淘汰最早生成的文法
+
+void putU32(string& out, uint32_t v)
+{
+    for (int i = 0; i < 4; ++i) out += (char)(v >> (8 * i));
+}
+
+void putU64(string& out, uint64_t v)
+{
+    putU32(out, (uint32_t)v);
+    putU32(out, (uint32_t)(v >> 32));
+}
+
+uint32_t getU32(const char* p)
+{
+    uint32_t v = 0;
+    for (int i = 3; i >= 0; --i) v = v << 8 | (unsigned char)p[i];
+    return v;
+}
+
+uint64_t getU64(const char* p)
+{
+    return getU32(p) | (uint64_t)getU32(p + 4) << 32;
+}
+
+// 服务中缓存的文法
+struct compiledGrammar
+{
+    string text; // 文法原文，散列相同时比较它，不同文法不会串用分析表
+    runtimeTable table;
+    string kind; // 分析表类型
+};
 
-// SLR1分析表
-int getSLR1Table()
+#ifndef _WIN32
+// 一个客户端连接，读线程和工作线程共用，最后一个使用者释放时关闭
+struct serverConnection
 {
-    // SLR1分析错误就直接停止
-    int r = SLR1Analyse();
-    if (r != 0) return r;
-    // 如果分析正确，通过LR0构造SLR1分析表（必须先调用getLR0）
-    for (const dfaState& ds : dfaStateVector)
+    int fd;
+    mutex writeLock; // 多个工作线程可能同时回复
+
+    explicit serverConnection(int f) : fd(f) {}
+    ~serverConnection() { close(fd); }
+
+    // 写出整个回复帧，对方已断开时放弃
+    void send(uint32_t id, unsigned char status, const string& body)
     {
-        SLRUnit slrunit = SLRUnit();
-        // 如果是归约，得做特殊处理
-        if (ds.isEnd)
-        {
-            // 规约项目的非终结符
-            char gl;
-            string gr;
-            // 规约状态
-            for (int cellid : ds.cellV)
-            {
-                // 拿到这个cell
-                const dfaCell& cell = dfaCellVector[cellid];
-                // 获取文法
-                const grammarUnit gm = grammarDeque[cell.gid];
-                // 判断是不是规约项目
-                if (cell.index == gm.right.length() || gm.right == "@")
-                {
-                    gl = gm.left;
-                    gr = gm.right;
-                    break;  // 前面的SLR1校验保证了只有一个归约项目
-                }
-            }
-            // 得到这个非终结符Follow集合
-            set<char> follow = followSets[gl].s;
-            // follow集合每个元素都能归约
-            for (char ch : follow)
+        string frame;
+        putU32(frame, body.length() + 5);
+        putU32(frame, id);
+        frame += (char)status;
+        frame += body;
+        lock_guard<mutex> guard(writeLock);
+        size_t done = 0;
+        while (done < frame.length())
+        {
+            ssize_t n = write(fd, frame.data() + done, frame.length() - done);
+            if (n < 0 && errno == EINTR) continue;
+            if (n <= 0) return;
+            done += n;
+        }
+    }
+
+    // 读满n个字节，连接关闭或出错时返回false
+    bool receive(char* buffer, size_t n)
+    {
+        size_t done = 0;
+        while (done < n)
+        {
+            ssize_t r = read(fd, buffer + done, n - done);
+            if (r < 0 && errno == EINTR) continue;
+            if (r <= 0) return false;
+            done += r;
+        }
+        return true;
+    }
+};
+
+// 等待工作线程处理的请求
+struct serverJob
+{
+    shared_ptr<serverConnection> conn;
+    uint32_t id;
+    unsigned char type;
+    string body;
+};
+
+struct parseServer
+{
+    mutex cacheLock;
+    unordered_map<uint64_t, shared_ptr<const compiledGrammar>> cache;
+    deque<uint64_t> cacheOrder; // 插入顺序，用于淘汰
+
+    mutex queueLock;
+    condition_variable queueReady;
+    condition_variable queueSpace;
+    deque<serverJob> queue;
+    size_t queuedBytes = 0;
+    bool stopping = false;
+
+    // 统计
+    chrono::steady_clock::time_point started = chrono::steady_clock::now();
+    atomic<long long> connections{ 0 };
+    atomic<long long> requests{ 0 };
+    atomic<long long> generated{ 0 };
+    atomic<long long> cacheHits{ 0 };
+    atomic<long long> sentences{ 0 };
+    atomic<long long> accepted{ 0 };
+    atomic<long long> parseNanos{ 0 };
+
+    // 每个连接一个读线程，只负责拆帧，处理交给工作线程，所以客户端可以连续发送请求
+    void reader(shared_ptr<serverConnection> conn)
+    {
+        char header[9];
+        while (conn->receive(header, 4))
+        {
+            uint32_t length = getU32(header);
+            if (length < 5 || length > maxFrameSize) break;
+            if (!conn->receive(header + 4, 5)) break;
+            // 等队列有空位再读请求体，队列满时数据留在套接字里，客户端写满缓冲区后自然阻塞
             {
-                if (gl == trueStartSymbol) slrunit.m[ch] = "ACCEPT";
-                else slrunit.m[ch] = "r(" + string(1, gl) + "->" + gr + ")";
+                unique_lock<mutex> guard(queueLock);
+                queueSpace.wait(guard, [&] {
+                    return stopping || queue.empty() ||
+                        (queue.size() < maxQueuedJobs && queuedBytes + length <= maxQueuedBytes);
+                });
+                if (stopping) break;
             }
-            // 对于下一个节点（可能会存在）
-            for (const auto& next : ds.nextStateVector)
+            serverJob job;
+            job.conn = conn;
+            job.id = getU32(header + 4);
+            job.type = header[8];
+            job.body.resize(length - 5);
+            if (!job.body.empty() && !conn->receive(&job.body[0], job.body.length())) break;
+            lock_guard<mutex> guard(queueLock);
+            queuedBytes += job.body.length();
+            queue.push_back(move(job));
+            queueReady.notify_one();
+        }
+    }
+
+    // 工作线程，各自有一份分析用的栈
+    void worker()
+    {
+        parseWorkspace ws;
+        while (true)
+        {
+            serverJob job;
             {
-                char ch = next.c;
-                int sid = next.sid; //  下一个状态id
+                unique_lock<mutex> guard(queueLock);
+                queueReady.wait(guard, [this] { return stopping || !queue.empty(); });
+                if (queue.empty()) return;
+                job = move(queue.front());
+                queue.pop_front();
+                queuedBytes -= job.body.length();
+            }
+            queueSpace.notify_one();
+            ++requests;
+            string reply, error;
+            bool ok = false;
+            if (job.type == requestGenerate) ok = generate(job.body, reply, error);
+            else if (job.type == requestParse) ok = parse(job.body, ws, reply, error);
+            else if (job.type == requestStats) ok = stats(reply);
+            else error = "未知的请求类型" + to_string(job.type);
+            job.conn->send(job.id, ok ? 0 : 1, ok ? reply : error);
+        }
+    }
+
+    shared_ptr<const compiledGrammar> find(uint64_t key)
+    {
+        lock_guard<mutex> guard(cacheLock);
+        auto it = cache.find(key);
+        return it == cache.end() ? nullptr : it->second;
+    }
+
+    // 按散列找原文相同的文法，散列冲突时顺延到下一个键；没找到时key是可以插入的位置
+    shared_ptr<const compiledGrammar> lookup(const string& text, uint64_t& key)
+    {
+        for (auto it = cache.find(key); it != cache.end(); it = cache.find(++key))
+        {
+            if (it->second->text == text) return it->second;
+        }
+        return nullptr;
+    }
 
-                // 获取下一个状态具体信息
-                dfaState d = dfaStateVector[sid];
-                if (isBigAlpha(ch))
-                {
-                    slrunit.m[ch] = to_string(sid);
-                }
-                else
-                {
-                    slrunit.m[ch] = "s" + to_string(sid);
-                }
-            }
+    // 已经生成过的文法直接返回，否则在本线程的上下文中生成（不同文法可以同时生成）
+    bool generate(const string& text, string& reply, string& error)
+    {
+        uint64_t hash = tableChecksum((const unsigned char*)text.data(), text.length());
+        uint64_t key = hash;
+        shared_ptr<const compiledGrammar> g;
+        {
+            lock_guard<mutex> guard(cacheLock);
+            g = lookup(text, key);
         }
+        if (g) ++cacheHits;
         else
         {
-            for (const auto& next : ds.nextStateVector)
+            grammarContext ctx;
+            shared_ptr<compiledGrammar> made = make_shared<compiledGrammar>();
+            made->text = text;
+            if (!compileGrammar(ctx, text, made->table, error, &made->kind)) return false;
+            ++generated;
+            lock_guard<mutex> guard(cacheLock);
+            // 生成期间别的线程可能已经插入了同一文法或占用了这个键，重新查找
+            key = hash;
+            g = lookup(text, key);
+            if (!g)
             {
-                char ch = next.c;
-                int sid = next.sid; //  下一个状态id
-                // 获取下一个状态具体信息
-                dfaState d = dfaStateVector[sid];
-                if (isBigAlpha(ch))
+                if (cache.size() >= maxCachedGrammars)
                 {
-                    slrunit.m[ch] = to_string(sid);
-                }
-                else
-                {
-                    slrunit.m[ch] = "s" + to_string(sid);
+                    cache.erase(cacheOrder.front());
+                    cacheOrder.pop_front();
                 }
+                cache.insert(make_pair(key, made));
+                cacheOrder.push_back(key);
+                g = made;
             }
         }
-        SLRVector.push_back(slrunit);
+        putU64(reply, key);
+        putU32(reply, g->table.stateCount);
+        reply += g->kind;
+        return true;
+    }
+
+    bool parse(const string& body, parseWorkspace& ws, string& reply, string& error)
+    {
+        if (body.length() < 8)
+        {
+            error = "parse请求缺少文法散列";
+            return false;
+        }
+        shared_ptr<const compiledGrammar> g = find(getU64(body.data()));
+        if (!g)
+        {
+            error = "未知的文法，请先发送generate请求";
+            return false;
+        }
+        auto start = chrono::steady_clock::now();
+        string results;
+        uint32_t count = 0, acceptedCount = 0;
+        size_t pos = 8;
+        while (pos < body.length())
+        {
+            size_t end = body.find('\n', pos);
+            if (end == string::npos) end = body.length();
+            size_t last = end > pos && body[end - 1] == '\r' ? end - 1 : end;
+            int steps = 0;
+            bool ok = parseSentenceImpl<false>(g->table, body.substr(pos, last - pos), steps, nullptr, nullptr, nullptr,
+                nullptr, ws);
+            results += (char)ok;
+            putU32(results, steps);
+            ++count;
+            acceptedCount += ok;
+            pos = end + 1;
+        }
+        parseNanos += chrono::duration_cast<chrono::nanoseconds>(chrono::steady_clock::now() - start).count();
+        sentences += count;
+        accepted += acceptedCount;
+        putU32(reply, count);
+        reply += results;
+        return true;
     }
-    return 0;
-}
 
+    bool stats(string& reply)
+    {
+        size_t grammars;
+        {
+            lock_guard<mutex> guard(cacheLock);
+            grammars = cache.size();
+        }
+        long long n = sentences;
+        ostringstream oss;
+        oss << "运行" << (long long)chrono::duration<double>(chrono::steady_clock::now() - started).count() << "秒\n"
+            << "连接" << connections << "个，请求" << requests << "个\n"
+            << "缓存文法" << grammars << "个（生成" << generated << "次，命中" << cacheHits << "次）\n"
+            << "分析句子" << n << "句，接受" << accepted << "句，平均每句"
+            << (n > 0 ? parseNanos / n : 0) << "纳秒\n";
+        reply = oss.str();
+        return true;
+    }
+};
+#endif
 
-/*清空全局变量*/
-void reset()
+// 后台服务（不启动界面）
+// 用法：--daemon 套接字路径 [-j 工作线程数]
+int daemonMain(int argc, char* argv[])
 {
-    grammarMap.clear();
-    firstSets.clear();
-    followSets.clear();
-    LR0Result.clear();
-    grammarDeque.clear();
-    dfaStateVector.clear();
-    dfaCellVector.clear();
-    VT.clear();
-    VN.clear();
-    SLRVector.clear();
-    scnt = 0;
-    ccnt = 0;
+#ifdef _WIN32
+    (void)argc;
+    (void)argv;
+    cerr << "后台服务使用Unix域套接字，Windows上不支持" << endl;
+    return 2;
+#else
+    if (argc < 3)
+    {
+        cerr << "用法：" << argv[0] << " --daemon 套接字路径 [-j 工作线程数]" << endl;
+        return 2;
+    }
+    int threadCount = 0;
+    for (int i = 3; i < argc; ++i)
+    {
+        if (strcmp(argv[i], "-j") == 0 && i + 1 < argc) threadCount = atoi(argv[++i]);
+    }
+    if (threadCount <= 0) threadCount = max(1u, thread::hardware_concurrency());
 
+    string path = argv[2];
+    sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (path.length() >= sizeof(addr.sun_path))
+    {
+        cerr << "套接字路径太长" << endl;
+        return 2;
+    }
+    strcpy(addr.sun_path, path.c_str());
+    int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    unlink(path.c_str());
+    if (listener < 0 || ::bind(listener, (sockaddr*)&addr, sizeof(addr)) != 0 || listen(listener, 64) != 0)
+    {
+        cerr << "无法监听" << path << "：" << strerror(errno) << endl;
+        return 2;
+    }
+    // 客户端断开后再写不要让进程退出
+    signal(SIGPIPE, SIG_IGN);
+
+    parseServer server;
+    vector<thread> pool;
+    for (int i = 0; i < threadCount; ++i) pool.emplace_back(&parseServer::worker, &server);
+    cout << "在" << path << "上等待请求，" << threadCount << "个工作线程" << endl;
+    while (true)
+    {
+        int fd = accept(listener, nullptr, nullptr);
+        if (fd < 0 && errno == EINTR) continue;
+        if (fd < 0) break;
+        ++server.connections;
+        thread(&parseServer::reader, &server, make_shared<serverConnection>(fd)).detach();
+    }
+    cerr << "accept出错：" << strerror(errno) << endl;
+    close(listener);
+    {
+        lock_guard<mutex> guard(server.queueLock);
+        server.stopping = true;
+    }
+    server.queueReady.notify_all();
+    server.queueSpace.notify_all();
+    for (auto& th : pool) th.join();
+    return 1;
+#endif
 }
 
 /******************** UI界面 ***************************/
+// 界面当前的文法
+grammarContext uiContext;
+
 // 查看输入规则
 void Widget::on_pushButton_7_clicked()
 {
-    QString message = "输入时可以只输入单一个大写字母作为非终结符号，非大写英文字母（除@外）作为终结符号，用@表示空串，默认左边出现的第一个大写字母为文法的开始符号\n同时，文法中含有或(|)，请分开两条输入";
+    QString message = "输入时可以只输入单一个大写字母作为非终结符号，非大写英文字母（除@外）作为终结符号，用@表示空串，默认左边出现的第一个大写字母为文法的开始符号\n同时，文法中含有或(|)，请分开两条输入\n可用 %left、%right、%nonassoc 声明终结符的优先级和结合性（越往后越高），如 %left + -，产生式后可用 %prec x 指定优先级\n%error x 声明错误终结符，可用于写错误产生式，句子分析出错时据此恢复\n#开头的行是注释，也可以直接打开bison/yacc的.y文件（每个符号映射成一个字符，最多26个非终结符、约65个终结符）\n%token x 正则表达式 用正则定义终结符x对应的单词，%skip 正则表达式 定义要跳过的内容（默认跳过空白），句子按最长匹配切分，一样长时先声明的优先";
 
     QMessageBox::information(this, "输入规则", message);
 }
@@ -853,7 +6400,7 @@ void Widget::on_pushButton_7_clicked()
 // 打开文法规则
 void Widget::on_pushButton_3_clicked()
 {
-    QString filePath = QFileDialog::getOpenFileName(this, tr("选择文件"), QDir::homePath(), tr("文本文件 (*.txt);;所有文件 (*.*)"));
+    QString filePath = QFileDialog::getOpenFileName(this, tr("选择文件"), QDir::homePath(), tr("文本文件 (*.txt);;yacc文法 (*.y *.yy);;所有文件 (*.*)"));
 
     if (!filePath.isEmpty())
     {
@@ -870,6 +6417,20 @@ void Widget::on_pushButton_3_clicked()
             QMessageBox::critical(this, "错误信息", "导入错误！无法打开文件，请检查路径和文件是否被占用！");
             cerr << "Error opening file." << endl;
         }
+        // yacc文法先转换成本程序的格式
+        if (filePath.endsWith(".y") || filePath.endsWith(".yy"))
+        {
+            string grammarText, error;
+            if (importYaccGrammar(inputFile, grammarText, error))
+            {
+                ui->plainTextEdit_2->setPlainText(QString::fromStdString(grammarText));
+            }
+            else
+            {
+                QMessageBox::critical(this, "错误信息", "yacc文法导入失败：" + QString::fromStdString(error));
+            }
+            return;
+        }
         // 读取文件内容并显示在 plainTextEdit_2
         stringstream buffer;
         buffer << inputFile.rdbuf();
@@ -900,11 +6461,13 @@ void Widget::on_pushButton_4_clicked()
 // 求解first集合按钮
 void Widget::on_pushButton_5_clicked()
 {
-    reset();
+    grammarContext& ctx = uiContext;
+    reset(ctx);
     QString grammar_q = ui->plainTextEdit_2->toPlainText();
-    grammarStr = grammar_q.toStdString();
-    handleGrammar();
-    getFirstSets();
+    ctx.grammarStr = grammar_q.toStdString();
+    handleGrammar(ctx);
+    pruneGrammar(ctx);
+    getFirstSets(ctx);
 
     QTableWidget* tableWidget = ui->tableWidget_3;
 
@@ -920,11 +6483,11 @@ void Widget::on_pushButton_5_clicked()
     tableWidget->setHorizontalHeaderLabels(headerLabels);
 
     // 设置行数
-    tableWidget->setRowCount(firstSets.size());
+    tableWidget->setRowCount(ctx.firstSets.size());
 
     // 遍历非终结符的First集合，将其展示在表格中
     int row = 0;
-    for (const auto& entry : firstSets)
+    for (const auto& entry : ctx.firstSets)
     {
         char nonTerminal = entry.first;
         const set<char>& firstSet = entry.second.s;
@@ -960,19 +6523,21 @@ void Widget::on_pushButton_5_clicked()
 // 求解follow集合按钮
 void Widget::on_pushButton_6_clicked()
 {
-    reset();
+    grammarContext& ctx = uiContext;
+    reset(ctx);
     QString grammar_q = ui->plainTextEdit_2->toPlainText();
-    grammarStr = grammar_q.toStdString();
-    handleGrammar();
-    getFirstSets();
-    getFollowSets();
+    ctx.grammarStr = grammar_q.toStdString();
+    handleGrammar(ctx);
+    pruneGrammar(ctx);
+    getFirstSets(ctx);
+    getFollowSets(ctx);
 
 
     // 清空TableWidget
     ui->tableWidget_4->clear();
 
     // 设置表格的行数和列数
-    int rowCount = followSets.size();
+    int rowCount = ctx.followSets.size();
     int columnCount = 2; // 两列
     ui->tableWidget_4->setRowCount(rowCount);
     ui->tableWidget_4->setColumnCount(columnCount);
@@ -984,7 +6549,7 @@ void Widget::on_pushButton_6_clicked()
 
     // 遍历followSets，将数据填充到TableWidget中
     int row = 0;
-    for (const auto& entry : followSets) {
+    for (const auto& entry : ctx.followSets) {
         // 获取非终结符和对应的followUnit
         char nonTerminal = entry.first;
         const followUnit& followSet = entry.second;
@@ -1011,16 +6576,18 @@ void Widget::on_pushButton_6_clicked()
 // 生成LR(0)DFA图
 void Widget::on_pushButton_clicked()
 {
-    reset();
+    grammarContext& ctx = uiContext;
+    reset(ctx);
     ui->tableWidget->clear();
     QString grammar_q = ui->plainTextEdit_2->toPlainText();
-    grammarStr = grammar_q.toStdString();
-    handleGrammar();
-    ui->plainTextEdit_4->setPlainText(LR0Result);
-    getLR0();
+    ctx.grammarStr = grammar_q.toStdString();
+    handleGrammar(ctx);
+    pruneGrammar(ctx);
+    ui->plainTextEdit_4->setPlainText(ctx.LR0Result);
+    getLR0(ctx);
 
-    int numRows = dfaStateVector.size();
-    int numCols = 2 + VT.size() + VN.size();
+    int numRows = ctx.dfaStateVector.size();
+    int numCols = 2 + ctx.VT.size() + ctx.VN.size();
 
     ui->tableWidget->setRowCount(numRows);
     ui->tableWidget->setColumnCount(numCols);
@@ -1030,11 +6597,11 @@ void Widget::on_pushButton_clicked()
     headers << "状态" << "状态内文法";
     map<char, int> c2int;
     int cnt = 0;
-    for (char vt : VT) {
+    for (char vt : ctx.VT) {
         headers << QString(vt);
         c2int[vt] = cnt++;
     }
-    for (char vn : VN) {
+    for (char vn : ctx.VN) {
         headers << QString(vn);
         c2int[vn] = cnt++;
     }
@@ -1043,79 +6610,755 @@ void Widget::on_pushButton_clicked()
     // Populate the table with data
     for (int i = 0; i < numRows; ++i)
     {
-        ui->tableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(dfaStateVector[i].sid)));
-        ui->tableWidget->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(getStateGrammar(dfaStateVector[i]))));
+        ui->tableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(ctx.dfaStateVector[i].sid)));
+        ui->tableWidget->setItem(i, 1, new QTableWidgetItem(QString::fromStdString(getStateGrammar(ctx, ctx.dfaStateVector[i]))));
+
+        // Display nextStateVector
+        for (int j = 0; j < ctx.dfaStateVector[i].nextStateVector.size(); ++j)
+        {
+            ui->tableWidget->setItem(i, 2 + c2int[ctx.dfaStateVector[i].nextStateVector[j].c], new QTableWidgetItem(QString::number(ctx.dfaStateVector[i].nextStateVector[j].sid)));
+        }
+    }
+}
+
+// LR(0)DFA图：整个自动机画在一个图元上，只画可见区域内的状态和边，按缩放程度决定画多少细节
+// 缩得很小时只画点，边按层和位置合并成粗线；放大后画状态号；再放大才画项目集和边上的符号
+class dfaGraphItem : public QGraphicsItem
+{
+public:
+    // 布局的尺寸（场景坐标）
+    static constexpr qreal nodeWidth = 180;
+    static constexpr qreal nodeHeight = 64;
+    static constexpr qreal columnWidth = 280;
+    static constexpr qreal rowHeight = 90;
+    // 细节层次：小于bundleLod时合并边，大于labelLod时画状态号，大于detailLod时画项目集
+    static constexpr qreal bundleLod = 0.08;
+    static constexpr qreal labelLod = 0.3;
+    static constexpr qreal detailLod = 0.8;
+
+    // 从文法上下文复制需要的数据，之后重新生成文法不影响已经打开的图
+    explicit dfaGraphItem(const grammarContext& ctx)
+    {
+        int n = ctx.dfaStateVector.size();
+        items.resize(n);
+        isEnd.resize(n);
+        out.resize(n);
+        layer.assign(n, -1);
+        pos.resize(n);
+        for (int s = 0; s < n; ++s)
+        {
+            const dfaState& state = ctx.dfaStateVector[s];
+            items[s] = QString::fromStdString(getStateGrammar(ctx, state)).trimmed().replace(' ', '\n');
+            isEnd[s] = state.isEnd;
+            for (const auto& next : state.nextStateVector)
+            {
+                out[s].push_back(edges.size());
+                edges.push_back({ s, next.sid, next.c });
+            }
+        }
+        setFlag(ItemUsesExtendedStyleOption);
+        if (n > 0) place(0, 0);
+    }
+
+    QRectF boundingRect() const override
+    {
+        return bounds;
+    }
+
+    int stateCount() const
+    {
+        return items.size();
+    }
+
+    // 状态所在的层，-1表示还没布局
+    int layerOf(int s) const
+    {
+        return layer[s];
+    }
+
+    // 状态框的左上角
+    QPointF position(int s) const
+    {
+        return pos[s];
+    }
+
+    // 每束合并了几条边（自环不合并）
+    vector<int> bundleSizes() const
+    {
+        vector<int> sizes;
+        for (const bundle& b : bundles) sizes.push_back(b.count);
+        return sizes;
+    }
+
+    // 分层布局：按广度优先的顺序，每个状态第一次被访问时放在父状态的下一层末尾，放好后不再移动
+    // 每次最多展开budget个状态，返回是否全部完成，界面在空闲时分批调用
+    bool layoutSome(int budget)
+    {
+        prepareGeometryChange();
+        while (budget-- > 0 && head < order.size())
+        {
+            int s = order[head++];
+            for (int e : out[s])
+            {
+                int t = edges[e].to;
+                if (layer[t] == -1) place(t, layer[s] + 1);
+            }
+        }
+        buildBundles();
+        update();
+        return head == order.size();
+    }
+
+    void paint(QPainter* painter, const QStyleOptionGraphicsItem* option, QWidget*) override
+    {
+        const QRectF visible = option->exposedRect;
+        const qreal lod = QStyleOptionGraphicsItem::levelOfDetailFromTransform(painter->worldTransform());
+        if (lod < bundleLod)
+        {
+            paintOverview(painter, visible);
+            return;
+        }
+        bool detailed = lod >= detailLod;
+        painter->setRenderHint(QPainter::Antialiasing, detailed);
+
+        // 边：两端都已布局、包围盒和可见区域相交的才画
+        QVector<QLineF> lines;
+        vector<int> labeled;
+        for (size_t e = 0; e < edges.size(); ++e)
+        {
+            const edge& ed = edges[e];
+            if (layer[ed.to] == -1 || ed.from == ed.to) continue;
+            QLineF line = edgeLine(ed);
+            if (!QRectF(line.p1(), line.p2()).normalized().adjusted(-1, -1, 1, 1).intersects(visible)) continue;
+            lines.push_back(line);
+            if (detailed) labeled.push_back(e);
+        }
+        painter->setPen(QPen(QColor(120, 120, 120), 0));
+        painter->drawLines(lines);
+
+        // 状态
+        QFont font = painter->font();
+        for (size_t s = 0; s < items.size(); ++s)
+        {
+            if (layer[s] == -1) continue;
+            QRectF box(pos[s], QSizeF(nodeWidth, nodeHeight));
+            if (!box.intersects(visible)) continue;
+            painter->setPen(QPen(s == 0 ? QColor(200, 60, 60) : QColor(40, 40, 40), 0));
+            painter->setBrush(isEnd[s] ? QColor(255, 236, 200) : QColor(220, 235, 255));
+            if (detailed)
+            {
+                painter->drawRoundedRect(box, 6, 6);
+                painter->setFont(font);
+                painter->drawText(box.adjusted(6, 2, -6, -2), Qt::AlignLeft | Qt::AlignTop, "I" + QString::number(s));
+                QFont small = font;
+                if (font.pointSizeF() > 0) small.setPointSizeF(font.pointSizeF() * 0.8);
+                painter->setFont(small);
+                painter->drawText(box.adjusted(36, 2, -6, -2), Qt::AlignLeft | Qt::AlignTop, items[s]);
+            }
+            else
+            {
+                painter->drawRect(box);
+                if (lod >= labelLod) painter->drawText(box, Qt::AlignCenter, QString::number(s));
+            }
+        }
+        painter->setFont(font);
+
+        // 边上的符号和自环只在放大后画
+        if (!detailed) return;
+        painter->setPen(QPen(QColor(0, 90, 160), 0));
+        painter->setBrush(Qt::NoBrush);
+        for (int e : labeled)
+        {
+            QLineF line = edgeLine(edges[e]);
+            painter->drawText(line.pointAt(0.5) + QPointF(-4, -4), QString(edges[e].c));
+        }
+        for (const edge& ed : edges)
+        {
+            if (ed.from != ed.to || layer[ed.from] == -1) continue;
+            QRectF loop(pos[ed.from] + QPointF(nodeWidth / 2 - 12, -20), QSizeF(24, 24));
+            if (!loop.intersects(visible)) continue;
+            painter->drawArc(loop, 0, 180 * 16);
+            painter->drawText(loop.topRight(), QString(ed.c));
+        }
+    }
+
+private:
+    struct edge
+    {
+        int from, to;
+        char c;
+    };
+
+    // 合并后的一束边：起点、终点取平均，条数决定粗细
+    struct bundle
+    {
+        QPointF from, to;
+        int count;
+    };
+
+    vector<QString> items; // 每个状态的项目集（一行一个）
+    vector<char> isEnd;
+    vector<edge> edges;
+    vector<vector<int>> out; // 每个状态的出边下标
+    vector<int> layer; // -1表示还没布局
+    vector<QPointF> pos; // 状态框的左上角
+    vector<int> layerSize; // 每层已放的状态数
+    vector<int> order; // 布局的顺序（广度优先的队列）
+    size_t head = 0;
+    QRectF bounds;
+    vector<bundle> bundles;
+
+    void place(int s, int l)
+    {
+        if ((int)layerSize.size() <= l) layerSize.resize(l + 1, 0);
+        layer[s] = l;
+        pos[s] = QPointF(l * columnWidth, layerSize[l]++ * rowHeight);
+        order.push_back(s);
+        bounds |= QRectF(pos[s] - QPointF(0, 24), QSizeF(nodeWidth, nodeHeight + 24));
+    }
+
+    QLineF edgeLine(const edge& ed) const
+    {
+        return QLineF(pos[ed.from] + QPointF(nodeWidth, nodeHeight / 2), pos[ed.to] + QPointF(0, nodeHeight / 2));
+    }
+
+    // 按（起点层，起点所在的一段，终点层，终点所在的一段）合并边，缩小后几万条边只剩几百束
+    void buildBundles()
+    {
+        const qreal span = rowHeight * 32;
+        unordered_map<long long, int> index;
+        bundles.clear();
+        for (const edge& ed : edges)
+        {
+            if (layer[ed.to] == -1 || ed.from == ed.to) continue;
+            QLineF line = edgeLine(ed);
+            long long key = (((long long)layer[ed.from] * 65536 + (long long)(line.y1() / span)) * 65536
+                + layer[ed.to]) * 65536 + (long long)(line.y2() / span);
+            auto it = index.find(key);
+            if (it == index.end())
+            {
+                index[key] = bundles.size();
+                bundles.push_back({ line.p1(), line.p2(), 1 });
+            }
+            else
+            {
+                bundle& b = bundles[it->second];
+                b.from += line.p1();
+                b.to += line.p2();
+                ++b.count;
+            }
+        }
+        for (bundle& b : bundles)
+        {
+            b.from /= b.count;
+            b.to /= b.count;
+        }
+    }
+
+    // 缩得很小时：边画成按条数加粗的束，状态画成点（线宽都不随缩放变化）
+    void paintOverview(QPainter* painter, const QRectF& visible)
+    {
+        for (const bundle& b : bundles)
+        {
+            if (!QRectF(b.from, b.to).normalized().adjusted(-1, -1, 1, 1).intersects(visible)) continue;
+            QPen pen(QColor(120, 120, 120, 160), 1 + log2((double)b.count));
+            pen.setCosmetic(true);
+            painter->setPen(pen);
+            painter->drawLine(b.from, b.to);
+        }
+        QVector<QPointF> points[2];
+        for (size_t s = 0; s < items.size(); ++s)
+        {
+            if (layer[s] == -1) continue;
+            QPointF center = pos[s] + QPointF(nodeWidth / 2, nodeHeight / 2);
+            if (visible.contains(center)) points[isEnd[s] ? 1 : 0].push_back(center);
+        }
+        QPen pen(QColor(40, 90, 200), 3);
+        pen.setCosmetic(true);
+        painter->setPen(pen);
+        painter->drawPoints(points[0].constData(), points[0].size());
+        pen.setColor(QColor(220, 140, 20));
+        painter->setPen(pen);
+        painter->drawPoints(points[1].constData(), points[1].size());
+    }
+};
+
+// LR(0)DFA图窗口：滚轮缩放，拖动平移，布局在事件循环空闲时分批完成
+class dfaGraphView : public QGraphicsView
+{
+public:
+    // 每批布局的状态数
+    static const int layoutBatch = 4000;
+
+    dfaGraphView(const grammarContext& ctx, QWidget* parent) : QGraphicsView(parent)
+    {
+        setWindowFlags(Qt::Window);
+        setAttribute(Qt::WA_DeleteOnClose);
+        setScene(new QGraphicsScene(this));
+        // 只有一个图元，不需要场景索引；裁剪在图元内部按可见区域做
+        scene()->setItemIndexMethod(QGraphicsScene::NoIndex);
+        graph = new dfaGraphItem(ctx);
+        scene()->addItem(graph);
+        setWindowTitle("LR(0)DFA图（" + QString::number(graph->stateCount()) + "个状态，滚轮缩放，拖动平移）");
+        setDragMode(QGraphicsView::ScrollHandDrag);
+        setTransformationAnchor(QGraphicsView::AnchorUnderMouse);
+        setViewportUpdateMode(QGraphicsView::SmartViewportUpdate);
+        setOptimizationFlags(QGraphicsView::DontSavePainterState | QGraphicsView::DontAdjustForAntialiasing);
+        resize(1000, 700);
+
+        QTimer* timer = new QTimer(this);
+        connect(timer, &QTimer::timeout, [this, timer]
+        {
+            bool done = graph->layoutSome(layoutBatch);
+            scene()->setSceneRect(graph->boundingRect());
+            if (!positioned)
+            {
+                positioned = true;
+                // 小的自动机整个放进窗口，大的从初始状态开始看
+                if (done) fitInView(graph->boundingRect(), Qt::KeepAspectRatio);
+                if (!done || transform().m11() > 1) resetTransform();
+                centerOn(done ? graph->boundingRect().center() : QPointF(0, 0));
+            }
+            if (done) timer->stop();
+        });
+        timer->start(0);
+    }
+
+protected:
+    void wheelEvent(QWheelEvent* event) override
+    {
+        qreal factor = pow(1.0015, event->angleDelta().y());
+        qreal current = transform().m11() * factor;
+        if (current < 0.002 || current > 8) return;
+        scale(factor, factor);
+    }
+
+private:
+    dfaGraphItem* graph;
+    bool positioned = false; // 第一批布局完成后定位一次，之后不再改动用户的视角
+};
+
+// LR(0)DFA图形显示：先和表格一样生成，再在新窗口中画出
+void Widget::on_pushButton_9_clicked()
+{
+    on_pushButton_clicked();
+    if (uiContext.dfaStateVector.empty()) return;
+    (new dfaGraphView(uiContext, this))->show();
+}
+
+// 展示分析表（SLR1/LALR1共用）
+void showSLRTable(grammarContext& ctx, QTableWidget* tableWidget, const vector<SLRUnit>& table)
+{
+    tableWidget->clear();
+    ctx.VT.insert('$');
+    int numRows = table.size();
+    int numCols = 1 + ctx.VT.size() + ctx.VN.size();
+
+    tableWidget->setRowCount(numRows);
+    tableWidget->setColumnCount(numCols);
+    // Set the table headers
+    QStringList headers;
+    headers << "状态";
+    map<char, int> c2int;
+    int cnt = 0;
+    for (char vt : ctx.VT) {
+        headers << QString(vt);
+        c2int[vt] = cnt++;
+    }
+    for (char vn : ctx.VN) {
+        headers << QString(vn);
+        c2int[vn] = cnt++;
+    }
+    tableWidget->setHorizontalHeaderLabels(headers);
+
+    // Populate the table with data
+    for (int i = 0; i < numRows; ++i)
+    {
+        tableWidget->setItem(i, 0, new QTableWidgetItem(QString::number(i)));
 
         // Display nextStateVector
-        for (int j = 0; j < dfaStateVector[i].nextStateVector.size(); ++j)
+        for (const auto& slrunit : table[i].m)
         {
-            ui->tableWidget->setItem(i, 2 + c2int[dfaStateVector[i].nextStateVector[j].c], new QTableWidgetItem(QString::number(dfaStateVector[i].nextStateVector[j].sid)));
+            tableWidget->setItem(i, 1 + c2int[slrunit.first], new QTableWidgetItem(QString::fromStdString(slrunit.second)));
         }
     }
 }
 
+// 计时（毫秒）
+double elapsedMs(chrono::steady_clock::time_point start)
+{
+    return chrono::duration<double, milli>(chrono::steady_clock::now() - start).count();
+}
+
 // 分析SLR(1)文法
 void Widget::on_pushButton_2_clicked()
 {
-    reset();
+    grammarContext& ctx = uiContext;
+    reset(ctx);
     QString grammar_q = ui->plainTextEdit_2->toPlainText();
-    grammarStr = grammar_q.toStdString();
-    handleGrammar();
-    getFirstSets();
-    getFollowSets();
-    getLR0();
-    int result = getSLR1Table();
+    ctx.grammarStr = grammar_q.toStdString();
+    handleGrammar(ctx);
+    pruneGrammar(ctx);
+    getFirstSets(ctx);
+    getLR0(ctx);
+
+    // SLR1与LALR1共用同一个LR0自动机，分别计时
+    auto slrStart = chrono::steady_clock::now();
+    getFollowSets(ctx);
+    int result = getSLR1Table(ctx);
+    double slrTime = elapsedMs(slrStart);
+    int slrResolved = ctx.precResolvedCount;
+
+    auto lalrStart = chrono::steady_clock::now();
+    int lalrResult = getLALR1Table(ctx);
+    double lalrTime = elapsedMs(lalrStart);
+    int lalrResolved = ctx.precResolvedCount;
+
+    auto lr1Start = chrono::steady_clock::now();
+    int lr1Result = getLR1Table(ctx);
+    double lr1Time = elapsedMs(lr1Start);
+    int lr1Resolved = ctx.precResolvedCount;
+
+    // 规范LR1只用于对比状态数和内存
+    auto canonicalStart = chrono::steady_clock::now();
+    vector<lr1State> canonicalStates;
+    bool canonicalDone = buildLR1States(ctx, canonicalStates, false);
+    double canonicalTime = elapsedMs(canonicalStart);
+
+    QString message;
+    int resolved = 0;
     switch (result)
     {
     case 1:
-        ui->plainTextEdit->setPlainText("出现归约-移进冲突");
+        message = "出现归约-移进冲突";
         break;
     case 2:
-        ui->plainTextEdit->setPlainText("出现归约-归约冲突");
+        message = "出现归约-归约冲突";
         break;
     case 3:
-        ui->plainTextEdit->setPlainText("出现归约-移进冲突和归约-归约冲突");
+        message = "出现归约-移进冲突和归约-归约冲突";
         break;
     case 0:
+        message = "符合SLR(1)文法，请查看SLR(1)分析表！";
+        showSLRTable(ctx, ui->tableWidget_2, ctx.SLRVector);
+        resolved = slrResolved;
+        break;
+    }
+    if (result != 0)
+    {
+        if (lalrResult == 0)
+        {
+            message += "\n但符合LALR(1)文法，已展示LALR(1)分析表！";
+            showSLRTable(ctx, ui->tableWidget_2, ctx.LALRVector);
+            resolved = lalrResolved;
+        }
+        else if (lr1Result == 0)
+        {
+            message += "\n不是LALR(1)文法，但符合LR(1)文法，已展示最小LR(1)分析表（状态编号与LR(0)DFA图不同）！";
+            showSLRTable(ctx, ui->tableWidget_2, ctx.LR1Vector);
+            resolved = lr1Resolved;
+        }
+        else
+        {
+            int conflictCells = buildGLRTable(ctx, grammarGLR);
+            message += "\n也不是LALR(1)和LR(1)文法，已展示GLR分析表：" + QString::number(conflictCells)
+                + "个冲突格子保留了所有动作（用/分隔），句子分析时用GLR";
+            showSLRTable(ctx, ui->tableWidget_2, ctx.GLRVector);
+        }
+    }
+    if (resolved > 0)
     {
-        ui->plainTextEdit->setPlainText("符合SLR(1)文法，请查看SLR(1)分析表！");
-        ui->tableWidget_2->clear();
-        VT.insert('$');
-        int numRows = SLRVector.size();
-        int numCols = 1 + VT.size() + VN.size();
+        message += "\n按优先级与结合性解决了" + QString::number(resolved) + "处移进-归约冲突";
+    }
+    message += "\n\nSLR(1)：" + QString::number(ctx.dfaStateVector.size()) + "个状态，用时"
+        + QString::number(slrTime, 'f', 3) + "ms";
+    message += "\nLALR(1)：" + QString::number(ctx.dfaStateVector.size()) + "个状态，用时"
+        + QString::number(lalrTime, 'f', 3) + "ms";
+    message += "\n最小LR(1)：" + QString::number(ctx.lr1StateVector.size()) + "个状态，约"
+        + QString::number(lr1Memory(ctx.lr1StateVector) / 1024.0, 'f', 1) + "KB，用时"
+        + QString::number(lr1Time, 'f', 3) + "ms";
+    message += "\n规范LR(1)：" + QString(canonicalDone ? "" : "超过") + QString::number(canonicalStates.size()) + "个状态，约"
+        + QString::number(lr1Memory(canonicalStates) / 1024.0, 'f', 1) + "KB，用时"
+        + QString::number(canonicalTime, 'f', 3) + "ms";
+    ui->plainTextEdit->setPlainText(message);
+}
 
-        ui->tableWidget_2->setRowCount(numRows);
-        ui->tableWidget_2->setColumnCount(numCols);
-        // Set the table headers
-        QStringList headers;
-        headers << "状态";
-        map<char, int> c2int;
-        int cnt = 0;
-        for (char vt : VT) {
-            headers << QString(vt);
-            c2int[vt] = cnt++;
+// 用GLR分析表分析所有句子，返回结果说明
+QString glrAnalyse(const glrTable& table, const vector<string>& sentences)
+{
+    QString message = "该文法不是LR(1)文法，使用GLR分析（" + QString::number(table.conflicts.size()) + "个冲突格子）\n";
+    glrParser parser;
+    int acceptCount = 0, messageLines = 0;
+    QString forestText;
+    for (int i = 0; i < (int)sentences.size(); ++i)
+    {
+        glrResult r;
+        bool ok = parser.parse(table, sentences[i], r);
+        int ambiguous = 0;
+        double trees = ok ? countTrees(r.root, ambiguous) : 0;
+        if (ok) ++acceptCount;
+        if (i == 0 && ok)
+        {
+            forestText = "分析森林（{n}表示该结点有n种分析，只展开第一种）：\n" + QString::fromStdString(sppfToString(r.root, 2000)) + "\n";
         }
-        for (char vn : VN) {
-            headers << QString(vn);
-            c2int[vn] = cnt++;
+        if (messageLines >= 200) continue;
+        ++messageLines;
+        message += "第" + QString::number(i + 1) + "句：";
+        if (!ok)
+        {
+            message += "在第" + QString::number(r.errorPos + 1) + "个单词处出错\n";
+            continue;
         }
-        ui->tableWidget_2->setHorizontalHeaderLabels(headers);
+        message += "接受，";
+        if (isinf(trees)) message += "有无穷多种分析";
+        else if (trees > 1) message += QString::number(trees, 'g', 12) + "种分析，" + QString::number(ambiguous) + "个有歧义的结点";
+        else message += "没有歧义";
+        message += r.forkPos < 0 ? "，全程没有分叉" : "，从第" + QString::number(r.forkPos + 1) + "个单词开始分叉";
+        message += "（GSS" + QString::number(r.gssNodes) + "个结点，SPPF" + QString::number(r.sppfNodes) + "个结点）\n";
+    }
+    message += "共" + QString::number(sentences.size()) + "句，接受" + QString::number(acceptCount) + "句\n";
+    return message + forestText;
+}
+
+// 分析过程的表格模型，数据都在traceLog里，每一行在显示时才生成
+class traceModel : public QAbstractTableModel
+{
+public:
+    traceModel(const traceLog* log, QObject* parent) : QAbstractTableModel(parent), log(log) {}
+
+    int rowCount(const QModelIndex& parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : log->steps.size();
+    }
+
+    int columnCount(const QModelIndex& parent = QModelIndex()) const override
+    {
+        return parent.isValid() ? 0 : 5;
+    }
 
-        // Populate the table with data
-        for (int i = 0; i < numRows; ++i)
+    QVariant data(const QModelIndex& index, int role) const override
+    {
+        if (role != Qt::DisplayRole) return QVariant();
+        int i = index.row();
+        switch (index.column())
         {
-            ui->tableWidget_2->setItem(i, 0, new QTableWidgetItem(QString::number(i)));
+        case 0: return i + 1;
+        case 1: return QString::fromStdString(log->stackText(i, true));
+        case 2: return QString::fromStdString(log->stackText(i, false));
+        case 3: return QString::fromStdString(log->inputText(i));
+        default: return QString::fromStdString(log->actionText(i));
+        }
+    }
+
+    QVariant headerData(int section, Qt::Orientation orientation, int role) const override
+    {
+        if (role != Qt::DisplayRole || orientation != Qt::Horizontal) return QVariant();
+        static const char* headers[] = { "步骤", "状态栈", "符号栈", "输入串", "动作" };
+        return QString(headers[section]);
+    }
+
+    // 修改traceLog前后调用，两者之间视图不会读取旧的行
+    void beginRefresh() { beginResetModel(); }
+    void endRefresh() { endResetModel(); }
+
+private:
+    const traceLog* log;
+};
+
+// 一个句子的分析结果
+struct sentenceResult
+{
+    bool ok = false;
+    int steps = 0;
+    int baseSteps = 0; // 不绕过单产生式时的步数
+    vector<parseDiagnostic> diagnostics;
+};
+
+// 句子分析界面的缓存：文法和选项不变时不重新建表，句子只在原文变化时重新分析
+struct sentenceView
+{
+    string key; // 文法原文加选项，为空时下次重新建表
+    bool useGLR = false; // 不是LR(1)文法
+    glrTable glr;
+    runtimeTable base; // 没有绕过单产生式的表，统计节省的步数用
+    runtimeTable table; // 分析用的表
+    vector<string> rules; // 分析过程显示用的产生式
+    int minimizedCount = 0; // 最小化后的状态数
+    unordered_map<string, sentenceResult> results; // 按句子原文
+    incrementalParser first; // 第一句的增量分析
+    string traced; // parseTrace和语法树对应的句子
+    QString treeText;
+};
+
+sentenceView sentenceCache;
+
+// 文法变化时重新建表，有错误时不缓存
+void rebuildSentenceView(grammarContext& ctx, sentenceView& view, const string& grammar, bool unitElim)
+{
+    view = sentenceView();
+    reset(ctx);
+    ctx.grammarStr = grammar;
+    handleGrammar(ctx);
+    pruneGrammar(ctx);
+    getFirstSets(ctx);
+    getFollowSets(ctx);
+    getLR0(ctx);
+    const vector<SLRUnit>* table = chooseParseTable(ctx);
+    view.useGLR = table == nullptr;
+    if (view.useGLR) buildGLRTable(ctx, view.glr);
+    else
+    {
+        view.base = buildRuntimeTable(ctx, *table);
+        view.table = view.base;
+        // 可选：绕过单产生式归约，同时统计节省的步数
+        if (unitElim) eliminateUnitReductions(ctx, view.table);
+        // 分析过程的状态号要和DFA对应，最小化只报告能合并多少
+        runtimeTable minimized = view.table;
+        minimizeStates(minimized);
+        view.minimizedCount = minimized.stateCount;
+        for (const auto& g : ctx.grammarDeque) view.rules.push_back(string(1, g.left) + "->" + g.right);
+    }
+    if (ctx.errors.empty()) view.key = grammar + (unitElim ? "1" : "0");
+}
+
+// 句子分析
+void Widget::on_pushButton_8_clicked()
+{
+    vector<string> sentences;
+    istringstream iss(ui->plainTextEdit_3->toPlainText().toStdString());
+    string line;
+    while (getline(iss, line))
+    {
+        if (!line.empty()) sentences.push_back(line);
+    }
+    if (sentences.empty())
+    {
+        ui->plainTextEdit_5->setPlainText("请输入句子");
+        return;
+    }
+
+    sentenceView& view = sentenceCache;
+    string grammar = ui->plainTextEdit_2->toPlainText().toStdString();
+    bool unitElim = ui->checkBox->isChecked();
+    bool rebuilt = view.key.empty() || view.key != grammar + (unitElim ? "1" : "0");
+    if (rebuilt) rebuildSentenceView(uiContext, view, grammar, unitElim);
 
-            // Display nextStateVector
-            for ( const auto& slrunit : SLRVector[i].m)
+    traceModel* model = static_cast<traceModel*>(ui->tableView->model());
+    if (view.useGLR)
+    {
+        // 不是LR(1)文法时用GLR分析，没有分析过程表
+        ui->plainTextEdit_5->setPlainText(glrAnalyse(view.glr, sentences));
+        if (model != nullptr) model->beginRefresh();
+        parseTrace.begin(string());
+        if (model != nullptr) model->endRefresh();
+        view.traced.clear();
+        return;
+    }
+    const runtimeTable& used = view.table;
+
+    // 第一句用增量分析：和上次是同一个文法时只重新分析修改的部分
+    if (rebuilt) view.first.parse(used, sentences[0]);
+    else view.first.update(sentences[0]);
+    // 分析过程和语法树要完整地走一遍，只在第一句变化时重新记录
+    if (rebuilt || view.traced != sentences[0])
+    {
+        if (model != nullptr) model->beginRefresh();
+        parseTrace.rules = view.rules;
+        treeArena arena;
+        treeNode* root = nullptr;
+        int steps = 0;
+        bool ok = parseSentence(used, sentences[0], steps, &parseTrace, nullptr, &arena, &root);
+        view.treeText = ok ? "语法树（" + QString::number(arena.totalBytes) + "字节）：\n"
+            + QString::fromStdString(treeToString(root, 2000)) + "\n" : QString();
+        view.traced = sentences[0];
+        if (model != nullptr) model->endRefresh();
+    }
+
+    // 只分析没有分析过的句子，第一句的结果来自增量分析，出错时才完整地分析一遍报告所有错误
+    QString message;
+    long long totalSteps = 0, baseSteps = 0;
+    int acceptCount = 0;
+    int messageLines = 0;
+    unordered_map<string, sentenceResult> results;
+    for (int i = 0; i < (int)sentences.size(); ++i)
+    {
+        auto cached = view.results.find(sentences[i]);
+        sentenceResult r;
+        if (cached != view.results.end()) r = cached->second;
+        else
+        {
+            if (i == 0)
+            {
+                r.ok = view.first.accepted;
+                r.steps = view.first.steps;
+            }
+            if (i != 0 || !r.ok) r.ok = parseSentence(used, sentences[i], r.steps, nullptr, &r.diagnostics);
+            r.baseSteps = r.steps;
+            if (unitElim)
             {
-                ui->tableWidget_2->setItem(i, 1 + c2int[slrunit.first], new QTableWidgetItem(QString::fromStdString(slrunit.second)));
+                vector<parseDiagnostic> baseDiagnostics;
+                parseSentence(view.base, sentences[i], r.baseSteps, nullptr, &baseDiagnostics);
             }
         }
-
-        break;
+        results[sentences[i]] = r;
+        const vector<parseDiagnostic>& diagnostics = r.diagnostics;
+        bool ok = r.ok;
+        totalSteps += r.steps;
+        baseSteps += r.baseSteps;
+        if (ok) ++acceptCount;
+        // 一遍分析报告全部错误，结果太多时只显示前面的
+        if (messageLines >= 200) continue;
+        message += "第" + QString::number(i + 1) + "句：" + (ok ? "接受" : "出错" + QString::number(diagnostics.size()) + "处") + "\n";
+        ++messageLines;
+        for (const auto& d : diagnostics)
+        {
+            if (d.tooDeep)
+            {
+                message += "  第" + QString::number(d.pos + 1) + "个字符处嵌套超过上限" + QString::number(defaultNestingLimit) + "\n";
+                ++messageLines;
+                continue;
+            }
+            message += "  第" + QString::number(d.pos + 1) + "个字符" + (d.got == '\x7f' ? QString("无法识别") : QString(d.got)) + "，期望："
+                + QString::fromStdString(expectedString(used, d.state)) + "\n";
+            ++messageLines;
+        }
+    }
+    // 只留下这次的句子，缓存不会随编辑无限增长
+    view.results.swap(results);
+    message += "共" + QString::number(sentences.size()) + "句，接受" + QString::number(acceptCount) + "句，共"
+        + QString::number(totalSteps) + "步\n";
+    if (unitElim)
+    {
+        message += "绕过了" + QString::number(used.unitEliminated) + "个单产生式归约状态，步数"
+            + QString::number(baseSteps) + "→" + QString::number(totalSteps) + "，节省"
+            + QString::number(baseSteps - totalSteps) + "步（"
+            + QString::number(baseSteps == 0 ? 0.0 : 100.0 * (baseSteps - totalSteps) / baseSteps, 'f', 1) + "%）\n";
     }
+    message += "分析表最小化：" + QString::number(used.stateCount) + "个状态合并为" + QString::number(view.minimizedCount)
+        + "个，减少" + QString::number(used.stateCount - view.minimizedCount) + "个\n";
+    message += QString(rebuilt ? "重新生成了分析表，" : "文法没有变化，沿用分析表，")
+        + "第1句增量分析：从第" + QString::number(view.first.restartPos + 1) + "个单词重新分析，执行"
+        + QString::number(view.first.executedSteps) + "步（全部" + QString::number(view.first.steps) + "步）"
+        + (view.first.syncPos >= 0 ? "，在第" + QString::number(view.first.syncPos) + "个单词后与上次分析同步" : QString())
+        + "\n";
+    if (used.lexer.stateCount > 0)
+    {
+        message += "词法：NFA" + QString::number(used.lexer.nfaCount) + "个状态，DFA" + QString::number(used.lexer.dfaCount)
+            + "个状态，最小化后" + QString::number(used.lexer.stateCount - 1) + "个，" + QString::number(used.lexer.classCount) + "个字符类\n";
+    }
+    message += "第1句分析过程" + QString::number(parseTrace.steps.size()) + "步，记录占用"
+        + QString::number(parseTrace.bytes() / 1024.0, 'f', 1) + "KB\n";
+    ui->plainTextEdit_5->setPlainText(message + view.treeText);
 
+    // 展示第一句的分析过程，表格只在滚动到时才生成对应的行
+    if (model == nullptr)
+    {
+        model = new traceModel(&parseTrace, ui->tableView);
+        ui->tableView->setModel(model);
+        ui->tableView->verticalHeader()->setVisible(false);
+        // 行高固定，百万行时不用逐行计算
+        ui->tableView->verticalHeader()->setSectionResizeMode(QHeaderView::Fixed);
+        ui->tableView->setWordWrap(false);
     }
+    ui->tableView->scrollToTop();
 }
-
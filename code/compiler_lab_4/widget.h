@@ -7,6 +7,13 @@ QT_BEGIN_NAMESPACE
 namespace Ui { class Widget; }
 QT_END_NAMESPACE
 
+// 命令行批量分析，main中带--batch参数时调用
+int batchMain(int argc, char* argv[]);
+// 后台服务，main中带--daemon参数时调用
+int daemonMain(int argc, char* argv[]);
+// 生成句子语料，main中带--generate参数时调用
+int generateMain(int argc, char* argv[]);
+
 class Widget : public QWidget
 {
     Q_OBJECT
@@ -30,6 +37,10 @@ private slots:
 
     void on_pushButton_2_clicked();
 
+    void on_pushButton_8_clicked();
+
+    void on_pushButton_9_clicked();
+
 private:
     Ui::Widget *ui;
 };
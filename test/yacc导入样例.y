@@ -0,0 +1,31 @@
+%{
+#include <stdio.h>
+int yylex(void);
+%}
+%union { int ival; }
+%token <ival> NUMBER
+%token IDENT
+%left '+' '-'
+%left '*' '/'
+%right UMINUS
+%start program
+%%
+program : stmts
+        ;
+stmts : /* empty */
+      | stmts stmt ';'  { /* ; } */ }
+      ;
+stmt : IDENT '=' expr { printf("}"); }
+     | expr
+     ;
+expr : expr '+' expr
+     | expr '-' expr
+     | expr '*' expr
+     | expr '/' expr
+     | '-' expr %prec UMINUS
+     | '(' expr ')'
+     | NUMBER
+     | IDENT
+     | error
+%%
+int main() {}